@@ -0,0 +1,151 @@
+#pragma once
+#include "ts_demuxer.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Shared bits of the programs under bench/ (see `make bench`).
+
+// Runs `pass` until at least minSeconds have gone by and returns the best
+// single pass in seconds
+template <typename Pass>
+double BestOf(Pass pass, double minSeconds = 1.0) {
+    using Clock = std::chrono::steady_clock;
+    double best = 1e30;
+    auto start = Clock::now();
+    do {
+        auto begin = Clock::now();
+        pass();
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - begin).count());
+    } while (std::chrono::duration<double>(Clock::now() - start).count() < minSeconds);
+    return best;
+}
+
+inline uint64_t ParseSizeArgument(int argc, char* argv[], int index, uint64_t fallback) {
+    return argc > index ? std::strtoull(argv[index], nullptr, 10) : fallback;
+}
+
+// Well-formed synthetic BDAV stream laid out roughly like a Blu-ray title:
+// PAT and PMT every 1000 packets, then H.264 video (about 90% of the packets,
+// 20-packet PES), two AC-3 tracks and a PG track, each PES with a PTS.
+// Generate() continues where the last call stopped, so long streams can be
+// written out in pieces.
+class SyntheticM2TS {
+public:
+    static constexpr uint16_t PmtPid = 0x0100;
+    static constexpr uint16_t VideoPid = 0x1011;
+    static constexpr uint16_t AudioPids[2] = {0x1100, 0x1101};
+    static constexpr uint16_t SubtitlePid = 0x1200;
+
+    void Generate(std::vector<uint8_t>& out, size_t count) {
+        out.reserve(out.size() + count * M2TSPacketSize);
+        for (size_t i = 0; i < count; i++, packetNumber++) {
+            if (packetNumber % 1000 == 0) {
+                AppendSection(out, 0, MakePAT());
+            } else if (packetNumber % 1000 == 1) {
+                AppendSection(out, PmtPid, MakePMT());
+            } else {
+                AppendPES(out, NextStream());
+            }
+        }
+    }
+
+    uint64_t PacketCount() const { return packetNumber; }
+
+private:
+    struct Stream {
+        uint16_t pid;
+        uint8_t streamId;
+        int packetsPerPES;
+        int left = 0;       // Packets of the current PES still to write
+        uint8_t continuity = 0;
+        uint64_t pts = 0;
+    };
+
+    Stream& NextStream() {
+        // A small LCG keeps the interleave irregular but reproducible
+        random = random * 1103515245u + 12345u;
+        uint32_t pick = (random >> 16) % 100;
+        return pick < 90 ? streams[0] : pick < 95 ? streams[1] : pick < 99 ? streams[2] : streams[3];
+    }
+
+    void AppendHeader(std::vector<uint8_t>& out, uint16_t pid, bool payloadStart, uint8_t& continuity) {
+        uint32_t arrival = static_cast<uint32_t>(packetNumber * 1500) & 0x3FFFFFFF;
+        uint8_t header[8] = {static_cast<uint8_t>(arrival >> 24), static_cast<uint8_t>(arrival >> 16),
+                             static_cast<uint8_t>(arrival >> 8), static_cast<uint8_t>(arrival),
+                             TSSyncByte, static_cast<uint8_t>((payloadStart ? 0x40 : 0) | (pid >> 8)),
+                             static_cast<uint8_t>(pid), static_cast<uint8_t>(0x10 | continuity)};
+        continuity = (continuity + 1) & 0x0F;
+        out.insert(out.end(), header, header + sizeof(header));
+    }
+
+    void AppendSection(std::vector<uint8_t>& out, uint16_t pid, const std::vector<uint8_t>& section) {
+        AppendHeader(out, pid, true, pid == 0 ? patContinuity : pmtContinuity);
+        out.push_back(0); // pointer_field
+        out.insert(out.end(), section.begin(), section.end());
+        out.resize(out.size() + TSPacketSize - 5 - section.size(), 0xFF);
+    }
+
+    void AppendPES(std::vector<uint8_t>& out, Stream& stream) {
+        bool start = stream.left == 0;
+        AppendHeader(out, stream.pid, start, stream.continuity);
+        size_t payload = TSPacketSize - 4;
+        if (start) {
+            stream.left = stream.packetsPerPES;
+            stream.pts += 3754;
+            size_t length = static_cast<size_t>(stream.packetsPerPES) * payload - 6;
+            uint8_t header[14] = {0, 0, 1, stream.streamId, static_cast<uint8_t>(length >> 8),
+                                  static_cast<uint8_t>(length), 0x80, 0x80, 5,
+                                  static_cast<uint8_t>(0x21 | ((stream.pts >> 29) & 0x0E)),
+                                  static_cast<uint8_t>(stream.pts >> 22),
+                                  static_cast<uint8_t>(0x01 | ((stream.pts >> 14) & 0xFE)),
+                                  static_cast<uint8_t>(stream.pts >> 7),
+                                  static_cast<uint8_t>(0x01 | ((stream.pts << 1) & 0xFE))};
+            out.insert(out.end(), header, header + sizeof(header));
+            payload -= sizeof(header);
+        }
+        out.resize(out.size() + payload, static_cast<uint8_t>(packetNumber));
+        stream.left--;
+    }
+
+    static std::vector<uint8_t> Finish(std::vector<uint8_t> section) {
+        size_t length = section.size() - 3 + 4;
+        section[1] = static_cast<uint8_t>(0xB0 | (length >> 8));
+        section[2] = static_cast<uint8_t>(length);
+        uint32_t crc = MpegCRC32(section.data(), section.size());
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            section.push_back(static_cast<uint8_t>(crc >> shift));
+        }
+        return section;
+    }
+
+    static std::vector<uint8_t> MakePAT() {
+        return Finish({0x00, 0, 0, 0, 1, 0xC1, 0, 0, 0, 1, static_cast<uint8_t>(0xE0 | (PmtPid >> 8)),
+                       static_cast<uint8_t>(PmtPid)});
+    }
+
+    static std::vector<uint8_t> MakePMT() {
+        std::vector<uint8_t> section = {0x02, 0, 0, 0, 1, 0xC1, 0, 0,
+                                        static_cast<uint8_t>(0xE0 | (VideoPid >> 8)), static_cast<uint8_t>(VideoPid),
+                                        0xF0, 0};
+        auto add = [&](uint8_t type, uint16_t pid) {
+            uint8_t entry[5] = {type, static_cast<uint8_t>(0xE0 | (pid >> 8)), static_cast<uint8_t>(pid), 0xF0, 0};
+            section.insert(section.end(), entry, entry + sizeof(entry));
+        };
+        add(0x1b, VideoPid);
+        add(0x81, AudioPids[0]);
+        add(0x81, AudioPids[1]);
+        add(0x90, SubtitlePid);
+        return Finish(section);
+    }
+
+    Stream streams[4] = {{VideoPid, 0xE0, 20}, {AudioPids[0], 0xBD, 3}, {AudioPids[1], 0xBD, 3},
+                         {SubtitlePid, 0xBD, 2}};
+    uint64_t packetNumber = 0;
+    uint32_t random = 1;
+    uint8_t patContinuity = 0;
+    uint8_t pmtContinuity = 0;
+};
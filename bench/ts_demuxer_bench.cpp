@@ -0,0 +1,118 @@
+// M2TSReader and TSDemuxer throughput over a multi-GB synthetic stream on
+// disk: plain packet reads, then PAT/PMT plus PES reassembly of every stream.
+//
+//   bin/bench/ts_demuxer_bench [megabytes] [file]    (default 2048 MB in $TMPDIR)
+//
+// The first pass reads the file cold (dropped from the page cache after
+// writing, where the OS allows it), the rest show the warm, CPU-bound rate.
+
+#include "bench_util.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+bool WriteStream(const std::filesystem::path& path, uint64_t packets) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    SyntheticM2TS generator;
+    std::vector<uint8_t> chunk;
+    while (file && generator.PacketCount() < packets) {
+        chunk.clear();
+        generator.Generate(chunk, static_cast<size_t>(std::min<uint64_t>(65536, packets - generator.PacketCount())));
+        file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+    }
+    return static_cast<bool>(file);
+}
+
+void DropFromCache(const std::filesystem::path& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+struct Result {
+    double seconds = 0;
+    uint64_t packets = 0;
+    uint64_t pesPackets = 0;
+    uint64_t pesBytes = 0;
+    bool mapped = false;
+};
+
+Result ReadPackets(const std::filesystem::path& path) {
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+    M2TSReader reader;
+    TSPacket packet;
+    if (reader.Open(path)) {
+        while (reader.NextPacket(packet)) {
+            result.packets++;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+Result Demux(const std::filesystem::path& path) {
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+    M2TSReader reader;
+    TSDemuxer demuxer([&](const PESPacket& pes) {
+        result.pesPackets++;
+        result.pesBytes += pes.size;
+    });
+    if (reader.Open(path)) {
+        TSDemuxer::Demux(reader, demuxer);
+        result.packets = reader.BytesRead() / M2TSPacketSize;
+    }
+    result.mapped = demuxer.HasProgramMap();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void Print(const char* name, const Result& result, double megabytes) {
+    std::printf("  %-12s %7.0f MB/s  %6.2f s", name, megabytes / result.seconds, result.seconds);
+    if (result.pesPackets > 0) {
+        std::printf("  %llu PES, %.0f MB payload", static_cast<unsigned long long>(result.pesPackets),
+                    result.pesBytes / 1e6);
+    }
+    std::printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    uint64_t megabytes = ParseSizeArgument(argc, argv, 1, 2048);
+    const char* tmp = std::getenv("TMPDIR");
+    std::filesystem::path path = argc > 2 ? std::filesystem::path(argv[2])
+                               : std::filesystem::path(tmp ? tmp : "/tmp") / "multiremux-bench.m2ts";
+    uint64_t packets = megabytes * 1000000 / M2TSPacketSize;
+
+    std::printf("Writing %llu packets (%.0f MB) to %s\n", static_cast<unsigned long long>(packets),
+                packets * M2TSPacketSize / 1e6, path.string().c_str());
+    if (!WriteStream(path, packets)) {
+        std::fprintf(stderr, "cannot write %s\n", path.string().c_str());
+        return 1;
+    }
+    double size = packets * M2TSPacketSize / 1e6;
+
+    DropFromCache(path);
+    Print("read, cold", ReadPackets(path), size);
+    Print("read", ReadPackets(path), size);
+    DropFromCache(path);
+    Print("demux, cold", Demux(path), size);
+    Result warm = Demux(path);
+    Print("demux", warm, size);
+
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    bool ok = warm.mapped && warm.packets == packets && warm.pesPackets > 0;
+    if (!ok) {
+        std::fprintf(stderr, "demux did not see the whole stream\n");
+    }
+    return ok ? 0 : 1;
+}
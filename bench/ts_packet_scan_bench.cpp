@@ -0,0 +1,83 @@
+// Sync check and PID extraction: every ExtractPids kernel this CPU runs
+// against the scalar loop, then PidPacketIndex over the same stream.
+//
+//   bin/bench/ts_packet_scan_bench [packets]    (default 1000000, ~190 MB in memory)
+
+#include "bench_util.h"
+#include "ts_packet_scan.h"
+#include <algorithm>
+
+namespace {
+
+constexpr size_t BlockPackets = 4096; // What TSDemuxer::Demux hands the kernel at once
+
+// Runs a kernel over the stream in demuxer-sized blocks; returns packets accepted
+size_t Scan(const PidKernel& kernel, const std::vector<uint8_t>& stream, std::vector<uint16_t>& pids) {
+    size_t count = stream.size() / M2TSPacketSize;
+    size_t valid = 0;
+    for (size_t first = 0; first < count; first += BlockPackets) {
+        size_t block = std::min(BlockPackets, count - first);
+        valid += kernel.extract(stream.data() + first * M2TSPacketSize, block, pids.data() + first);
+    }
+    return valid;
+}
+
+// The vector kernels must agree with the scalar loop, including where they
+// stop on a lost sync byte at every position within a step
+bool CheckAgainstScalar(const PidKernel& kernel, std::vector<uint8_t> stream) {
+    size_t count = stream.size() / M2TSPacketSize;
+    std::vector<uint16_t> expected(count), actual(count);
+    if (Scan(kernel, stream, actual) != count ||
+        ExtractPidsScalar(stream.data(), count, expected.data()) != count || expected != actual) {
+        return false;
+    }
+    for (size_t bad = 0; bad < 17 && bad < count; bad++) {
+        stream[bad * M2TSPacketSize + 4] ^= 0x01;
+        size_t scalar = ExtractPidsScalar(stream.data(), 17, expected.data());
+        size_t vector = kernel.extract(stream.data(), 17, actual.data());
+        stream[bad * M2TSPacketSize + 4] ^= 0x01;
+        if (scalar != bad || vector != bad || !std::equal(expected.begin(), expected.begin() + bad, actual.begin())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t packets = static_cast<size_t>(ParseSizeArgument(argc, argv, 1, 1000000));
+    std::vector<uint8_t> stream;
+    SyntheticM2TS().Generate(stream, packets);
+    double megabytes = stream.size() / 1e6;
+    std::printf("%zu packets (%.0f MB), ExtractPids uses %s\n", packets, megabytes, GetPidKernelName());
+
+    std::vector<uint16_t> pids(packets);
+    double scalarSeconds = 0;
+    bool ok = true;
+    for (const PidKernel& kernel : GetPidKernels()) {
+        bool agrees = CheckAgainstScalar(kernel, stream);
+        ok = ok && agrees;
+        double seconds = BestOf([&]() { Scan(kernel, stream, pids); });
+        if (scalarSeconds == 0) {
+            scalarSeconds = seconds;
+        }
+        std::printf("  %-8s %8.0f MB/s  %7.1f Mpackets/s  %5.2fx scalar%s\n", kernel.name, megabytes / seconds,
+                    packets / seconds / 1e6, scalarSeconds / seconds, agrees ? "" : "  MISMATCH");
+    }
+
+    // The index a title's STN_table would ask for: video plus one audio track
+    std::vector<uint16_t> wanted = {SyntheticM2TS::VideoPid, SyntheticM2TS::AudioPids[0]};
+    size_t indexed = 0;
+    double seconds = BestOf([&]() {
+        PidPacketIndex index(wanted);
+        for (size_t first = 0; first < packets; first += BlockPackets) {
+            index.AddBlock(stream.data() + first * M2TSPacketSize, std::min(BlockPackets, packets - first), first);
+        }
+        indexed = index.Packets(wanted[0]).size() + index.Packets(wanted[1]).size();
+    });
+    std::printf("  %-8s %8.0f MB/s  %7.1f Mpackets/s  (%zu packets on %zu PIDs)\n", "index", megabytes / seconds,
+                packets / seconds / 1e6, indexed, wanted.size());
+
+    return ok ? 0 : 1;
+}
@@ -1,52 +1,141 @@
 #include "bdmv_parser.h"
+#include "scan_cache.h"
+#include "scan_pool.h"
+#include "child_process.h"
+#include "disc_filesystem.h"
+#include "platform.h"
 #include <fstream>
 #include <algorithm>
 #include <regex>
 
-// Language code mapping for Blu-ray streams
-std::map<std::string, std::string> BDMVParser::languageMap = {
-    {"eng", "English"}, {"spa", "Spanish"}, {"fre", "French"}, {"ger", "German"},
-    {"ita", "Italian"}, {"por", "Portuguese"}, {"rus", "Russian"}, {"jpn", "Japanese"},
-    {"kor", "Korean"}, {"chi", "Chinese"}, {"hin", "Hindi"}, {"ara", "Arabic"},
-    {"dut", "Dutch"}, {"swe", "Swedish"}, {"nor", "Norwegian"}, {"dan", "Danish"},
-    {"fin", "Finnish"}, {"pol", "Polish"}, {"cze", "Czech"}, {"hun", "Hungarian"},
-    {"tha", "Thai"}, {"vie", "Vietnamese"}, {"und", "Unknown"}
-};
+namespace {
 
-std::vector<BDMVTitle> BDMVParser::ParseBDMVFolder(const std::string& path) {
+// The BDMV directory of a disc root or of the BDMV folder itself
+fs::path GetBDMVPath(const std::string& path) {
+    fs::path bdmvPath(path);
+    if (bdmvPath.filename() != "BDMV") {
+        bdmvPath = bdmvPath / "BDMV";
+    }
+    return bdmvPath;
+}
+
+// The top-level objects of the "streams" array in ffprobe's JSON output,
+// one per stream, nested objects (tags, disposition) included
+std::vector<std::string> SplitProbeStreams(const std::string& json) {
+    std::vector<std::string> streams;
+    size_t pos = json.find("\"streams\"");
+    if (pos == std::string::npos || (pos = json.find('[', pos)) == std::string::npos) {
+        return streams;
+    }
+    int depth = 0;
+    bool inString = false;
+    size_t start = 0;
+    for (size_t i = pos + 1; i < json.size(); i++) {
+        char c = json[i];
+        if (inString) {
+            if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '{' || c == '[') {
+            if (depth++ == 0) {
+                start = i;
+            }
+        } else if (c == '}' || c == ']') {
+            if (depth == 0) {
+                break; // End of the streams array
+            }
+            if (--depth == 0 && c == '}') {
+                streams.push_back(json.substr(start, i + 1 - start));
+            }
+        }
+    }
+    return streams;
+}
+
+} // namespace
+
+std::vector<BDMVTitle> BDMVParser::ParseBDMVFolder(const std::string& path, bool useCache, ScanDepth depth) {
     std::vector<BDMVTitle> titles;
     
     try {
-        fs::path bdmvPath(path);
+        fs::path bdmvPath = GetBDMVPath(path);
         
-        // Ensure we're looking at the BDMV directory
-        if (bdmvPath.filename() != "BDMV") {
-            bdmvPath = bdmvPath / "BDMV";
-        }
-        
-        if (!fs::exists(bdmvPath)) {
+        if (!DiscFileSystem::Exists(bdmvPath)) {
             return titles;
         }
         
         fs::path playlistDir = bdmvPath / "PLAYLIST";
         fs::path streamDir = bdmvPath / "STREAM";
         
-        if (!fs::exists(playlistDir) || !fs::exists(streamDir)) {
+        if (!DiscFileSystem::IsDirectory(playlistDir) || !DiscFileSystem::IsDirectory(streamDir)) {
             return titles;
         }
         
-        // Parse all MPLS files
-        for (const auto& entry : fs::directory_iterator(playlistDir)) {
-            if (entry.path().extension() == ".mpls") {
-                auto title = ParseMPLSFile(entry.path(), streamDir);
-                if (title.duration > 120) { // Skip clips under 2 minutes
-                    titles.push_back(title);
-                }
+        // A known disc is answered from the scan cache without touching any playlist
+        uint64_t fingerprint = useCache ? ScanCache::ComputeFingerprint(bdmvPath) : 0;
+        if (fingerprint != 0 && ScanCache::Load(fingerprint, titles)) {
+            return titles;
+        }
+        
+        std::vector<fs::path> playlists;
+        std::vector<DiscFileSystem::Entry> entries;
+        DiscFileSystem::ListDirectory(playlistDir, entries);
+        for (const auto& entry : entries) {
+            fs::path playlist = playlistDir / entry.name;
+            if (!entry.isDirectory && playlist.extension() == ".mpls") {
+                playlists.push_back(playlist);
+            }
+        }
+        std::sort(playlists.begin(), playlists.end());
+        
+        std::vector<BDMVTitle> parsed(playlists.size());
+        
+        // Parse all MPLS files concurrently, bounded by the device's read limit
+        auto throttle = IOThrottle::ForPath(bdmvPath);
+        {
+            TaskGroup group(ScanPool::Instance());
+            for (size_t i = 0; i < playlists.size(); i++) {
+                group.Run([&, i]() {
+                    IOThrottle::Slot slot(*throttle);
+                    parsed[i] = ParseMPLSStructure(playlists[i]);
+                });
+            }
+            group.Wait();
+        }
+        
+        for (auto& title : parsed) {
+            if (title.duration > 120) { // Skip clips under 2 minutes
+                titles.push_back(std::move(title));
+            }
+        }
+        
+        // Decoy and repeated playlists collapse before any per-title analysis
+        CollapseDuplicateTitles(titles);
+        
+        // Playlists share clips, so each CLPI is only read once per folder.
+        // Languages the STN_table declares cost nothing, so even a structural
+        // scan resolves them; the rest wait for the deep tier.
+        ClipInfoCache clipCache;
+        {
+            TaskGroup group(ScanPool::Instance());
+            for (auto& title : titles) {
+                group.Run([&]() {
+                    IOThrottle::Slot slot(*throttle);
+                    MeasureTitle(title, streamDir, clipCache);
+                    if (depth == ScanDepth::Full || !title.streams.empty()) {
+                        AnalyzeTitleStreams(title, streamDir, &clipCache);
+                    }
+                });
             }
+            group.Wait();
         }
         
         // Sort by duration (longest first - usually main feature)
-        std::sort(titles.begin(), titles.end(), 
+        std::stable_sort(titles.begin(), titles.end(), 
                   [](const BDMVTitle& a, const BDMVTitle& b) {
                       return a.duration > b.duration;
                   });
@@ -56,225 +145,760 @@ std::vector<BDMVTitle> BDMVParser::ParseBDMVFolder(const std::string& path) {
             titles[i].id = static_cast<int>(i);
         }
         
+        if (fingerprint != 0) {
+            ScanCache::Store(fingerprint, titles);
+        }
+        
     } catch (const std::exception& e) {
         // Log error but don't crash
-        OutputDebugStringA(("BDMV Parse Error: " + std::string(e.what())).c_str());
+        DebugLog("BDMV Parse Error: " + std::string(e.what()));
     }
     
     return titles;
 }
 
-BDMVTitle BDMVParser::ParseMPLSFile(const fs::path& mplsPath, const fs::path& streamDir) {
+void BDMVParser::StoreScan(const std::string& path, const std::vector<BDMVTitle>& titles) {
+    if (titles.empty()) {
+        return;
+    }
+    uint64_t fingerprint = ScanCache::ComputeFingerprint(GetBDMVPath(path));
+    if (fingerprint != 0) {
+        ScanCache::Store(fingerprint, titles);
+    }
+}
+
+BDMVTitle BDMVParser::ParseMPLSFile(const fs::path& mplsPath, const fs::path& streamDir,
+                                     ClipInfoCache* clipCache) {
+    BDMVTitle title = ParseMPLSStructure(mplsPath);
+    AnalyzeTitle(title, streamDir, clipCache);
+    return title;
+}
+
+BDMVTitle BDMVParser::ParseMPLSStructure(const fs::path& mplsPath) {
     BDMVTitle title;
+    title.id = 0;
     title.filename = mplsPath.filename().string();
     title.duration = 0;
     title.size = 0;
     
     try {
-        std::ifstream file(mplsPath, std::ios::binary);
-        if (!file.is_open()) {
+        // Read the whole playlist once and decode it from memory
+        std::vector<uint8_t> data;
+        if (!DiscFileSystem::ReadFile(mplsPath, data)) {
             return title;
         }
         
-        // Read MPLS header
-        char magic[4];
-        file.read(magic, 4);
+        ByteReader reader(data);
         
-        if (std::string(magic, 4) != "MPLS") {
+        // Read MPLS header
+        if (reader.ReadString(4) != "MPLS") {
             return title;
         }
         
-        // Skip version info
-        file.seekg(8);
-        
-        // Read playlist start address
-        uint32_t playlistStart;
-        file.read(reinterpret_cast<char*>(&playlistStart), 4);
-        playlistStart = _byteswap_ulong(playlistStart); // Convert from big-endian
+        // Skip version info, read the playlist and mark start addresses
+        reader.Seek(8);
+        uint32_t playlistStart = reader.ReadU32();
+        uint32_t markStart = reader.ReadU32();
         
         // Jump to playlist section
-        file.seekg(playlistStart);
+        reader.Seek(playlistStart);
+        uint32_t playlistLength = reader.ReadU32();
+        ByteReader playlist = reader.SubReader(playlistLength);
         
-        // Read playlist length
-        uint32_t playlistLength;
-        file.read(reinterpret_cast<char*>(&playlistLength), 4);
-        playlistLength = _byteswap_ulong(playlistLength);
-        
-        // Skip reserved bytes
-        file.seekg(2, std::ios::cur);
-        
-        // Read number of play items
-        uint16_t playItemCount;
-        file.read(reinterpret_cast<char*>(&playItemCount), 2);
-        playItemCount = _byteswap_ushort(playItemCount);
-        
-        // Skip sub-playitem count
-        file.seekg(2, std::ios::cur);
+        // Skip reserved bytes, read the numbers of play items and sub-paths
+        playlist.Skip(2);
+        uint16_t playItemCount = playlist.ReadU16();
+        uint16_t subPathCount = playlist.ReadU16();
         
         // Parse play items
-        std::vector<PlayItem> playItems;
         for (int i = 0; i < playItemCount; i++) {
-            PlayItem item = ParsePlayItem(file);
+            PlayItem item = ParsePlayItem(playlist);
             if (!item.clipName.empty()) {
-                playItems.push_back(item);
+                title.playItems.push_back(item);
                 title.duration += item.GetDurationSeconds();
-                
-                // Add file size from corresponding M2TS
-                fs::path m2tsPath = streamDir / (item.clipName + ".m2ts");
-                if (fs::exists(m2tsPath)) {
-                    title.size += fs::file_size(m2tsPath);
+            }
+        }
+        
+        // Sub-paths only add streams to the main path's timeline, never duration;
+        // a damaged one keeps the play items already read
+        try {
+            for (int i = 0; i < subPathCount; i++) {
+                title.subPaths.push_back(ParseSubPath(playlist));
+            }
+        } catch (const std::exception& e) {
+            DebugLog("SubPath Parse Error: " + std::string(e.what()));
+        }
+        
+        // Marks are optional for playback; a damaged table leaves the title without chapters
+        try {
+            if (markStart != 0) {
+                reader.Seek(markStart);
+                ByteReader markTable = reader.SubReader(reader.ReadU32());
+                uint16_t markCount = markTable.ReadU16();
+                for (int i = 0; i < markCount; i++) {
+                    PlayListMark mark;
+                    markTable.Skip(1); // reserved
+                    mark.type = markTable.ReadU8();
+                    mark.playItemId = markTable.ReadU16();
+                    mark.time = markTable.ReadU32();
+                    markTable.Skip(6); // entry_ES_PID, duration
+                    title.marks.push_back(mark);
                 }
             }
+        } catch (const std::exception& e) {
+            title.marks.clear();
+            DebugLog("PlayListMark Parse Error: " + std::string(e.what()));
         }
         
-        // For now, add default languages (real implementation would parse stream info)
-        // This would normally come from analyzing the referenced M2TS files
-        title.audioLanguages = GetAudioLanguages(streamDir, playItems);
-        title.subtitleLanguages = GetSubtitleLanguages(streamDir, playItems);
+        // The title's stream set is the union of its play items' STN_tables
+        for (const auto& item : title.playItems) {
+            for (const auto& stream : item.streams) {
+                bool known = std::any_of(title.streams.begin(), title.streams.end(),
+                    [&](const StreamInfo& s) {
+                        return s.pid == stream.pid && s.subPathId == stream.subPathId;
+                    });
+                if (!known) {
+                    title.streams.push_back(stream);
+                }
+            }
+        }
         
     } catch (const std::exception& e) {
-        OutputDebugStringA(("MPLS Parse Error: " + std::string(e.what())).c_str());
+        DebugLog("MPLS Parse Error: " + std::string(e.what()));
     }
     
     return title;
 }
 
-PlayItem BDMVParser::ParsePlayItem(std::ifstream& file) {
-    PlayItem item;
-    
+void BDMVParser::AnalyzeTitle(BDMVTitle& title, const fs::path& streamDir, ClipInfoCache* clipCache) {
     try {
-        // Read play item length
-        uint16_t length;
-        file.read(reinterpret_cast<char*>(&length), 2);
-        length = _byteswap_ushort(length);
-        
-        std::streampos startPos = file.tellg();
-        
-        // Read clip information file name (5 bytes)
-        char clipName[6] = {0};
-        file.read(clipName, 5);
-        item.clipName = std::string(clipName);
-        
-        // Skip codec identifier
-        file.seekg(4, std::ios::cur);
+        ClipInfoCache localCache;
+        ClipInfoCache& clips = clipCache ? *clipCache : localCache;
+        MeasureTitle(title, streamDir, clips);
+        AnalyzeTitleStreams(title, streamDir, &clips);
+    } catch (const std::exception& e) {
+        DebugLog("Title Analysis Error: " + std::string(e.what()));
+    }
+}
+
+void BDMVParser::AnalyzeTitleStreams(BDMVTitle& title, const fs::path& streamDir, ClipInfoCache* clipCache) {
+    try {
+        ClipInfoCache localCache;
+        ClipInfoCache& clips = clipCache ? *clipCache : localCache;
+        fs::path clipinfDir = streamDir.parent_path() / "CLIPINF";
+        
+        // Without an STN_table, stream attributes come from the clips' CLPI files
+        std::vector<StreamInfo> streams = title.streams;
+        if (streams.empty()) {
+            for (const auto& clip : LoadClipInfo(clipinfDir, title.playItems, clips)) {
+                streams.insert(streams.end(), clip.streams.begin(), clip.streams.end());
+            }
+        }
         
-        // Skip to time info (this is simplified)
-        file.seekg(startPos);
-        file.seekg(14, std::ios::cur);
+        bool audioKnown = GetAudioLanguages(streamDir, title.playItems, streams, title.audioLanguages);
+        bool subtitlesKnown = GetSubtitleLanguages(streamDir, title.playItems, streams,
+                                                   title.subtitleLanguages);
+        // Undetermined languages leave the title to be analyzed again on the next load
+        title.analyzed = audioKnown && subtitlesKnown;
         
-        // Read IN time (4 bytes, 45kHz clock)
-        uint32_t inTime;
-        file.read(reinterpret_cast<char*>(&inTime), 4);
-        item.inTime = _byteswap_ulong(inTime);
+    } catch (const std::exception& e) {
+        DebugLog("Title Analysis Error: " + std::string(e.what()));
+    }
+}
+
+void BDMVParser::MeasureTitle(BDMVTitle& title, const fs::path& streamDir, ClipInfoCache& clipCache) {
+    fs::path clipinfDir = streamDir.parent_path() / "CLIPINF";
+    
+    // Each play item (and angle) reads only the packets of its window
+    auto measure = [&](const std::string& clipName, uint8_t stcId, uint32_t inTime, uint32_t outTime,
+                       uint64_t& byteOffset, uint64_t& byteLength) {
+        byteOffset = 0;
+        byteLength = 0;
+        ClipInfo clip;
+        uint32_t firstSpn = 0;
+        uint32_t endSpn = 0;
+        uint64_t fileSize = 0;
+        if (FindClipInfo(clipinfDir, clipName, clipCache, clip) &&
+            clip.GetPacketRange(stcId, inTime, outTime, firstSpn, endSpn) &&
+            DiscFileSystem::FileSize(streamDir / (clipName + ".m2ts"), fileSize)) {
+            byteOffset = std::min(firstSpn * CLPIParser::SourcePacketSize, fileSize);
+            byteLength = std::min(endSpn * CLPIParser::SourcePacketSize, fileSize) - byteOffset;
+        }
+    };
+    for (auto& item : title.playItems) {
+        measure(item.clipName, item.stcId, item.inTime, item.outTime, item.byteOffset, item.byteLength);
+        for (auto& angle : item.angles) {
+            measure(angle.clipName, angle.stcId, item.inTime, item.outTime, angle.byteOffset, angle.byteLength);
+        }
+    }
+    
+    // The first angle's bytes; a clip without an EP_map counts whole, once
+    title.size = 0;
+    std::set<std::string> counted;
+    for (const auto& clip : title.GetClips()) {
+        uint64_t clipSize = 0;
+        if (clip.byteLength != 0) {
+            title.size += clip.byteLength;
+        } else if (counted.insert(clip.clipName).second &&
+                   DiscFileSystem::FileSize(streamDir / (clip.clipName + ".m2ts"), clipSize)) {
+            title.size += clipSize;
+        }
+    }
+}
+
+bool BDMVParser::TrimTitle(BDMVTitle& title, const fs::path& streamDir, double& startTime, double endTime) {
+    ClipInfoCache clipCache;
+    fs::path clipinfDir = streamDir.parent_path() / "CLIPINF";
+    
+    std::vector<PlayItem> kept;
+    std::vector<int> keptIds(title.playItems.size(), -1);
+    double itemStart = 0;
+    for (size_t i = 0; i < title.playItems.size(); i++) {
+        PlayItem item = title.playItems[i];
+        double itemEnd = itemStart + item.GetDurationSeconds();
+        if (itemEnd > startTime && (endTime <= 0 || itemStart < endTime)) {
+            uint32_t originalIn = item.inTime;
+            if (endTime > 0 && endTime < itemEnd) {
+                item.outTime = originalIn + static_cast<uint32_t>((endTime - itemStart) * 45000.0);
+            }
+            if (startTime > itemStart) {
+                item.inTime = originalIn + static_cast<uint32_t>((startTime - itemStart) * 45000.0);
+                
+                // Reading starts at the I-frame's packet, so start the window on it too
+                ClipInfo clip;
+                EntryPoint point;
+                if (FindClipInfo(clipinfDir, item.clipName, clipCache, clip) &&
+                    clip.FindEntryPoint(item.stcId, item.inTime, point)) {
+                    item.inTime = std::max(originalIn, static_cast<uint32_t>(point.pts / 2));
+                }
+                startTime = itemStart + (item.inTime - originalIn) / 45000.0;
+            }
+            if (item.outTime > item.inTime) {
+                keptIds[i] = static_cast<int>(kept.size());
+                kept.push_back(item);
+            }
+        }
+        itemStart = itemEnd;
+    }
+    if (kept.empty()) {
+        return false;
+    }
+    
+    std::vector<PlayListMark> marks;
+    for (auto mark : title.marks) {
+        if (mark.playItemId >= keptIds.size() || keptIds[mark.playItemId] < 0) {
+            continue;
+        }
+        const PlayItem& item = kept[keptIds[mark.playItemId]];
+        if (mark.time >= item.inTime && mark.time < item.outTime) {
+            mark.playItemId = static_cast<uint16_t>(keptIds[mark.playItemId]);
+            marks.push_back(mark);
+        }
+    }
+    
+    title.playItems = std::move(kept);
+    title.marks = std::move(marks);
+    title.duration = 0;
+    for (const auto& item : title.playItems) {
+        title.duration += item.GetDurationSeconds();
+    }
+    MeasureTitle(title, streamDir, clipCache);
+    return true;
+}
+
+void BDMVParser::CollapseDuplicateTitles(std::vector<BDMVTitle>& titles) {
+    // Exact key: the ordered PlayItem sequence. Loose key: the same segments in any order.
+    auto segmentKey = [](const PlayItem& item) {
+        std::string key = item.clipName + ":" + std::to_string(item.stcId) + ":" +
+                          std::to_string(item.inTime) + "-" + std::to_string(item.outTime);
+        for (size_t angle = 1; angle < item.angles.size(); angle++) {
+            key += "/" + item.angles[angle].clipName;
+        }
+        return key;
+    };
+    auto sequenceKey = [&](const BDMVTitle& title) {
+        std::string key;
+        for (const auto& item : title.playItems) {
+            key += segmentKey(item) + "|";
+        }
+        return key;
+    };
+    auto segmentSetKey = [&](const BDMVTitle& title) {
+        std::vector<std::string> segments;
+        for (const auto& item : title.playItems) {
+            segments.push_back(segmentKey(item));
+        }
+        std::sort(segments.begin(), segments.end());
+        std::string key;
+        for (const auto& segment : segments) {
+            key += segment + "|";
+        }
+        return key;
+    };
+    
+    // Number of times playback jumps back to an earlier clip; decoy playlists
+    // shuffle the real segment order, the main feature usually plays forward
+    auto outOfOrderJumps = [](const BDMVTitle& title) {
+        int jumps = 0;
+        for (size_t i = 1; i < title.playItems.size(); i++) {
+            if (title.playItems[i].clipName < title.playItems[i - 1].clipName) {
+                jumps++;
+            }
+        }
+        return jumps;
+    };
+    
+    std::map<std::string, std::vector<size_t>> groups;
+    for (size_t i = 0; i < titles.size(); i++) {
+        if (!titles[i].playItems.empty()) {
+            groups[segmentSetKey(titles[i])].push_back(i);
+        }
+    }
+    
+    std::vector<bool> removed(titles.size(), false);
+    for (const auto& group : groups) {
+        const std::vector<size_t>& members = group.second;
+        if (members.size() < 2) {
+            continue;
+        }
         
-        // Read OUT time (4 bytes, 45kHz clock)
-        uint32_t outTime;
-        file.read(reinterpret_cast<char*>(&outTime), 4);
-        item.outTime = _byteswap_ulong(outTime);
+        // Titles arrive in playlist-name order, so ties keep the lowest number
+        size_t kept = members[0];
+        for (size_t index : members) {
+            if (outOfOrderJumps(titles[index]) < outOfOrderJumps(titles[kept])) {
+                kept = index;
+            }
+        }
         
-        // Skip rest of play item
-        file.seekg(startPos);
-        file.seekg(length, std::ios::cur);
+        BDMVTitle& canonical = titles[kept];
+        bool permuted = false;
+        for (size_t index : members) {
+            if (index == kept) {
+                continue;
+            }
+            canonical.duplicates.push_back(titles[index].filename);
+            permuted = permuted || sequenceKey(titles[index]) != sequenceKey(canonical);
+            removed[index] = true;
+        }
         
+        canonical.selectionNote = permuted
+            ? "same clip segments in a different order; kept the most sequential clip order"
+            : "identical clip sequence; kept the lowest playlist number";
+    }
+    
+    std::vector<BDMVTitle> unique;
+    for (size_t i = 0; i < titles.size(); i++) {
+        if (!removed[i]) {
+            unique.push_back(std::move(titles[i]));
+        }
+    }
+    titles = std::move(unique);
+}
+
+PlayItem BDMVParser::ParsePlayItem(ByteReader& reader) {
+    PlayItem item;
+    item.inTime = 0;
+    item.outTime = 0;
+    
+    // Bound all reads to this play item; a malformed item throws out to ParseMPLSFile
+    uint16_t length = reader.ReadU16();
+    ByteReader data = reader.SubReader(length);
+    
+    // Clip information file name (5 bytes), skip codec identifier (4 bytes)
+    item.clipName = data.ReadString(5);
+    data.Skip(4);
+    
+    // 11 reserved bits, is_multi_angle, connection_condition
+    uint16_t flags = data.ReadU16();
+    item.isMultiAngle = (flags & 0x0010) != 0;
+    item.connectionCondition = static_cast<uint8_t>(flags & 0x000F);
+    item.stcId = data.ReadU8();
+    
+    // Read IN/OUT time (45kHz clock)
+    item.inTime = data.ReadU32();
+    item.outTime = data.ReadU32();
+    
+    // UO mask table, random access flag and still info
+    data.Skip(12);
+    
+    // Angle 1 is the item's own clip; each further angle names its clip and STC
+    // sequence, and shares the item's IN/OUT times
+    if (item.isMultiAngle) {
+        uint8_t angleCount = data.ReadU8();
+        item.isSeamlessAngleChange = (data.ReadU8() & 0x01) != 0;
+        item.angles.push_back({item.clipName, item.stcId});
+        for (int angle = 1; angle < angleCount; angle++) {
+            ClipReference clip;
+            clip.clipName = data.ReadString(5);
+            data.Skip(4); // Codec identifier
+            clip.stcId = data.ReadU8();
+            item.angles.push_back(clip);
+        }
+    }
+    
+    try {
+        ParseSTNTable(data, item.streams);
     } catch (const std::exception& e) {
-        OutputDebugStringA(("PlayItem Parse Error: " + std::string(e.what())).c_str());
+        // Keep the item's timing even if its stream table is damaged
+        item.streams.clear();
+        DebugLog("STN_table Parse Error: " + std::string(e.what()));
     }
     
     return item;
 }
 
-std::vector<std::string> BDMVParser::GetAudioLanguages(const fs::path& streamDir, 
-                                                       const std::vector<PlayItem>& playItems) {
-    std::set<std::string> languages;
+SubPath BDMVParser::ParseSubPath(ByteReader& reader) {
+    SubPath subPath;
+    
+    uint32_t length = reader.ReadU32();
+    ByteReader data = reader.SubReader(length);
+    
+    data.Skip(1); // reserved
+    subPath.type = data.ReadU8();
+    subPath.isRepeat = (data.ReadU16() & 0x0001) != 0;
+    data.Skip(1); // reserved
+    uint8_t itemCount = data.ReadU8();
+    
+    for (int i = 0; i < itemCount; i++) {
+        subPath.items.push_back(ParseSubPlayItem(data));
+    }
+    
+    return subPath;
+}
+
+SubPlayItem BDMVParser::ParseSubPlayItem(ByteReader& reader) {
+    SubPlayItem item;
+    
+    uint16_t length = reader.ReadU16();
+    ByteReader data = reader.SubReader(length);
     
-    // For demonstration, use FFprobe to analyze the first M2TS file
-    if (!playItems.empty()) {
-        fs::path m2tsPath = streamDir / (playItems[0].clipName + ".m2ts");
-        if (fs::exists(m2tsPath)) {
-            languages = AnalyzeStreamLanguages(m2tsPath, "audio");
+    item.clipName = data.ReadString(5);
+    data.Skip(4); // Codec identifier
+    
+    // 27 reserved bits, connection_condition, is_multi_Clip_entries
+    uint32_t flags = data.ReadU32();
+    item.connectionCondition = static_cast<uint8_t>((flags >> 1) & 0x0F);
+    bool isMultiClip = (flags & 0x01) != 0;
+    item.stcId = data.ReadU8();
+    
+    item.inTime = data.ReadU32();
+    item.outTime = data.ReadU32();
+    item.syncPlayItemId = data.ReadU16();
+    item.syncStartPts = data.ReadU32();
+    
+    if (isMultiClip) {
+        uint8_t clipCount = data.ReadU8();
+        data.Skip(1); // reserved
+        item.clips.push_back({item.clipName, item.stcId});
+        for (int clip = 1; clip < clipCount; clip++) {
+            ClipReference entry;
+            entry.clipName = data.ReadString(5);
+            data.Skip(4); // Codec identifier
+            entry.stcId = data.ReadU8();
+            item.clips.push_back(entry);
         }
     }
     
-    // Fallback to common languages if analysis fails
-    if (languages.empty()) {
-        languages = {"English", "Spanish", "French"};
+    return item;
+}
+
+void BDMVParser::ParseSTNTable(ByteReader& reader, std::vector<StreamInfo>& streams) {
+    uint16_t length = reader.ReadU16();
+    ByteReader stn = reader.SubReader(length);
+    
+    stn.Skip(2); // reserved
+    uint8_t primaryVideoCount = stn.ReadU8();
+    uint8_t primaryAudioCount = stn.ReadU8();
+    uint8_t pgCount = stn.ReadU8();
+    uint8_t igCount = stn.ReadU8();
+    uint8_t secondaryAudioCount = stn.ReadU8();
+    uint8_t secondaryVideoCount = stn.ReadU8();
+    uint8_t pipPgCount = stn.ReadU8();
+    stn.Skip(5); // reserved
+    
+    // Entry groups, in the order the entries are stored
+    struct Group {
+        StreamRole role;
+        int count;
+        int referenceLists; // Trailing stream reference lists per entry
+    };
+    const Group groups[] = {
+        {StreamRole::Primary, primaryVideoCount, 0},
+        {StreamRole::Primary, primaryAudioCount, 0},
+        {StreamRole::Primary, pgCount, 0},
+        {StreamRole::Secondary, pipPgCount, 0},
+        {StreamRole::Primary, igCount, 0},
+        {StreamRole::Secondary, secondaryAudioCount, 1}, // primary audio refs
+        {StreamRole::Secondary, secondaryVideoCount, 2}, // secondary audio refs, PiP PG refs
+    };
+    
+    for (const auto& group : groups) {
+        for (int i = 0; i < group.count; i++) {
+            StreamInfo stream;
+            stream.role = group.role;
+            
+            // stream_entry
+            ByteReader entry = stn.SubReader(stn.ReadU8());
+            uint8_t entryType = entry.ReadU8();
+            if (entryType == 1) {
+                stream.pid = entry.ReadU16();
+            } else if (entryType == 2) {
+                stream.subPathId = entry.ReadU8();
+                entry.Skip(1); // ref_to_subClip_entry_id
+                stream.pid = entry.ReadU16();
+            } else if (entryType == 3 || entryType == 4) {
+                stream.subPathId = entry.ReadU8();
+                stream.pid = entry.ReadU16();
+            }
+            
+            // stream_attributes
+            bool valid = CLPIParser::ParseStreamCodingInfo(stn.SubReader(stn.ReadU8()), stream);
+            
+            // Reference lists: count, reserved byte, ids, padded to an even length
+            for (int r = 0; r < group.referenceLists; r++) {
+                uint8_t count = stn.ReadU8();
+                stn.Skip(1 + count + (count % 2));
+            }
+            
+            if (valid) {
+                streams.push_back(stream);
+            }
+        }
+    }
+}
+
+bool BDMVParser::ParseIndexFile(const fs::path& indexPath, BDMVIndex& index) {
+    try {
+        std::vector<uint8_t> data;
+        if (!DiscFileSystem::ReadFile(indexPath, data)) {
+            return false;
+        }
+        
+        ByteReader reader(data);
+        if (reader.ReadString(4) != "INDX") {
+            return false;
+        }
+        index.version = reader.ReadString(4);
+        
+        uint32_t indexesStart = reader.ReadU32();
+        reader.Seek(indexesStart);
+        ByteReader indexes = reader.SubReader(reader.ReadU32());
+        
+        // FirstPlayback and TopMenu objects
+        indexes.Skip(24);
+        
+        uint16_t titleCount = indexes.ReadU16();
+        index.titles.clear();
+        for (int i = 0; i < titleCount; i++) {
+            ByteReader entry = indexes.SubReader(12);
+            
+            IndexTitle title;
+            title.isBDJ = (entry.ReadU8() >> 6) == 2; // object_type: 1 = HDMV, 2 = BD-J
+            entry.Skip(3); // access type, reserved
+            entry.Skip(2); // playback type
+            if (title.isBDJ) {
+                title.bdjoName = entry.ReadString(5);
+            } else {
+                title.movieObjectId = entry.ReadU16();
+            }
+            index.titles.push_back(title);
+        }
+        
+    } catch (const std::exception& e) {
+        DebugLog("Index Parse Error: " + std::string(e.what()));
+        return false;
     }
     
-    return std::vector<std::string>(languages.begin(), languages.end());
+    return true;
 }
 
-std::vector<std::string> BDMVParser::GetSubtitleLanguages(const fs::path& streamDir, 
-                                                          const std::vector<PlayItem>& playItems) {
-    std::set<std::string> languages;
+bool BDMVParser::FindClipInfo(const fs::path& clipinfDir, const std::string& clipName,
+                              ClipInfoCache& clipCache, ClipInfo& clip) {
+    if (clipCache.Find(clipName, clip)) {
+        return true;
+    }
+    if (!CLPIParser::ParseCLPIFile(clipinfDir / (clipName + ".clpi"), clip)) {
+        return false;
+    }
+    clipCache.Insert(clip);
+    return true;
+}
+
+std::vector<ClipInfo> BDMVParser::LoadClipInfo(const fs::path& clipinfDir,
+                                               const std::vector<PlayItem>& playItems,
+                                               ClipInfoCache& clipCache) {
+    std::vector<ClipInfo> clips;
+    std::set<std::string> seen;
     
-    // For demonstration, use FFprobe to analyze the first M2TS file
-    if (!playItems.empty()) {
-        fs::path m2tsPath = streamDir / (playItems[0].clipName + ".m2ts");
-        if (fs::exists(m2tsPath)) {
-            languages = AnalyzeStreamLanguages(m2tsPath, "subtitle");
+    for (const auto& item : playItems) {
+        if (!seen.insert(item.clipName).second) {
+            continue;
+        }
+        
+        // A missing or damaged CLPI invalidates the whole set; callers fall back to probing
+        ClipInfo clip;
+        if (!FindClipInfo(clipinfDir, item.clipName, clipCache, clip)) {
+            return {};
         }
+        clips.push_back(clip);
     }
     
-    // Fallback to common languages if analysis fails
-    if (languages.empty()) {
-        languages = {"English", "Spanish"};
+    return clips;
+}
+
+bool BDMVParser::GetAudioLanguages(const fs::path& streamDir, 
+                                   const std::vector<PlayItem>& playItems,
+                                   const std::vector<StreamInfo>& streams,
+                                   std::vector<LanguageId>& result) {
+    std::set<LanguageId> languages;
+    
+    if (!streams.empty()) {
+        for (const auto& stream : streams) {
+            if (stream.kind == StreamKind::Audio && stream.role == StreamRole::Primary) {
+                languages.insert(stream.language);
+            }
+        }
+        result.assign(languages.begin(), languages.end());
+        return true;
     }
     
-    return std::vector<std::string>(languages.begin(), languages.end());
+    // No stream information available, use FFprobe to analyze the first M2TS file
+    if (playItems.empty() ||
+        !AnalyzeStreamLanguages(streamDir / (playItems[0].clipName + ".m2ts"), "audio", languages)) {
+        return false;
+    }
+    result.assign(languages.begin(), languages.end());
+    return true;
 }
 
-std::set<std::string> BDMVParser::AnalyzeStreamLanguages(const fs::path& m2tsPath, 
-                                                         const std::string& streamType) {
-    std::set<std::string> languages;
+bool BDMVParser::GetSubtitleLanguages(const fs::path& streamDir, 
+                                      const std::vector<PlayItem>& playItems,
+                                      const std::vector<StreamInfo>& streams,
+                                      std::vector<LanguageId>& result) {
+    std::set<LanguageId> languages;
     
+    if (!streams.empty()) {
+        for (const auto& stream : streams) {
+            if (stream.IsSubtitle() && stream.role == StreamRole::Primary) {
+                languages.insert(stream.language);
+            }
+        }
+        result.assign(languages.begin(), languages.end());
+        return true;
+    }
+    
+    // No stream information available, use FFprobe to analyze the first M2TS file
+    if (playItems.empty() ||
+        !AnalyzeStreamLanguages(streamDir / (playItems[0].clipName + ".m2ts"), "subtitle", languages)) {
+        return false;
+    }
+    result.assign(languages.begin(), languages.end());
+    return true;
+}
+
+bool BDMVParser::AnalyzeStreamLanguages(const fs::path& m2tsPath, const std::string& streamType,
+                                        std::set<LanguageId>& languages) {
     try {
-        // Use FFprobe to analyze streams
-        std::string command = "ffprobe -v quiet -print_format json -show_streams \"" + 
-                             m2tsPath.string() + "\" 2>nul";
-        
-        // Execute command and capture output
-        FILE* pipe = _popen(command.c_str(), "r");
-        if (!pipe) {
-            return languages;
+        if (!fs::exists(m2tsPath)) {
+            return false;
         }
         
+        // Use FFprobe to analyze streams
         std::string result;
-        char buffer[1024];
-        while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-            result += buffer;
+        if (ChildProcess::Run({"ffprobe", "-v", "quiet", "-print_format", "json", "-show_streams",
+                               m2tsPath.string()}, result, std::chrono::seconds(30)) != 0) {
+            return false;
         }
-        _pclose(pipe);
         
-        // Simple regex parsing of JSON output (real implementation should use JSON library)
+        // Type and language are matched within each stream's own object
         std::regex langPattern("\"language\"\\s*:\\s*\"([^\"]+)\"");
-        std::regex typePattern("\"codec_type\"\\s*:\\s*\"(" + streamType + ")\"");
-        
-        std::sregex_iterator langIter(result.begin(), result.end(), langPattern);
-        std::sregex_iterator typeIter(result.begin(), result.end(), typePattern);
-        std::sregex_iterator end;
-        
-        // Extract languages for matching stream types
-        for (auto& match : std::vector<std::smatch>(langIter, end)) {
-            std::string langCode = match[1].str();
-            auto it = languageMap.find(langCode);
-            if (it != languageMap.end()) {
-                languages.insert(it->second);
+        std::regex typePattern("\"codec_type\"\\s*:\\s*\"" + streamType + "\"");
+        
+        for (const auto& stream : SplitProbeStreams(result)) {
+            std::smatch match;
+            if (!std::regex_search(stream, typePattern) || !std::regex_search(stream, match, langPattern)) {
+                continue;
+            }
+            // Any well-formed code counts, not only the ones with a name
+            LanguageId language = LanguageId::FromCode(match[1].str());
+            if (!language.IsUndetermined()) {
+                languages.insert(language);
             }
         }
+        return true;
         
     } catch (const std::exception& e) {
-        OutputDebugStringA(("Stream Analysis Error: " + std::string(e.what())).c_str());
+        DebugLog("Stream Analysis Error: " + std::string(e.what()));
     }
     
-    return languages;
+    return false;
 }
 
-std::string BDMVParser::GetLanguageName(const std::string& code) {
-    auto it = languageMap.find(code);
-    return (it != languageMap.end()) ? it->second : code;
-}
 
 double PlayItem::GetDurationSeconds() const {
     // Convert 45kHz clock units to seconds
     return static_cast<double>(outTime - inTime) / 45000.0;
-}
\ No newline at end of file
+}
+
+ClipReference PlayItem::GetAngle(size_t angle) const {
+    if (!isMultiAngle || angles.empty()) {
+        return {clipName, stcId, byteOffset, byteLength};
+    }
+    return angles[std::min(angle, angles.size() - 1)];
+}
+
+size_t BDMVTitle::GetAngleCount() const {
+    size_t count = 1;
+    for (const auto& item : playItems) {
+        count = std::max(count, item.GetAngleCount());
+    }
+    return count;
+}
+
+std::vector<double> BDMVTitle::GetChapterStarts() const {
+    std::vector<double> itemStarts;
+    double offset = 0;
+    for (const auto& item : playItems) {
+        itemStarts.push_back(offset);
+        offset += item.GetDurationSeconds();
+    }
+    
+    std::vector<double> starts;
+    for (const auto& mark : marks) {
+        if (mark.type != 1 || mark.playItemId >= playItems.size()) {
+            continue;
+        }
+        const PlayItem& item = playItems[mark.playItemId];
+        uint32_t time = std::min(std::max(mark.time, item.inTime), item.outTime);
+        starts.push_back(itemStarts[mark.playItemId] + (time - item.inTime) / 45000.0);
+    }
+    
+    // Discs repeat a mark at an item boundary or put one on the last frame;
+    // neither starts a chapter anyone can see
+    std::sort(starts.begin(), starts.end());
+    starts.erase(std::unique(starts.begin(), starts.end(),
+                             [](double a, double b) { return b - a < 0.001; }),
+                 starts.end());
+    while (!starts.empty() && starts.back() >= offset - 1.0) {
+        starts.pop_back();
+    }
+    return starts;
+}
+
+bool BDMVTitle::GetChapterRange(int first, int last, double& startTime, double& endTime) const {
+    std::vector<double> starts = GetChapterStarts();
+    if (first < 1 || last < first || first > static_cast<int>(starts.size())) {
+        return false;
+    }
+    startTime = starts[first - 1];
+    endTime = last < static_cast<int>(starts.size()) ? starts[last] : 0;
+    return true;
+}
+
+std::vector<ClipReference> BDMVTitle::GetClips(size_t angle) const {
+    std::vector<ClipReference> clips;
+    for (const auto& item : playItems) {
+        clips.push_back(item.GetAngle(angle));
+    }
+    return clips;
+}
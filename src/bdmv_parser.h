@@ -1,19 +1,79 @@
 #pragma once
-#include <windows.h>
 #include <string>
 #include <vector>
 #include <map>
 #include <set>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include "clpi_parser.h"
 
 namespace fs = std::filesystem;
 
+// A clip as a playlist refers to it: the IN/OUT times of the referring item
+// are on the clock of the clip's STC sequence ref_to_STC_id
+struct ClipReference {
+    std::string clipName;
+    uint8_t stcId = 0;
+    // Part of the clip file the referring item plays, from the clip's EP_map;
+    // byteLength 0 if unknown, in which case the whole file is read
+    uint64_t byteOffset = 0;
+    uint64_t byteLength = 0;
+};
+
 struct PlayItem {
     std::string clipName;
     uint32_t inTime;
     uint32_t outTime;
+    uint8_t stcId = 0;               // ref_to_STC_id of clipName
+    uint64_t byteOffset = 0;         // EP_map byte range of the window in clipName, as in ClipReference
+    uint64_t byteLength = 0;
+    uint8_t connectionCondition = 1; // To the previous item: 1 not seamless, 5 clean break, 6 seamless
+    bool isMultiAngle = false;
+    bool isSeamlessAngleChange = false;
+    std::vector<ClipReference> angles; // Multi-angle items only: every angle, angles[0] is clipName
+    std::vector<StreamInfo> streams; // STN_table: streams selectable during this item
     double GetDurationSeconds() const;
+    size_t GetAngleCount() const { return isMultiAngle ? angles.size() : 1; }
+    // Clip of a 0-based angle; items with fewer angles play their only clip
+    ClipReference GetAngle(size_t angle) const;
+};
+
+// Clips presented alongside the main path (PiP video, browsable slideshow
+// audio, text subtitles, the MVC dependent view), timed against a play item
+struct SubPlayItem {
+    std::string clipName;
+    uint8_t stcId = 0;
+    uint8_t connectionCondition = 1;
+    uint32_t inTime = 0;
+    uint32_t outTime = 0;
+    uint16_t syncPlayItemId = 0; // Main-path item during which this one starts
+    uint32_t syncStartPts = 0;   // 45kHz time within that item
+    std::vector<ClipReference> clips; // is_multi_Clip_entries: alternatives, clips[0] is clipName
+};
+
+struct SubPath {
+    uint8_t type = 0; // SubPath_type, e.g. 4 text subtitles, 5/6/7 picture-in-picture, 8 MVC
+    bool isRepeat = false;
+    std::vector<SubPlayItem> items;
+};
+
+// PlayListMark entry; entry marks are the disc's chapter points
+struct PlayListMark {
+    uint8_t type = 1;        // 1 entry mark, 2 link point
+    uint16_t playItemId = 0;
+    uint32_t time = 0;       // 45kHz, on the play item's clock
+};
+
+struct IndexTitle {
+    bool isBDJ = false;
+    uint16_t movieObjectId = 0; // HDMV titles
+    std::string bdjoName;       // BD-J titles
+};
+
+struct BDMVIndex {
+    std::string version;
+    std::vector<IndexTitle> titles;
 };
 
 struct BDMVTitle {
@@ -21,23 +81,103 @@ struct BDMVTitle {
     std::string filename;
     double duration;
     size_t size;
-    std::vector<std::string> audioLanguages;
-    std::vector<std::string> subtitleLanguages;
+    std::vector<LanguageId> audioLanguages;
+    std::vector<LanguageId> subtitleLanguages;
+    std::vector<StreamInfo> streams; // Union of the play items' STN_tables, in STN order
+    std::vector<PlayItem> playItems;
+    std::vector<SubPath> subPaths;
+    std::vector<PlayListMark> marks;
+    std::vector<std::string> duplicates; // Playlists collapsed into this one during the scan
+    std::string selectionNote;           // Why this playlist was kept over its duplicates
+    bool analyzed = false;               // Languages determined by AnalyzeTitleStreams
+
+    // Most angles of any play item; 1 for single-angle titles
+    size_t GetAngleCount() const;
+    // Clips and byte ranges in playback order for a 0-based angle
+    std::vector<ClipReference> GetClips(size_t angle = 0) const;
+    // Title time in seconds at which each entry mark (chapter) starts, in
+    // order, without duplicates or marks in the title's last second
+    std::vector<double> GetChapterStarts() const;
+    // Title time range of chapters first..last (1-based); end 0 is the title's end
+    bool GetChapterRange(int first, int last, double& startTime, double& endTime) const;
 };
 
-class BDMVParser {
-private:
-    static std::map<std::string, std::string> languageMap;
+// Parsed CLPI files shared by all playlists of a disc while it is scanned
+class ClipInfoCache {
+public:
+    bool Find(const std::string& clipName, ClipInfo& clip) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = clips.find(clipName);
+        if (it == clips.end()) {
+            return false;
+        }
+        clip = it->second;
+        return true;
+    }
+    
+    void Insert(const ClipInfo& clip) {
+        std::lock_guard<std::mutex> lock(mutex);
+        clips.emplace(clip.clipName, clip);
+    }
     
+private:
+    std::mutex mutex;
+    std::map<std::string, ClipInfo> clips;
+};
+
+// How far a folder scan goes. Structure reads only the playlists and the clips'
+// EP_maps: names, durations, sizes, and the languages an STN_table declares.
+// Full also resolves the remaining titles' languages from CLPI program info or
+// ffprobe, which may read the streams themselves.
+enum class ScanDepth {
+    Structure,
+    Full
+};
+
+class BDMVParser {
 public:
-    static std::vector<BDMVTitle> ParseBDMVFolder(const std::string& path);
-    static BDMVTitle ParseMPLSFile(const fs::path& mplsPath, const fs::path& streamDir);
-    static PlayItem ParsePlayItem(std::ifstream& file);
-    static std::vector<std::string> GetAudioLanguages(const fs::path& streamDir, 
-                                                     const std::vector<PlayItem>& playItems);
-    static std::vector<std::string> GetSubtitleLanguages(const fs::path& streamDir, 
-                                                        const std::vector<PlayItem>& playItems);
-    static std::set<std::string> AnalyzeStreamLanguages(const fs::path& m2tsPath, 
-                                                       const std::string& streamType);
-    static std::string GetLanguageName(const std::string& code);
+    // Titles of a Structure scan with analyzed unset still need AnalyzeTitleStreams;
+    // only fully analyzed scans are written to the scan cache
+    static std::vector<BDMVTitle> ParseBDMVFolder(const std::string& path, bool useCache = true,
+                                                  ScanDepth depth = ScanDepth::Full);
+    // Caches a folder scan once every title has been analyzed; for scans
+    // completed after the fact, title by title
+    static void StoreScan(const std::string& path, const std::vector<BDMVTitle>& titles);
+    static BDMVTitle ParseMPLSFile(const fs::path& mplsPath, const fs::path& streamDir,
+                                   ClipInfoCache* clipCache = nullptr);
+    static BDMVTitle ParseMPLSStructure(const fs::path& mplsPath);
+    static void AnalyzeTitle(BDMVTitle& title, const fs::path& streamDir, ClipInfoCache* clipCache);
+    // The deep scan tier of one title: audio and subtitle languages
+    static void AnalyzeTitleStreams(BDMVTitle& title, const fs::path& streamDir, ClipInfoCache* clipCache);
+    // Sets the play items' EP_map byte ranges and the title size
+    static void MeasureTitle(BDMVTitle& title, const fs::path& streamDir, ClipInfoCache& clipCache);
+    // Cuts a title to the time range [startTime, endTime) in seconds (endTime 0:
+    // to the end). startTime moves back to the entry point before it, so the
+    // cut title begins on a keyframe; duration, marks and byte ranges follow.
+    // False if nothing of the title is left.
+    static bool TrimTitle(BDMVTitle& title, const fs::path& streamDir, double& startTime, double endTime);
+    static void CollapseDuplicateTitles(std::vector<BDMVTitle>& titles);
+    static PlayItem ParsePlayItem(ByteReader& reader);
+    static SubPath ParseSubPath(ByteReader& reader);
+    static SubPlayItem ParseSubPlayItem(ByteReader& reader);
+    static void ParseSTNTable(ByteReader& reader, std::vector<StreamInfo>& streams);
+    static bool ParseIndexFile(const fs::path& indexPath, BDMVIndex& index);
+    static bool FindClipInfo(const fs::path& clipinfDir, const std::string& clipName,
+                             ClipInfoCache& clipCache, ClipInfo& clip);
+    static std::vector<ClipInfo> LoadClipInfo(const fs::path& clipinfDir,
+                                              const std::vector<PlayItem>& playItems,
+                                              ClipInfoCache& clipCache);
+    // False if the languages could not be determined; result is left alone then
+    static bool GetAudioLanguages(const fs::path& streamDir, 
+                                  const std::vector<PlayItem>& playItems,
+                                  const std::vector<StreamInfo>& streams,
+                                  std::vector<LanguageId>& result);
+    static bool GetSubtitleLanguages(const fs::path& streamDir, 
+                                     const std::vector<PlayItem>& playItems,
+                                     const std::vector<StreamInfo>& streams,
+                                     std::vector<LanguageId>& result);
+    // Adds the languages of the file's streams of streamType ("audio", "subtitle")
+    // as reported by ffprobe; false if ffprobe could not read the file
+    static bool AnalyzeStreamLanguages(const fs::path& m2tsPath, const std::string& streamType,
+                                       std::set<LanguageId>& languages);
 };
\ No newline at end of file
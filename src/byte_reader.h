@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Bounds-checked big-endian cursor over an in-memory buffer. Blu-ray
+// metadata files are small, so they are read whole (DiscFileSystem::ReadFile) and
+// decoded from memory; running past the end throws std::out_of_range.
+class ByteReader {
+public:
+    ByteReader(const uint8_t* data, size_t size) : data(data), size(size), pos(0) {}
+    explicit ByteReader(const std::vector<uint8_t>& buffer) : ByteReader(buffer.data(), buffer.size()) {}
+
+    uint8_t ReadU8() {
+        Require(1);
+        return data[pos++];
+    }
+
+    uint16_t ReadU16() {
+        Require(2);
+        uint16_t value = static_cast<uint16_t>((data[pos] << 8) | data[pos + 1]);
+        pos += 2;
+        return value;
+    }
+
+    uint32_t ReadU32() {
+        Require(4);
+        uint32_t value = (static_cast<uint32_t>(data[pos]) << 24) |
+                         (static_cast<uint32_t>(data[pos + 1]) << 16) |
+                         (static_cast<uint32_t>(data[pos + 2]) << 8) |
+                         static_cast<uint32_t>(data[pos + 3]);
+        pos += 4;
+        return value;
+    }
+
+    uint64_t ReadU64() {
+        uint64_t high = ReadU32();
+        return (high << 32) | ReadU32();
+    }
+
+    std::string ReadString(size_t length) {
+        Require(length);
+        std::string value(reinterpret_cast<const char*>(data + pos), length);
+        pos += length;
+        return value;
+    }
+
+    void Skip(size_t count) {
+        Require(count);
+        pos += count;
+    }
+
+    void Seek(size_t offset) {
+        if (offset > size) {
+            throw std::out_of_range("ByteReader seek past end of buffer");
+        }
+        pos = offset;
+    }
+
+    // Returns a reader over the next `length` bytes and advances past them
+    ByteReader SubReader(size_t length) {
+        Require(length);
+        ByteReader sub(data + pos, length);
+        pos += length;
+        return sub;
+    }
+
+    // Returns a reader over [offset, offset + length) without moving the cursor
+    ByteReader Slice(size_t offset, size_t length) const {
+        if (offset > size || length > size - offset) {
+            throw std::out_of_range("ByteReader slice past end of buffer");
+        }
+        return ByteReader(data + offset, length);
+    }
+
+    const uint8_t* Current() const { return data + pos; }
+    size_t Tell() const { return pos; }
+    size_t Size() const { return size; }
+    size_t Remaining() const { return size - pos; }
+
+private:
+    void Require(size_t count) const {
+        if (count > size - pos) {
+            throw std::out_of_range("ByteReader read past end of buffer");
+        }
+    }
+
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+};
+
+// Reads a whole file with a single read call
+inline bool ReadFileBytes(const fs::path& path, std::vector<uint8_t>& buffer) {
+    std::error_code ec;
+    uintmax_t fileSize = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    buffer.resize(static_cast<size_t>(fileSize));
+    if (fileSize > 0 && !file.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) {
+        return false;
+    }
+    return true;
+}
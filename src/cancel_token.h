@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+
+// One-shot cancellation signal shared by the UI, the remux scheduler and the
+// jobs it runs. Blocking work (a child process, a demux loop) registers a
+// callback so it can be interrupted rather than polled.
+class CancelToken {
+public:
+    using Callback = std::function<void()>;
+
+    // Unregisters its callback when destroyed. Destruction waits for a
+    // Cancel() that is running the callback right now, so the callback may
+    // safely touch objects that outlive the registration.
+    class Registration {
+    public:
+        Registration() = default;
+        Registration(const CancelToken* token, uint64_t id) : token(token), id(id) {}
+        Registration(Registration&& other) noexcept : token(other.token), id(other.id) { other.token = nullptr; }
+        Registration& operator=(Registration&& other) noexcept {
+            if (this != &other) {
+                Reset();
+                token = other.token;
+                id = other.id;
+                other.token = nullptr;
+            }
+            return *this;
+        }
+        ~Registration() { Reset(); }
+
+        void Reset() {
+            if (token) {
+                token->Unregister(id);
+                token = nullptr;
+            }
+        }
+
+    private:
+        const CancelToken* token = nullptr;
+        uint64_t id = 0;
+    };
+
+    CancelToken() = default;
+    CancelToken(const CancelToken&) = delete;
+    CancelToken& operator=(const CancelToken&) = delete;
+
+    void Cancel() {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (cancelled.exchange(true)) {
+            return;
+        }
+        // Callbacks may register or unregister on this thread; iterate a copy
+        auto pending = callbacks;
+        for (auto& entry : pending) {
+            entry.second();
+        }
+    }
+
+    bool IsCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+    // Runs the callback on the cancelling thread, or right away if already cancelled
+    [[nodiscard]] Registration OnCancel(Callback callback) const {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (cancelled) {
+            callback();
+            return Registration();
+        }
+        uint64_t id = nextId++;
+        callbacks.emplace(id, std::move(callback));
+        return Registration(this, id);
+    }
+
+private:
+    void Unregister(uint64_t id) const {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        callbacks.erase(id);
+    }
+
+    std::atomic<bool> cancelled{false};
+    mutable std::recursive_mutex mutex;
+    mutable std::map<uint64_t, Callback> callbacks;
+    mutable uint64_t nextId = 1;
+};
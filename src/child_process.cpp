@@ -0,0 +1,466 @@
+#include "child_process.h"
+#include <algorithm>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr std::chrono::milliseconds PollInterval{20};
+
+} // namespace
+
+ChildProcess::~ChildProcess() {
+    bool stillRunning;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stillRunning = running;
+    }
+    if (stillRunning) {
+        Terminate();
+        Wait();
+    }
+    CloseInput();
+    Cleanup();
+}
+
+int ChildProcess::Run(const std::vector<std::string>& arguments, std::string& output,
+                      std::chrono::milliseconds timeout) {
+    ChildProcess process;
+    if (!process.Start(arguments, [&output](const char* data, size_t size) { output.append(data, size); })) {
+        return -1;
+    }
+    return process.Wait(timeout);
+}
+
+std::string ChildProcess::FormatCommandLine(const std::vector<std::string>& arguments) {
+    std::ostringstream line;
+    for (size_t i = 0; i < arguments.size(); i++) {
+        const std::string& argument = arguments[i];
+        if (i > 0) {
+            line << ' ';
+        }
+        if (!argument.empty() && argument.find_first_of(" \t\"") == std::string::npos) {
+            line << argument;
+            continue;
+        }
+
+        // Backslashes are literal unless they precede a quote
+        line << '"';
+        size_t backslashes = 0;
+        for (char c : argument) {
+            if (c == '\\') {
+                backslashes++;
+                continue;
+            }
+            if (c == '"') {
+                line << std::string(backslashes * 2 + 1, '\\') << '"';
+            } else {
+                line << std::string(backslashes, '\\') << c;
+            }
+            backslashes = 0;
+        }
+        line << std::string(backslashes * 2, '\\') << '"';
+    }
+    return line.str();
+}
+
+#ifdef _WIN32
+
+bool ChildProcess::Start(const std::vector<std::string>& arguments, OutputCallback onOutput, bool pipeInput) {
+    if (running || arguments.empty()) {
+        return false;
+    }
+
+    // Only the child's ends are inheritable, and the handle list below hands
+    // them to this child alone: a job started at the same time must not pick
+    // up our stdout write end, or our reader would wait for its exit too
+    SECURITY_ATTRIBUTES sa = {};
+    sa.nLength = sizeof(sa);
+    sa.bInheritHandle = TRUE;
+
+    HANDLE readEnd = nullptr;
+    HANDLE writeEnd = nullptr;
+    if (!CreatePipe(&readEnd, &writeEnd, &sa, 0)) {
+        return false;
+    }
+    SetHandleInformation(readEnd, HANDLE_FLAG_INHERIT, 0);
+
+    HANDLE inputRead = nullptr;
+    HANDLE inputWrite = nullptr;
+    if (pipeInput) {
+        if (!CreatePipe(&inputRead, &inputWrite, &sa, 1024 * 1024)) {
+            CloseHandle(readEnd);
+            CloseHandle(writeEnd);
+            return false;
+        }
+        SetHandleInformation(inputWrite, HANDLE_FLAG_INHERIT, 0);
+    }
+
+    HANDLE inherited[2] = {writeEnd, inputRead};
+    DWORD inheritedCount = inputRead ? 2 : 1;
+    SIZE_T attributeSize = 0;
+    InitializeProcThreadAttributeList(nullptr, 1, 0, &attributeSize);
+    std::vector<char> attributeBuffer(attributeSize);
+    auto attributes = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributeBuffer.data());
+    bool haveAttributes = InitializeProcThreadAttributeList(attributes, 1, 0, &attributeSize) &&
+                          UpdateProcThreadAttribute(attributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inherited,
+                                                    inheritedCount * sizeof(HANDLE), nullptr, nullptr);
+
+    // Closing the last job handle kills whatever is still in it
+    HANDLE jobHandle = CreateJobObjectA(nullptr, nullptr);
+    if (jobHandle) {
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {};
+        limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+        SetInformationJobObject(jobHandle, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+    }
+
+    STARTUPINFOEXA si = {};
+    PROCESS_INFORMATION pi = {};
+    si.StartupInfo.cb = sizeof(si);
+    si.StartupInfo.dwFlags = STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES;
+    si.StartupInfo.wShowWindow = SW_HIDE;
+    si.StartupInfo.hStdInput = inputRead;
+    si.StartupInfo.hStdOutput = writeEnd;
+    si.StartupInfo.hStdError = writeEnd;
+    si.lpAttributeList = attributes;
+
+    // Suspended until it is in the job, so nothing it spawns can escape
+    std::string commandLine = FormatCommandLine(arguments);
+    BOOL success = haveAttributes && CreateProcessA(
+        nullptr, &commandLine[0],
+        nullptr, nullptr, TRUE, CREATE_SUSPENDED | CREATE_NO_WINDOW | EXTENDED_STARTUPINFO_PRESENT,
+        nullptr, nullptr, &si.StartupInfo, &pi
+    );
+    if (haveAttributes) {
+        DeleteProcThreadAttributeList(attributes);
+    }
+
+    // Our copy of the write end must go, or the reader never sees end-of-file
+    CloseHandle(writeEnd);
+    if (inputRead) {
+        CloseHandle(inputRead);
+    }
+
+    if (!success) {
+        CloseHandle(readEnd);
+        if (inputWrite) {
+            CloseHandle(inputWrite);
+        }
+        if (jobHandle) {
+            CloseHandle(jobHandle);
+        }
+        return false;
+    }
+
+    if (jobHandle) {
+        AssignProcessToJobObject(jobHandle, pi.hProcess);
+    }
+    ResumeThread(pi.hThread);
+    CloseHandle(pi.hThread);
+
+    process = pi.hProcess;
+    job = jobHandle;
+    readPipe = readEnd;
+    inputPipe = inputWrite;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        running = true;
+    }
+
+    reader = std::thread([this, onOutput]() {
+        char buffer[4096];
+        DWORD bytesRead = 0;
+        while (ReadFile(readPipe, buffer, sizeof(buffer), &bytesRead, nullptr) && bytesRead > 0) {
+            if (onOutput) {
+                onOutput(buffer, bytesRead);
+            }
+        }
+    });
+    return true;
+}
+
+bool ChildProcess::WriteInput(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (inputPipe && size > 0) {
+        DWORD written = 0;
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1 << 20));
+        if (!WriteFile(inputPipe, bytes, chunk, &written, nullptr)) {
+            return false; // ERROR_NO_DATA: the child closed its end
+        }
+        bytes += written;
+        size -= written;
+    }
+    return inputPipe != nullptr;
+}
+
+void ChildProcess::CloseInput() {
+    if (inputPipe) {
+        CloseHandle(inputPipe);
+        inputPipe = nullptr;
+    }
+}
+
+int ChildProcess::Wait(std::chrono::milliseconds timeout) {
+    if (!process) {
+        return exitCode;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    while (WaitForSingleObject(process, static_cast<DWORD>(PollInterval.count())) != WAIT_OBJECT_0) {
+        if (timeout != std::chrono::milliseconds::max() &&
+            std::chrono::steady_clock::now() - start >= timeout) {
+            Terminate();
+        }
+    }
+
+    DWORD code = 0;
+    GetExitCodeProcess(process, &code);
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        running = false;
+    }
+    exitCode = terminateRequested ? -1 : static_cast<int>(code);
+
+    // Anything the child left behind goes with the job, which also closes the pipe
+    if (job) {
+        CloseHandle(job);
+        job = nullptr;
+    }
+    Cleanup();
+    return exitCode;
+}
+
+void ChildProcess::Terminate() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (!running || terminateRequested) {
+        return;
+    }
+    terminateRequested = true;
+    terminateTime = std::chrono::steady_clock::now();
+
+    // Job Objects have no polite stop; the whole tree goes at once
+    if (job) {
+        TerminateJobObject(job, 1);
+    } else {
+        TerminateProcess(process, 1);
+    }
+}
+
+void ChildProcess::Cleanup() {
+    if (reader.joinable()) {
+        reader.join();
+    }
+    if (readPipe) {
+        CloseHandle(readPipe);
+        readPipe = nullptr;
+    }
+    if (process) {
+        CloseHandle(process);
+        process = nullptr;
+    }
+    if (job) {
+        CloseHandle(job);
+        job = nullptr;
+    }
+}
+
+#else
+
+bool ChildProcess::Start(const std::vector<std::string>& arguments, OutputCallback onOutput, bool pipeInput) {
+    if (running || arguments.empty()) {
+        return false;
+    }
+
+    // Close-on-exec from the start: a child forked by another job in the
+    // meantime must not inherit these, or our reader would wait for it too
+    // and the child's stdin would never see EPIPE. dup2 clears the flag on
+    // the stdio descriptors this child gets.
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return false;
+    }
+
+    int inputFds[2] = {-1, -1};
+    if (pipeInput) {
+        if (pipe2(inputFds, O_CLOEXEC) != 0) {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+
+        // A child that exits early must fail our write with EPIPE, not kill us
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    // Built before fork: the child may only make async-signal-safe calls
+    std::vector<char*> argv;
+    for (const auto& argument : arguments) {
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t child = fork();
+    if (child < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        if (pipeInput) {
+            close(inputFds[0]);
+            close(inputFds[1]);
+        }
+        return false;
+    }
+
+    if (child == 0) {
+        setpgid(0, 0);
+        if (pipeInput) {
+            // Ignored signals survive exec; the child gets the default back
+            signal(SIGPIPE, SIG_DFL);
+            dup2(inputFds[0], STDIN_FILENO);
+        } else {
+            int devNull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            if (devNull >= 0) {
+                dup2(devNull, STDIN_FILENO);
+            }
+        }
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    // Set on both sides so the group exists before either one relies on it
+    setpgid(child, child);
+    close(fds[1]);
+    if (pipeInput) {
+        close(inputFds[0]);
+    }
+
+    pid = child;
+    readFd = fds[0];
+    inputFd = inputFds[1];
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        running = true;
+    }
+
+    reader = std::thread([this, onOutput]() {
+        char buffer[4096];
+        while (true) {
+            ssize_t bytesRead = read(readFd, buffer, sizeof(buffer));
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytesRead <= 0) {
+                break;
+            }
+            if (onOutput) {
+                onOutput(buffer, static_cast<size_t>(bytesRead));
+            }
+        }
+    });
+    return true;
+}
+
+bool ChildProcess::WriteInput(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (inputFd >= 0 && size > 0) {
+        ssize_t written = write(inputFd, bytes, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false; // EPIPE: the child closed its end
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return inputFd >= 0;
+}
+
+void ChildProcess::CloseInput() {
+    if (inputFd >= 0) {
+        close(inputFd);
+        inputFd = -1;
+    }
+}
+
+int ChildProcess::Wait(std::chrono::milliseconds timeout) {
+    if (pid <= 0) {
+        return exitCode;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    while (true) {
+        // WNOWAIT leaves the child a zombie, so its process group ID cannot be
+        // reused before we have cleaned up the rest of the group below
+        siginfo_t info = {};
+        int result = waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOHANG | WNOWAIT);
+        if (result == 0 && info.si_pid == pid) {
+            break;
+        }
+        if (result < 0 && errno == ECHILD) {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (timeout != std::chrono::milliseconds::max() && now - start >= timeout) {
+            Terminate();
+        }
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (terminateRequested && now - terminateTime >= TerminateGrace) {
+                kill(-pid, SIGKILL);
+            }
+        }
+        std::this_thread::sleep_for(PollInterval);
+    }
+
+    // Anything the child left running would keep the pipe open
+    kill(-pid, SIGKILL);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        running = false;
+    }
+    exitCode = (!terminateRequested && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+    pid = -1;
+
+    Cleanup();
+    return exitCode;
+}
+
+void ChildProcess::Terminate() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (!running || terminateRequested) {
+        return;
+    }
+    terminateRequested = true;
+    terminateTime = std::chrono::steady_clock::now();
+
+    // Ask politely first; Wait() escalates to SIGKILL after TerminateGrace
+    kill(-pid, SIGTERM);
+}
+
+void ChildProcess::Cleanup() {
+    if (reader.joinable()) {
+        reader.join();
+    }
+    if (readFd >= 0) {
+        close(readFd);
+        readFd = -1;
+    }
+}
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs a child process with stdout and stderr merged into one pipe that a
+// reader thread drains. The child and everything it spawns live in their own
+// Job Object (Windows) or process group (POSIX), so Terminate() takes down
+// the whole tree and not just the immediate child.
+class ChildProcess {
+public:
+    using OutputCallback = std::function<void(const char* data, size_t size)>;
+
+    // How long a terminated tree gets to exit before it is killed outright
+    static constexpr std::chrono::milliseconds TerminateGrace{2000};
+
+    ChildProcess() = default;
+    ~ChildProcess();
+
+    ChildProcess(const ChildProcess&) = delete;
+    ChildProcess& operator=(const ChildProcess&) = delete;
+
+    // arguments[0] is the program, looked up on PATH. With pipeInput the
+    // child's stdin is a pipe fed by WriteInput; otherwise it is empty.
+    bool Start(const std::vector<std::string>& arguments, OutputCallback onOutput, bool pipeInput = false);
+
+    // Blocks until the child has taken all of it. Returns false once the child
+    // has closed its stdin or exited. Only one thread may write.
+    bool WriteInput(const void* data, size_t size);
+    // End of input for the child; call once the writer is done
+    void CloseInput();
+
+    // Waits for the child to exit and returns its exit code, or -1 if it was
+    // terminated. Past the timeout the tree is terminated.
+    int Wait(std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+
+    // Thread-safe; may be called from a cancel callback while another thread is in Wait()
+    void Terminate();
+
+    bool WasTerminated() const { return terminateRequested; }
+
+    // Runs to completion and collects stdout and stderr. Returns the exit
+    // code, or -1 if the program could not be started or ran past the timeout.
+    static int Run(const std::vector<std::string>& arguments, std::string& output,
+                   std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+
+    // Quoted as CreateProcess/CommandLineToArgvW expect; also used for logging
+    static std::string FormatCommandLine(const std::vector<std::string>& arguments);
+
+private:
+    void Cleanup();
+
+    std::thread reader;
+    std::mutex stateMutex;
+    bool running = false;
+    std::atomic<bool> terminateRequested{false};
+    std::chrono::steady_clock::time_point terminateTime;
+    int exitCode = -1;
+
+#ifdef _WIN32
+    void* process = nullptr;
+    void* job = nullptr;
+    void* readPipe = nullptr;
+    void* inputPipe = nullptr;
+#else
+    int pid = -1;
+    int readFd = -1;
+    int inputFd = -1;
+#endif
+};
@@ -0,0 +1,309 @@
+// multiremux: headless batch front end over the same core as the Win32 UI.
+//
+//   multiremux -o /srv/out -a eng,jpn -s eng -j 4 /mnt/disc1 /srv/iso/disc2.iso ...
+
+#include "remux_batch.h"
+#include "ffmpeg_wrapper.h"
+#include "log_ring.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> interrupted{false};
+
+void OnSignal(int) {
+    interrupted = true;
+}
+
+void PrintUsage() {
+    std::fprintf(stderr,
+        "Usage: multiremux -o <output dir> [options] <disc root>...\n"
+        "\n"
+        "  -o, --output DIR      Where the MKVs (and the job journal) go\n"
+        "  -a, --audio LANGS     Audio languages, e.g. eng,jpn or English (default: all)\n"
+        "  -s, --subs LANGS      Subtitle languages (default: none)\n"
+        "  -j, --jobs N          Titles remuxed at once, within the device limits\n"
+        "                        below (default: 4)\n"
+        "      --per-device N    Jobs using one source device at once (default: 1)\n"
+        "      --per-dest-device N\n"
+        "                        Jobs using the output device at once (default: -j)\n"
+        "      --native          Use the built-in muxer where it supports the streams\n"
+        "      --direct-io       Built-in muxer writes bypass the OS cache (O_DIRECT)\n"
+        "      --angle N         Angle to remux from multi-angle titles (default: 1)\n"
+        "      --range FROM[-TO] Only this part of each title; times in seconds or\n"
+        "                        [h:]m:s, e.g. 1:00:00-1:00:30 for a 30 second sample\n"
+        "      --chapters A[-B]  Only chapters A to B (or A to the end with A-)\n"
+        "      --ffmpeg PATH     ffmpeg executable (default: ffmpeg on PATH)\n"
+        "  -q, --quiet           Only print errors and the final summary\n"
+        "      --log FILE        Also write every log line to FILE (rotated at 8 MB)\n"
+        "\n"
+        "A disc root is a BDMV folder, the folder that contains it, or an .iso\n"
+        "image (read directly, no mounting needed). Titles that completed in an\n"
+        "earlier run into the same output directory are skipped.\n");
+}
+
+// "eng,Japanese" -> {eng, jpn}; false (naming the culprit) for an unknown language
+bool ParseLanguages(const std::string& list, std::vector<LanguageId>& languages) {
+    languages.clear();
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        LanguageId language;
+        if (item.empty()) {
+            continue;
+        }
+        if (!LanguageId::Parse(item, language)) {
+            std::fprintf(stderr, "multiremux: unknown language %s\n", item.c_str());
+            return false;
+        }
+        languages.push_back(language);
+    }
+    return true;
+}
+
+bool ParseCount(const std::string& text, int& value) {
+    char* end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0' || parsed < 1 || parsed > 256) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// "90", "1:30" or "1:00:00.5" in seconds
+bool ParseTime(const std::string& text, double& seconds) {
+    seconds = 0;
+    std::istringstream stream(text);
+    std::string part;
+    int parts = 0;
+    while (std::getline(stream, part, ':')) {
+        char* end = nullptr;
+        double value = std::strtod(part.c_str(), &end);
+        if (part.empty() || *end != '\0' || value < 0 || ++parts > 3) {
+            return false;
+        }
+        seconds = seconds * 60 + value;
+    }
+    return parts > 0;
+}
+
+// Splits "FROM-TO", "FROM-" or "FROM"; to is empty for the last two
+bool SplitRange(const std::string& text, std::string& from, std::string& to, bool& open) {
+    size_t dash = text.find('-');
+    from = text.substr(0, dash);
+    to = dash == std::string::npos ? "" : text.substr(dash + 1);
+    open = dash != std::string::npos && to.empty();
+    return !from.empty();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BatchOptions options;
+    std::vector<std::string> roots;
+    bool quiet = false;
+    bool destinationLimitSet = false;
+    std::string logPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](std::string& out) {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "multiremux: %s needs a value\n", arg.c_str());
+                return false;
+            }
+            out = argv[++i];
+            return true;
+        };
+
+        std::string text;
+        if (arg == "-h" || arg == "--help") {
+            PrintUsage();
+            return 0;
+        } else if (arg == "-o" || arg == "--output") {
+            if (!value(options.outputDirectory)) return 2;
+        } else if (arg == "-a" || arg == "--audio") {
+            if (!value(text) || !ParseLanguages(text, options.languages.audioLanguages)) return 2;
+        } else if (arg == "-s" || arg == "--subs") {
+            if (!value(text) || !ParseLanguages(text, options.languages.subtitleLanguages)) return 2;
+        } else if (arg == "-j" || arg == "--jobs") {
+            if (!value(text) || !ParseCount(text, options.limits.maxConcurrentJobs)) {
+                std::fprintf(stderr, "multiremux: bad job count\n");
+                return 2;
+            }
+        } else if (arg == "--per-device") {
+            if (!value(text) || !ParseCount(text, options.limits.perSourceDevice)) {
+                std::fprintf(stderr, "multiremux: bad per-device limit\n");
+                return 2;
+            }
+        } else if (arg == "--per-dest-device") {
+            if (!value(text) || !ParseCount(text, options.limits.perDestinationDevice)) {
+                std::fprintf(stderr, "multiremux: bad per-dest-device limit\n");
+                return 2;
+            }
+            destinationLimitSet = true;
+        } else if (arg == "--native") {
+            options.backend = RemuxBackend::Native;
+        } else if (arg == "--direct-io") {
+            options.unbufferedOutput = true;
+        } else if (arg == "--angle") {
+            int angle = 0;
+            if (!value(text) || !ParseCount(text, angle)) {
+                std::fprintf(stderr, "multiremux: bad angle\n");
+                return 2;
+            }
+            options.angle = static_cast<size_t>(angle - 1);
+        } else if (arg == "--range") {
+            std::string from, to;
+            bool open = false;
+            if (!value(text) || !SplitRange(text, from, to, open) || !ParseTime(from, options.startTime) ||
+                (!to.empty() && (!ParseTime(to, options.endTime) || options.endTime <= options.startTime))) {
+                std::fprintf(stderr, "multiremux: bad time range\n");
+                return 2;
+            }
+        } else if (arg == "--chapters") {
+            std::string from, to;
+            bool open = false;
+            if (!value(text) || !SplitRange(text, from, to, open) || !ParseCount(from, options.firstChapter) ||
+                (!to.empty() && (!ParseCount(to, options.lastChapter) || options.lastChapter < options.firstChapter))) {
+                std::fprintf(stderr, "multiremux: bad chapter range\n");
+                return 2;
+            }
+            if (to.empty()) {
+                options.lastChapter = open ? 0 : options.firstChapter;
+            }
+        } else if (arg == "--ffmpeg") {
+            if (!value(options.ffmpegPath)) return 2;
+        } else if (arg == "-q" || arg == "--quiet") {
+            quiet = true;
+        } else if (arg == "--log") {
+            if (!value(logPath)) return 2;
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::fprintf(stderr, "multiremux: unknown option %s\n", arg.c_str());
+            PrintUsage();
+            return 2;
+        } else {
+            roots.push_back(arg);
+        }
+    }
+
+    if (options.outputDirectory.empty() || roots.empty()) {
+        PrintUsage();
+        return 2;
+    }
+    // Every job writes to the one output directory; left at the scheduler's
+    // default, its device alone would hold -j down to 2
+    if (!destinationLimitSet) {
+        options.limits.perDestinationDevice = options.limits.maxConcurrentJobs;
+    }
+    if (options.backend == RemuxBackend::FFmpeg && !FFmpegWrapper::IsFFmpegAvailable(options.ffmpegPath)) {
+        std::fprintf(stderr, "multiremux: cannot run %s\n", options.ffmpegPath.c_str());
+        return 2;
+    }
+
+    RotatingLogFile logFile;
+    if (!logPath.empty() && !logFile.Open(logPath)) {
+        std::fprintf(stderr, "multiremux: cannot write %s\n", logPath.c_str());
+        return 2;
+    }
+
+    // The log file gets every line, including the ones --quiet keeps off stdout.
+    // Callers hold outputMutex.
+    std::mutex outputMutex;
+    auto mirror = [&](const std::string& message) {
+        if (logFile.IsOpen()) {
+            logFile.Write(FormatLogLine({std::chrono::system_clock::now(), message}) + "\n");
+        }
+    };
+    auto log = [&](const std::string& message) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::printf("%s\n", message.c_str());
+        std::fflush(stdout);
+        mirror(message);
+    };
+
+    std::vector<BDMVFile> files;
+    for (const auto& root : roots) {
+        BDMVFile file;
+        if (RemuxBatch::AnalyzeDisc(root, file, log)) {
+            if (!quiet) {
+                log("Added: " + file.description + " (" + std::to_string(file.titles.size()) + " titles)");
+            }
+            files.push_back(std::move(file));
+        } else {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::fprintf(stderr, "multiremux: no Blu-ray titles in %s\n", root.c_str());
+        }
+    }
+    if (files.empty()) {
+        return 1;
+    }
+
+    std::map<size_t, RemuxProgress> progress;
+    BatchEvents events;
+    events.onLog = [&](const std::string& message) {
+        if (!quiet || message.rfind("Error", 0) == 0) {
+            log(message);
+        } else {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            mirror(message);
+        }
+    };
+    events.onProgress = [&](size_t index, const RemuxProgress& update) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        progress[index] = update;
+    };
+    events.onFinished = [&](size_t index, bool) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        progress.erase(index);
+    };
+
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+
+    // Signal handlers cannot take locks, so a watcher thread turns the flag
+    // into a cancel and prints progress while it is at it
+    CancelToken cancel;
+    std::atomic<bool> finished{false};
+    std::thread watcher([&]() {
+        auto lastReport = std::chrono::steady_clock::now();
+        while (!finished) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (interrupted && !cancel.IsCancelled()) {
+                log("Interrupted, stopping running jobs...");
+                cancel.Cancel();
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (!quiet && now - lastReport >= std::chrono::seconds(5)) {
+                lastReport = now;
+                std::lock_guard<std::mutex> lock(outputMutex);
+                for (const auto& entry : progress) {
+                    std::printf("  %s: %s\n", files[entry.first].description.c_str(),
+                                RemuxBatch::FormatProgress(entry.second).c_str());
+                }
+                std::fflush(stdout);
+            }
+        }
+    });
+
+    size_t failed = RemuxBatch::Run(files, options, events, cancel);
+    finished = true;
+    watcher.join();
+
+    log(std::to_string(files.size() - failed) + " of " + std::to_string(files.size()) + " titles completed");
+    if (cancel.IsCancelled()) {
+        return 130;
+    }
+    return failed == 0 ? 0 : 1;
+}
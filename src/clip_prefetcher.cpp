@@ -0,0 +1,195 @@
+#include "clip_prefetcher.h"
+#include <algorithm>
+#include <cstring>
+
+ClipPrefetcher::ClipPrefetcher(std::vector<ClipSpan> clipList, size_t chunkSize, size_t chunkCount)
+    : clips(std::move(clipList)), chunkSize(std::max<size_t>(chunkSize, 64 * 1024)) {
+    storage.resize(std::max<size_t>(chunkCount, 2));
+    for (auto& chunk : storage) {
+        chunk.resize(this->chunkSize);
+        freeChunks.push_back(&chunk);
+    }
+    reader = std::thread(&ClipPrefetcher::ReadLoop, this);
+}
+
+ClipPrefetcher::~ClipPrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    reader.join();
+}
+
+std::vector<uint8_t>* ClipPrefetcher::TakeFreeChunk() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return stopping || !freeChunks.empty(); });
+    if (stopping) {
+        return nullptr;
+    }
+    std::vector<uint8_t>* chunk = freeChunks.back();
+    freeChunks.pop_back();
+    return chunk;
+}
+
+bool ClipPrefetcher::Push(const Chunk& chunk) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return false;
+        }
+        ready.push_back(chunk);
+    }
+    changed.notify_all();
+    return true;
+}
+
+void ClipPrefetcher::ReadLoop() {
+    DiscFile upcoming; // The next clip, opened early for its read-ahead hint
+
+    for (size_t i = 0; i < clips.size(); i++) {
+        DiscFile file;
+        if (upcoming.IsOpen()) {
+            file = std::move(upcoming);
+            upcoming = DiscFile();
+        } else {
+            file.Open(clips[i].path);
+        }
+        if (!file.IsOpen() || clips[i].offset > file.Size()) {
+            Chunk failure;
+            failure.clip = i;
+            failure.end = true;
+            failure.error = true;
+            if (!Push(failure)) {
+                return;
+            }
+            continue;
+        }
+
+        Chunk opened;
+        opened.clip = i;
+        opened.opened = true;
+        if (!Push(opened)) {
+            return;
+        }
+
+        bool error = false;
+        uint64_t endOffset = clips[i].offset + std::min(clips[i].length, file.Size() - clips[i].offset);
+        for (uint64_t offset = clips[i].offset; offset < endOffset;) {
+            std::vector<uint8_t>* buffer = TakeFreeChunk();
+            if (!buffer) {
+                return;
+            }
+
+            // Once the rest of this clip fits in the ring, the drive can
+            // start on the next one; by the time the consumer gets there,
+            // its head is (being) cached
+            uint64_t left = endOffset - offset;
+            if (!upcoming.IsOpen() && i + 1 < clips.size() && left <= chunkSize * storage.size() &&
+                upcoming.Open(clips[i + 1].path)) {
+                upcoming.WillNeed(clips[i + 1].offset, std::min(clips[i + 1].length, NextClipHint));
+            }
+
+            size_t want = static_cast<size_t>(std::min<uint64_t>(chunkSize, left));
+            size_t got = file.ReadAt(offset, buffer->data(), want);
+            if (got == 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeChunks.push_back(buffer);
+                error = true;
+                break;
+            }
+
+            Chunk data;
+            data.clip = i;
+            data.data = buffer;
+            data.size = got;
+            if (!Push(data)) {
+                return;
+            }
+            offset += got;
+        }
+
+        Chunk end;
+        end.clip = i;
+        end.end = true;
+        end.error = error;
+        if (!Push(end)) {
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    readerDone = true;
+    changed.notify_all();
+}
+
+bool ClipPrefetcher::WaitFront(size_t index, std::unique_lock<std::mutex>& lock) {
+    while (true) {
+        // Whatever the consumer left of earlier clips is dropped
+        while (!ready.empty() && ready.front().clip < index) {
+            if (ready.front().data) {
+                freeChunks.push_back(ready.front().data);
+                changed.notify_all();
+            }
+            ready.pop_front();
+        }
+        if (!ready.empty()) {
+            return ready.front().clip == index;
+        }
+        if (readerDone || stopping) {
+            return false;
+        }
+        changed.wait(lock);
+    }
+}
+
+bool ClipPrefetcher::WaitOpened(size_t index) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!WaitFront(index, lock)) {
+        return false;
+    }
+    Chunk& front = ready.front();
+    if (front.opened) {
+        ready.pop_front();
+        return true;
+    }
+    if (front.error) {
+        failed = true;
+    }
+    return false;
+}
+
+size_t ClipPrefetcher::Read(size_t index, void* buffer, size_t size) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (!WaitFront(index, lock)) {
+            return 0;
+        }
+        Chunk& front = ready.front();
+        if (front.opened) {
+            ready.pop_front();
+            continue;
+        }
+        if (front.end) {
+            if (front.error) {
+                failed = true;
+            }
+            return 0; // Stays queued, so later reads of this clip also end
+        }
+
+        // Only this thread touches the front chunk, and the reader only
+        // appends, so the copy can run unlocked
+        lock.unlock();
+        size_t count = std::min(size, front.size - front.consumed);
+        std::memcpy(buffer, front.data->data() + front.consumed, count);
+        lock.lock();
+
+        front.consumed += count;
+        if (front.consumed == front.size) {
+            freeChunks.push_back(front.data);
+            ready.pop_front();
+            changed.notify_all();
+        }
+        return count;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "disc_filesystem.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// One clip of a chain; a play item that covers part of its clip reads only
+// that byte range (PlayItem::byteOffset / byteLength)
+struct ClipSpan {
+    fs::path path;
+    uint64_t offset = 0;
+    uint64_t length = UINT64_MAX; // To the end of the file
+};
+
+// Reads a title's clip chain (one M2TS per play item, in playlist order)
+// ahead of its consumer on a background thread, into a bounded ring of
+// chunks. Reading runs straight across clip boundaries, and the OS is asked
+// to start on the next clip (WillNeed) while the current one is still being
+// read, so seek-bound drives do not stall between clips. Used by the native
+// demuxer (M2TSReader) and by the ffmpeg stdin feed.
+class ClipPrefetcher {
+public:
+    static constexpr size_t DefaultChunkSize = 4 * 1024 * 1024;
+    static constexpr size_t DefaultChunkCount = 8;
+    static constexpr uint64_t NextClipHint = 32 * 1024 * 1024; // Head of the next clip requested early
+
+    explicit ClipPrefetcher(std::vector<ClipSpan> clips, size_t chunkSize = DefaultChunkSize,
+                            size_t chunkCount = DefaultChunkCount);
+    ~ClipPrefetcher();
+
+    ClipPrefetcher(const ClipPrefetcher&) = delete;
+    ClipPrefetcher& operator=(const ClipPrefetcher&) = delete;
+
+    size_t ClipCount() const { return clips.size(); }
+    const fs::path& ClipPath(size_t index) const { return clips[index].path; }
+
+    // Clips are consumed in order. Waits until the clip has been opened;
+    // false if it could not be. Skips whatever is left of earlier clips.
+    bool WaitOpened(size_t index);
+
+    // Next bytes of the clip; 0 at its end or after a read error (see Failed)
+    size_t Read(size_t index, void* buffer, size_t size);
+
+    // A clip could not be opened or read completely
+    bool Failed() const { return failed; }
+
+private:
+    struct Chunk {
+        size_t clip = 0;
+        std::vector<uint8_t>* data = nullptr;
+        size_t size = 0;
+        size_t consumed = 0;
+        bool opened = false; // Marker: the clip is open; carries no data
+        bool end = false;    // Marker: the clip ended (or failed)
+        bool error = false;
+    };
+
+    void ReadLoop();
+    bool Push(const Chunk& chunk);
+    std::vector<uint8_t>* TakeFreeChunk();
+    bool WaitFront(size_t index, std::unique_lock<std::mutex>& lock);
+
+    std::vector<ClipSpan> clips;
+    size_t chunkSize;
+    std::vector<std::vector<uint8_t>> storage;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Chunk> ready;
+    std::vector<std::vector<uint8_t>*> freeChunks;
+    bool stopping = false;
+    bool readerDone = false;
+    std::atomic<bool> failed{false};
+    std::thread reader;
+};
@@ -0,0 +1,322 @@
+#include "clpi_parser.h"
+#include "disc_filesystem.h"
+
+namespace {
+
+LanguageId ReadLanguage(ByteReader& reader) {
+    return LanguageId::FromCode(reader.ReadString(3));
+}
+
+std::string GetChannelLayout(uint8_t presentationType) {
+    switch (presentationType) {
+        case 1:  return "mono";
+        case 3:  return "stereo";
+        case 6:  return "multi";
+        case 12: return "stereo+multi";
+        default: return "";
+    }
+}
+
+int GetSampleRate(uint8_t samplingFrequency) {
+    switch (samplingFrequency) {
+        case 1:  return 48000;
+        case 4:  return 96000;
+        case 5:  return 192000;
+        case 12: return 192000; // 48kHz core + 192kHz extension
+        case 14: return 96000;  // 48kHz core + 96kHz extension
+        default: return 0;
+    }
+}
+
+void ParseSequenceInfo(ByteReader reader, ClipInfo& clip) {
+    reader.Skip(1); // reserved
+    uint8_t atcCount = reader.ReadU8();
+    for (int atc = 0; atc < atcCount; atc++) {
+        reader.Skip(4); // SPN_ATC_start
+        uint8_t stcCount = reader.ReadU8();
+        reader.Skip(1); // offset_STC_id
+        for (int stc = 0; stc < stcCount; stc++) {
+            STCSequence sequence;
+            reader.Skip(2); // PCR_PID
+            sequence.spnStart = reader.ReadU32();
+            sequence.presentationStart = reader.ReadU32();
+            sequence.presentationEnd = reader.ReadU32();
+            clip.stcSequences.push_back(sequence);
+        }
+    }
+}
+
+// EP_map of the first video stream. Each coarse entry holds the high bits
+// of PTS and SPN for a run of fine entries, which hold the low bits.
+void ParseEPMap(ByteReader epMap, ClipInfo& clip) {
+    epMap.Skip(1); // reserved
+    uint8_t streamCount = epMap.ReadU8();
+    for (int s = 0; s < streamCount; s++) {
+        epMap.Skip(2); // stream_PID
+        uint64_t counts = (static_cast<uint64_t>(epMap.ReadU16()) << 32) | epMap.ReadU32();
+        uint32_t streamStart = epMap.ReadU32();
+        uint8_t streamType = static_cast<uint8_t>((counts >> 34) & 0x0F);
+        uint32_t coarseCount = static_cast<uint32_t>((counts >> 18) & 0xFFFF);
+        uint32_t fineCount = static_cast<uint32_t>(counts & 0x3FFFF);
+        if (streamType != 1) {
+            continue; // Not video
+        }
+
+        ByteReader stream = epMap.Slice(streamStart, epMap.Size() - streamStart);
+        uint32_t fineStart = stream.ReadU32();
+        std::vector<std::pair<uint32_t, uint32_t>> coarse(coarseCount); // {ref_to_EP_fine_id | PTS, SPN}
+        for (auto& entry : coarse) {
+            entry.first = stream.ReadU32();
+            entry.second = stream.ReadU32();
+        }
+
+        ByteReader fine = stream.Slice(fineStart, static_cast<size_t>(fineCount) * 4);
+        for (uint32_t c = 0; c < coarseCount; c++) {
+            uint32_t first = coarse[c].first >> 14;
+            uint32_t last = c + 1 < coarseCount ? coarse[c + 1].first >> 14 : fineCount;
+            uint64_t ptsHigh = static_cast<uint64_t>(coarse[c].first & 0x3FFE) << 19;
+            uint32_t spnHigh = coarse[c].second & ~0x1FFFFu;
+            for (uint32_t f = first; f < last && f < fineCount; f++) {
+                fine.Seek(static_cast<size_t>(f) * 4);
+                uint32_t entry = fine.ReadU32();
+                EntryPoint point;
+                point.pts = ptsHigh + (static_cast<uint64_t>((entry >> 17) & 0x7FF) << 9);
+                point.spn = spnHigh + (entry & 0x1FFFF);
+                clip.entryPoints.push_back(point);
+            }
+        }
+        return;
+    }
+}
+
+} // namespace
+
+bool ClipInfo::GetPacketRange(uint8_t stcId, uint32_t inTime, uint32_t outTime,
+                              uint32_t& firstSpn, uint32_t& endSpn) const {
+    if (stcId >= stcSequences.size() || entryPoints.empty()) {
+        return false;
+    }
+
+    uint32_t sequenceStart = stcSequences[stcId].spnStart;
+    uint32_t sequenceEnd = stcId + 1u < stcSequences.size() ? stcSequences[stcId + 1].spnStart
+                         : sourcePacketCount != 0 ? sourcePacketCount : UINT32_MAX;
+
+    // EP_map PTS are truncated to 512 ticks, less than a frame, so an entry
+    // within 512 ticks below OUT is the frame at OUT itself
+    uint64_t inPts = static_cast<uint64_t>(inTime) * 2;
+    uint64_t outPts = static_cast<uint64_t>(outTime) * 2;
+    firstSpn = sequenceStart;
+    endSpn = sequenceEnd;
+    bool first = true;
+    for (const auto& point : entryPoints) {
+        if (point.spn < sequenceStart) {
+            continue;
+        }
+        if (point.spn >= sequenceEnd) {
+            break;
+        }
+        // Whatever precedes the sequence's first entry point (PAT/PMT,
+        // audio muxed ahead of the video) belongs to a window starting there
+        if (point.pts <= inPts && !first) {
+            firstSpn = point.spn;
+        }
+        if (point.pts + 512 > outPts) {
+            endSpn = point.spn;
+            break;
+        }
+        first = false;
+    }
+    return firstSpn < endSpn;
+}
+
+bool ClipInfo::FindEntryPoint(uint8_t stcId, uint32_t time, EntryPoint& point) const {
+    if (stcId >= stcSequences.size()) {
+        return false;
+    }
+
+    uint32_t sequenceStart = stcSequences[stcId].spnStart;
+    uint32_t sequenceEnd = stcId + 1u < stcSequences.size() ? stcSequences[stcId + 1].spnStart : UINT32_MAX;
+    bool found = false;
+    for (const auto& entry : entryPoints) {
+        if (entry.spn < sequenceStart) {
+            continue;
+        }
+        if (entry.spn >= sequenceEnd || entry.pts > static_cast<uint64_t>(time) * 2) {
+            break;
+        }
+        point = entry;
+        found = true;
+    }
+    return found;
+}
+
+bool CLPIParser::ParseCLPIFile(const fs::path& clpiPath, ClipInfo& clip) {
+    std::vector<uint8_t> data;
+    if (!DiscFileSystem::ReadFile(clpiPath, data)) {
+        return false;
+    }
+
+    clip.clipName = clpiPath.stem().string();
+    return ParseCLPIData(data, clip);
+}
+
+bool CLPIParser::ParseCLPIData(const std::vector<uint8_t>& data, ClipInfo& clip) {
+    clip.streams.clear();
+    clip.sourcePacketCount = 0;
+    clip.stcSequences.clear();
+    clip.entryPoints.clear();
+
+    uint32_t sequenceInfoStart = 0;
+    uint32_t cpiStart = 0;
+    try {
+        ByteReader reader(data);
+
+        // Header: "HDMV", version, then the section start addresses
+        if (reader.ReadString(4) != "HDMV") {
+            return false;
+        }
+        reader.Seek(8);
+        sequenceInfoStart = reader.ReadU32();
+        uint32_t programInfoStart = reader.ReadU32();
+        cpiStart = reader.ReadU32();
+
+        reader.Seek(programInfoStart);
+        uint32_t programInfoLength = reader.ReadU32();
+        ByteReader programInfo = reader.SubReader(programInfoLength);
+
+        programInfo.Skip(1); // reserved
+        uint8_t programCount = programInfo.ReadU8();
+
+        for (int p = 0; p < programCount; p++) {
+            // SPN_program_sequence_start, program_map_PID
+            programInfo.Skip(6);
+            uint8_t streamCount = programInfo.ReadU8();
+            programInfo.Skip(1); // number_of_groups
+
+            for (int s = 0; s < streamCount; s++) {
+                StreamInfo stream;
+                stream.pid = programInfo.ReadU16();
+                uint8_t codingInfoLength = programInfo.ReadU8();
+
+                if (ParseStreamCodingInfo(programInfo.SubReader(codingInfoLength), stream)) {
+                    clip.streams.push_back(stream);
+                }
+            }
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    // Byte mapping is optional: a damaged one leaves the stream attributes usable
+    try {
+        ByteReader reader(data);
+
+        // ClipInfo follows the 40-byte header: length, reserved, stream and
+        // application type, ATC delta flag, TS_recording_rate, then the count
+        reader.Seek(40 + 16);
+        clip.sourcePacketCount = reader.ReadU32();
+
+        if (sequenceInfoStart != 0) {
+            reader.Seek(sequenceInfoStart);
+            uint32_t length = reader.ReadU32();
+            ParseSequenceInfo(reader.SubReader(length), clip);
+        }
+
+        if (cpiStart != 0) {
+            reader.Seek(cpiStart);
+            uint32_t length = reader.ReadU32();
+            if (length >= 2) {
+                ByteReader cpi = reader.SubReader(length);
+                if ((cpi.ReadU16() & 0x0F) == 1) { // CPI_type: EP_map
+                    ParseEPMap(cpi.SubReader(cpi.Remaining()), clip);
+                }
+            }
+        }
+    } catch (const std::exception&) {
+        clip.stcSequences.clear();
+        clip.entryPoints.clear();
+    }
+
+    return true;
+}
+
+bool CLPIParser::ParseStreamCodingInfo(ByteReader reader, StreamInfo& stream) {
+    try {
+        stream.codingType = reader.ReadU8();
+        stream.kind = GetStreamKind(stream.codingType);
+        stream.codec = GetCodecName(stream.codingType);
+
+        switch (stream.kind) {
+            case StreamKind::Audio: {
+                uint8_t format = reader.ReadU8();
+                stream.channelLayout = GetChannelLayout(format >> 4);
+                stream.sampleRate = GetSampleRate(format & 0x0F);
+                stream.language = ReadLanguage(reader);
+                break;
+            }
+
+            case StreamKind::PresentationGraphics:
+            case StreamKind::InteractiveGraphics:
+                stream.language = ReadLanguage(reader);
+                break;
+
+            case StreamKind::TextSubtitle:
+                reader.Skip(1); // character_code
+                stream.language = ReadLanguage(reader);
+                break;
+
+            default:
+                break;
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    return true;
+}
+
+StreamKind CLPIParser::GetStreamKind(uint8_t codingType) {
+    switch (codingType) {
+        case 0x01: case 0x02: case 0x1b: case 0x20: case 0x24: case 0xea:
+            return StreamKind::Video;
+        case 0x03: case 0x04:
+        case 0x80: case 0x81: case 0x82: case 0x83: case 0x84: case 0x85: case 0x86:
+        case 0xa1: case 0xa2:
+            return StreamKind::Audio;
+        case 0x90:
+            return StreamKind::PresentationGraphics;
+        case 0x91:
+            return StreamKind::InteractiveGraphics;
+        case 0x92:
+            return StreamKind::TextSubtitle;
+        default:
+            return StreamKind::Unknown;
+    }
+}
+
+std::string CLPIParser::GetCodecName(uint8_t codingType) {
+    // Names follow ffprobe's codec_name so logs and policies stay comparable
+    switch (codingType) {
+        case 0x01: return "mpeg1video";
+        case 0x02: return "mpeg2video";
+        case 0x1b: return "h264";
+        case 0x20: return "h264_mvc";
+        case 0x24: return "hevc";
+        case 0xea: return "vc1";
+        case 0x03: return "mp1";
+        case 0x04: return "mp2";
+        case 0x80: return "pcm_bluray";
+        case 0x81: return "ac3";
+        case 0x82: return "dts";
+        case 0x83: return "truehd";
+        case 0x84: return "eac3";
+        case 0x85: return "dts_hd_hra";
+        case 0x86: return "dts_hd_ma";
+        case 0xa1: return "eac3";
+        case 0xa2: return "dts_hd";
+        case 0x90: return "hdmv_pgs_subtitle";
+        case 0x91: return "hdmv_igs";
+        case 0x92: return "hdmv_text_subtitle";
+        default:   return "unknown";
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "byte_reader.h"
+#include "language_id.h"
+
+namespace fs = std::filesystem;
+
+enum class StreamKind {
+    Unknown,
+    Video,
+    Audio,
+    PresentationGraphics,
+    InteractiveGraphics,
+    TextSubtitle
+};
+
+enum class StreamRole {
+    Primary,
+    Secondary
+};
+
+struct StreamInfo {
+    uint16_t pid = 0;
+    StreamKind kind = StreamKind::Unknown;
+    uint8_t codingType = 0;
+    std::string codec;
+    LanguageId language;       // ISO 639-2 code as stored on disc, e.g. "eng"
+    std::string channelLayout; // Audio only: "mono", "stereo", "multi"
+    int sampleRate = 0;        // Audio only, in Hz
+    StreamRole role = StreamRole::Primary;
+    int subPathId = -1;        // STN entries carried by a SubPath clip, -1 for the main clip
+
+    bool IsSubtitle() const {
+        return kind == StreamKind::PresentationGraphics || kind == StreamKind::TextSubtitle;
+    }
+};
+
+// A run of source packets on one continuous system clock; playlist IN/OUT
+// times name the sequence they refer to (ref_to_STC_id)
+struct STCSequence {
+    uint32_t spnStart = 0;          // First source packet
+    uint32_t presentationStart = 0; // 45kHz
+    uint32_t presentationEnd = 0;
+};
+
+// EP_map entry of the clip's video stream: an I-frame whose PES starts at
+// source packet spn
+struct EntryPoint {
+    uint64_t pts = 0; // 90kHz; the EP_map drops the lowest 9 bits
+    uint32_t spn = 0;
+};
+
+struct ClipInfo {
+    std::string clipName;
+    std::vector<StreamInfo> streams;
+    uint32_t sourcePacketCount = 0;         // 0 if the CLPI leaves it out
+    std::vector<STCSequence> stcSequences;  // SequenceInfo, in packet order
+    std::vector<EntryPoint> entryPoints;    // CPI, in packet order; empty without an EP_map
+
+    // Source packets [firstSpn, endSpn) a player reads for the 45kHz window
+    // [inTime, outTime) of STC sequence stcId: from the entry point at or
+    // before IN to the first one at or after OUT, or to the sequence's ends.
+    // endSpn is UINT32_MAX when the clip does not record its length.
+    // False without SequenceInfo or an EP_map.
+    bool GetPacketRange(uint8_t stcId, uint32_t inTime, uint32_t outTime,
+                        uint32_t& firstSpn, uint32_t& endSpn) const;
+
+    // Last entry point of STC sequence stcId at or before the 45kHz time
+    bool FindEntryPoint(uint8_t stcId, uint32_t time, EntryPoint& point) const;
+};
+
+// Reads BDMV/CLIPINF/*.clpi files. A clip's ProgramInfo carries the same
+// per-stream attributes ffprobe would report, so languages can be discovered
+// from a few kilobytes of metadata instead of probing the M2TS itself.
+// SequenceInfo and the CPI's EP_map map playlist times to byte offsets.
+class CLPIParser {
+public:
+    static constexpr uint64_t SourcePacketSize = 192;
+
+    static bool ParseCLPIFile(const fs::path& clpiPath, ClipInfo& clip);
+    static bool ParseCLPIData(const std::vector<uint8_t>& data, ClipInfo& clip);
+
+    // Decodes a StreamCodingInfo / stream_attributes block (everything after
+    // the length byte). Shared with the MPLS STN_table decoder.
+    static bool ParseStreamCodingInfo(ByteReader reader, StreamInfo& stream);
+
+    static StreamKind GetStreamKind(uint8_t codingType);
+    static std::string GetCodecName(uint8_t codingType);
+};
@@ -0,0 +1,269 @@
+#include "disc_filesystem.h"
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <mutex>
+
+namespace {
+
+bool HasImageExtension(const fs::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".iso";
+}
+
+uint64_t ModifiedTime(const fs::path& path) {
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    return ec ? 0 : static_cast<uint64_t>(time.time_since_epoch().count());
+}
+
+} // namespace
+
+bool DiscFileSystem::IsImageFile(const fs::path& path) {
+    std::error_code ec;
+    return HasImageExtension(path) && fs::is_regular_file(path, ec);
+}
+
+bool DiscFileSystem::IsInImage(const fs::path& path) {
+    fs::path imagePath;
+    std::string innerPath;
+    return SplitImagePath(path, imagePath, innerPath);
+}
+
+bool DiscFileSystem::SplitImagePath(const fs::path& path, fs::path& imagePath, std::string& innerPath) {
+    fs::path current;
+    auto it = path.begin();
+    for (; it != path.end(); ++it) {
+        current /= *it;
+        if (HasImageExtension(*it) && IsImageFile(current)) {
+            break;
+        }
+    }
+    if (it == path.end()) {
+        return false;
+    }
+
+    imagePath = current;
+    innerPath.clear();
+    for (++it; it != path.end(); ++it) {
+        if (!it->empty()) {
+            innerPath += (innerPath.empty() ? "" : "/") + it->string();
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<UdfImage> DiscFileSystem::OpenImage(const fs::path& imagePath, std::string& error) {
+    static std::mutex registryMutex;
+    static std::map<std::string, std::shared_ptr<UdfImage>> registry;
+
+    std::error_code ec;
+    fs::path canonical = fs::weakly_canonical(imagePath, ec);
+    std::string key = (ec ? imagePath : canonical).string();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& image = registry[key];
+    if (!image) {
+        auto opened = std::make_shared<UdfImage>();
+        if (!opened->Open(imagePath, error)) {
+            registry.erase(key);
+            return nullptr;
+        }
+        image = opened;
+    }
+    return image;
+}
+
+bool DiscFileSystem::FindInImage(const fs::path& path, std::shared_ptr<UdfImage>& image, UdfEntry& entry) {
+    fs::path imagePath;
+    std::string innerPath;
+    std::string error;
+    if (!SplitImagePath(path, imagePath, innerPath)) {
+        return false;
+    }
+    image = OpenImage(imagePath, error);
+    return image && image->Find(innerPath, entry);
+}
+
+bool DiscFileSystem::Exists(const fs::path& path) {
+    std::shared_ptr<UdfImage> image;
+    UdfEntry entry;
+    if (FindInImage(path, image, entry)) {
+        return true;
+    }
+    std::error_code ec;
+    return !image && fs::exists(path, ec);
+}
+
+bool DiscFileSystem::IsDirectory(const fs::path& path) {
+    std::shared_ptr<UdfImage> image;
+    UdfEntry entry;
+    if (FindInImage(path, image, entry)) {
+        return entry.isDirectory;
+    }
+    std::error_code ec;
+    return !image && fs::is_directory(path, ec);
+}
+
+bool DiscFileSystem::FileSize(const fs::path& path, uint64_t& size) {
+    std::shared_ptr<UdfImage> image;
+    UdfEntry entry;
+    if (FindInImage(path, image, entry)) {
+        size = entry.size;
+        return !entry.isDirectory;
+    }
+    if (image) {
+        return false;
+    }
+    std::error_code ec;
+    size = fs::file_size(path, ec);
+    return !ec;
+}
+
+bool DiscFileSystem::ReadFile(const fs::path& path, std::vector<uint8_t>& data) {
+    DiscFile file;
+    if (!file.Open(path)) {
+        return false;
+    }
+    data.resize(static_cast<size_t>(file.Size()));
+    return file.ReadAt(0, data.data(), data.size()) == data.size();
+}
+
+bool DiscFileSystem::ListDirectory(const fs::path& path, std::vector<Entry>& entries) {
+    entries.clear();
+
+    fs::path imagePath;
+    std::string innerPath;
+    if (SplitImagePath(path, imagePath, innerPath)) {
+        std::string error;
+        auto image = OpenImage(imagePath, error);
+        std::vector<UdfEntry> children;
+        if (!image || !image->List(innerPath, children)) {
+            return false;
+        }
+        uint64_t modified = ModifiedTime(imagePath);
+        for (const auto& child : children) {
+            entries.push_back({child.name, child.isDirectory, child.size, modified});
+        }
+        return true;
+    }
+
+    std::error_code ec;
+    for (const auto& item : fs::directory_iterator(path, ec)) {
+        std::error_code itemError;
+        Entry entry;
+        entry.name = item.path().filename().string();
+        entry.isDirectory = item.is_directory(itemError);
+        entry.size = entry.isDirectory ? 0 : item.file_size(itemError);
+        auto time = item.last_write_time(itemError);
+        if (itemError) {
+            return false;
+        }
+        entry.modified = static_cast<uint64_t>(time.time_since_epoch().count());
+        entries.push_back(std::move(entry));
+    }
+    return !ec;
+}
+
+bool DiscFile::Open(const fs::path& path) {
+    Close();
+
+    UdfEntry entry;
+    if (DiscFileSystem::FindInImage(path, image, entry)) {
+        if (entry.isDirectory) {
+            Close();
+            return false;
+        }
+        inImage = true;
+        file = image->File();
+        extents = std::move(entry.extents);
+        embedded = std::move(entry.embedded);
+        size = entry.size;
+        return true;
+    }
+    if (image) {
+        Close(); // Inside an image, but not found there
+        return false;
+    }
+
+    auto plain = std::make_shared<RandomAccessFile>();
+    if (!plain->Open(path)) {
+        return false;
+    }
+    size = plain->Size();
+    file = std::move(plain);
+    return true;
+}
+
+void DiscFile::Close() {
+    file.reset();
+    image.reset();
+    inImage = false;
+    extents.clear();
+    embedded.clear();
+    size = 0;
+}
+
+size_t DiscFile::ReadAt(uint64_t offset, void* buffer, size_t count) const {
+    if (!file || offset >= size) {
+        return 0;
+    }
+    count = static_cast<size_t>(std::min<uint64_t>(count, size - offset));
+    if (!inImage) {
+        return file->ReadAt(offset, buffer, count);
+    }
+    if (extents.empty()) {
+        if (offset >= embedded.size()) {
+            return 0;
+        }
+        count = std::min(count, embedded.size() - static_cast<size_t>(offset));
+        std::copy_n(embedded.begin() + static_cast<size_t>(offset), count, static_cast<uint8_t*>(buffer));
+        return count;
+    }
+
+    // Walk the extents; BD streams are usually one or a few large extents
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    size_t done = 0;
+    uint64_t extentStart = 0;
+    for (const auto& extent : extents) {
+        if (done == count) {
+            break;
+        }
+        uint64_t position = offset + done;
+        if (position < extentStart + extent.length) {
+            uint64_t within = position - extentStart;
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(extent.length - within, count - done));
+            size_t got = file->ReadAt(extent.offset + within, out + done, chunk);
+            done += got;
+            if (got < chunk) {
+                break;
+            }
+        }
+        extentStart += extent.length;
+    }
+    return done;
+}
+
+void DiscFile::WillNeed(uint64_t offset, uint64_t length) const {
+    if (!file || offset >= size) {
+        return;
+    }
+    length = std::min(length, size - offset);
+    if (!inImage) {
+        file->WillNeed(offset, length);
+        return;
+    }
+
+    uint64_t extentStart = 0;
+    for (const auto& extent : extents) {
+        uint64_t extentEnd = extentStart + extent.length;
+        if (offset < extentEnd && offset + length > extentStart) {
+            uint64_t begin = std::max(offset, extentStart);
+            uint64_t end = std::min(offset + length, extentEnd);
+            file->WillNeed(extent.offset + (begin - extentStart), end - begin);
+        }
+        extentStart = extentEnd;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "platform.h"
+#include "udf_reader.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Disc paths may point into a Blu-ray image: "D:/Rips/Movie.iso/BDMV/PLAYLIST".
+// The first path component that is an existing .iso file is opened with
+// UdfImage and the rest of the path is looked up inside it; paths without
+// one go to the regular filesystem. Images stay open for the process lifetime.
+class DiscFileSystem {
+public:
+    struct Entry {
+        std::string name;
+        bool isDirectory = false;
+        uint64_t size = 0;
+        uint64_t modified = 0; // Opaque timestamp; inside an image, the image file's
+    };
+
+    // True for an existing .iso file (the path given for a disc image)
+    static bool IsImageFile(const fs::path& path);
+    // True if the path points into an image
+    static bool IsInImage(const fs::path& path);
+
+    static bool Exists(const fs::path& path);
+    static bool IsDirectory(const fs::path& path);
+    static bool FileSize(const fs::path& path, uint64_t& size);
+
+    // Whole small files (playlists, clip info) into memory
+    static bool ReadFile(const fs::path& path, std::vector<uint8_t>& data);
+    static bool ListDirectory(const fs::path& path, std::vector<Entry>& entries);
+
+    // Opened images are shared by every reader of the same file
+    static std::shared_ptr<UdfImage> OpenImage(const fs::path& imagePath, std::string& error);
+
+private:
+    friend class DiscFile;
+
+    // Splits at the image component; false if the path has none
+    static bool SplitImagePath(const fs::path& path, fs::path& imagePath, std::string& innerPath);
+    static bool FindInImage(const fs::path& path, std::shared_ptr<UdfImage>& image, UdfEntry& entry);
+};
+
+// A file opened for positioned reads, on disk or as extents of an image.
+// ReadAt is safe to call from several threads.
+class DiscFile {
+public:
+    bool Open(const fs::path& path);
+    void Close();
+    bool IsOpen() const { return file != nullptr; }
+
+    // Returns the number of bytes read; short only at end of file or on error
+    size_t ReadAt(uint64_t offset, void* buffer, size_t size) const;
+    uint64_t Size() const { return size; }
+
+    // Read-ahead hint for [offset, offset + length), mapped through the extents
+    void WillNeed(uint64_t offset, uint64_t length) const;
+
+private:
+    std::shared_ptr<RandomAccessFile> file;
+    std::shared_ptr<UdfImage> image;
+    bool inImage = false;
+    std::vector<UdfExtent> extents; // Image byte ranges, in file order
+    std::vector<uint8_t> embedded;  // Data stored in the file's ICB
+    uint64_t size = 0;
+};
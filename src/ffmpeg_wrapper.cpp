@@ -1,185 +1,329 @@
 #include "ffmpeg_wrapper.h"
-#include <windows.h>
+#include "cancel_token.h"
+#include "child_process.h"
+#include "clip_prefetcher.h"
+#include "platform.h"
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
-#include <map>
+#include <atomic>
+#include <thread>
 
-// Language name to ISO code mapping for FFmpeg
-std::map<std::string, std::string> languageNameToCode = {
-    {"English", "eng"}, {"Spanish", "spa"}, {"French", "fre"}, {"German", "ger"},
-    {"Italian", "ita"}, {"Portuguese", "por"}, {"Russian", "rus"}, {"Japanese", "jpn"},
-    {"Korean", "kor"}, {"Chinese", "chi"}, {"Hindi", "hin"}, {"Arabic", "ara"},
-    {"Dutch", "dut"}, {"Swedish", "swe"}, {"Norwegian", "nor"}, {"Danish", "dan"},
-    {"Finnish", "fin"}, {"Polish", "pol"}, {"Czech", "cze"}, {"Hungarian", "hun"},
-    {"Thai", "tha"}, {"Vietnamese", "vie"}, {"Unknown", "und"}
-};
+namespace {
+
+constexpr size_t FeedChunkSize = 4 * 1024 * 1024;
+
+std::string PidStreamSpecifier(uint16_t pid) {
+    std::ostringstream specifier;
+    specifier << "0:i:0x" << std::hex << pid;
+    return specifier.str();
+}
+
+} // namespace
 
 bool FFmpegWrapper::RemuxBDMV(const std::string& inputMPLS, 
                              const std::string& outputMKV,
                              const StreamOptions& options) {
     
-    std::string command = BuildFFmpegCommand(inputMPLS, outputMKV, options);
+    // ffmpeg finds no chapters in a raw MPLS, so they come in as a second input
+    std::string chapterFile;
+    if (!options.chapters.empty()) {
+        chapterFile = outputMKV + ".chapters.txt";
+        if (!WriteChapterFile(chapterFile, options.chapters, options.expectedDuration)) {
+            DebugLog("Cannot write chapter file " + chapterFile);
+            std::error_code ec;
+            std::filesystem::remove(chapterFile, ec);
+            chapterFile.clear();
+        }
+    }
     
+    bool success = RunFFmpeg(BuildFFmpegArguments(inputMPLS, outputMKV, options, chapterFile), outputMKV, options);
+    if (!chapterFile.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(chapterFile, ec);
+    }
+    return success;
+}
+
+bool FFmpegWrapper::RunFFmpeg(const std::vector<std::string>& arguments,
+                              const std::string& outputMKV,
+                              const StreamOptions& options) {
     // Execute FFmpeg command
-    OutputDebugStringA(("Executing: " + command).c_str());
-    
-    STARTUPINFOA si = {};
-    PROCESS_INFORMATION pi = {};
-    si.cb = sizeof(si);
-    si.dwFlags = STARTF_USESHOWWINDOW;
-    si.wShowWindow = SW_HIDE; // Hide console window
-    
-    BOOL success = CreateProcessA(
-        nullptr,
-        const_cast<char*>(command.c_str()),
-        nullptr, nullptr, FALSE, 0,
-        nullptr, nullptr, &si, &pi
-    );
-    
-    if (!success) {
+    DebugLog("Executing: " + ChildProcess::FormatCommandLine(arguments));
+    
+    // ffmpeg writes -progress to stdout and warnings to stderr; both go to one pipe
+    FFmpegProgressParser parser(options.expectedDuration, options.expectedSize, options.onProgress);
+    bool pipeInput = !options.inputClips.empty();
+    ChildProcess process;
+    if (!process.Start(arguments, [&](const char* data, size_t size) { parser.Feed(data, size); }, pipeInput)) {
         return false;
     }
     
-    // Wait for process to complete
-    WaitForSingleObject(pi.hProcess, INFINITE);
+    // Declared after the process so it is unregistered before the process goes away
+    CancelToken::Registration cancelRegistration;
+    if (options.cancel) {
+        cancelRegistration = options.cancel->OnCancel([&process]() { process.Terminate(); });
+    }
+    
+    // A short feed would otherwise look like a complete (but truncated) title
+    std::atomic<bool> feedFailed{false};
+    std::thread feeder;
+    if (pipeInput) {
+        feeder = std::thread([&]() {
+            if (!FeedClips(process, options.inputClips) && !process.WasTerminated()) {
+                feedFailed = true;
+                process.Terminate();
+            }
+            process.CloseInput();
+        });
+    }
+    
+    int exitCode = process.Wait();
+    if (feeder.joinable()) {
+        feeder.join(); // Writes fail once the child is gone
+    }
+    cancelRegistration.Reset();
+    
+    if (feedFailed) {
+        std::error_code ec;
+        std::filesystem::remove(outputMKV, ec);
+        DebugLog("ffmpeg input feed failed: " + outputMKV);
+        return false;
+    }
     
-    DWORD exitCode;
-    GetExitCodeProcess(pi.hProcess, &exitCode);
+    if (process.WasTerminated()) {
+        // A half-written MKV must not look like a finished one
+        std::error_code ec;
+        std::filesystem::remove(outputMKV, ec);
+        DebugLog("ffmpeg cancelled: " + outputMKV);
+        return false;
+    }
     
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
+    if (exitCode != 0) {
+        for (const auto& line : parser.DiagnosticLines()) {
+            DebugLog("ffmpeg: " + line);
+        }
+    }
     
     return exitCode == 0;
 }
 
-std::string FFmpegWrapper::BuildFFmpegCommand(const std::string& input, 
-                                            const std::string& output,
-                                            const StreamOptions& options) {
-    std::ostringstream cmd;
+FFmpegProgressParser::FFmpegProgressParser(double expectedDuration, uint64_t expectedSize,
+                                           ProgressCallback callback)
+    : expectedDuration(expectedDuration),
+      expectedSize(expectedSize),
+      callback(std::move(callback)),
+      started(std::chrono::steady_clock::now()) {}
+
+void FFmpegProgressParser::Feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        if (c == '\n' || c == '\r') {
+            if (!partialLine.empty()) {
+                HandleLine(partialLine);
+                partialLine.clear();
+            }
+        } else {
+            partialLine += c;
+        }
+    }
+}
+
+void FFmpegProgressParser::HandleLine(const std::string& line) {
+    size_t equals = line.find('=');
+    std::string key = equals == std::string::npos ? "" : line.substr(0, equals);
+    std::string value = equals == std::string::npos ? "" : line.substr(equals + 1);
+    
+    if (key == "total_size") {
+        current.bytesWritten = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (key == "out_time_us" || key == "out_time_ms") {
+        // out_time_ms is microseconds too, despite its name
+        long long micros = std::strtoll(value.c_str(), nullptr, 10);
+        if (micros > 0) {
+            current.outTimeSeconds = micros / 1e6;
+        }
+    } else if (key == "speed") {
+        current.speed = std::strtod(value.c_str(), nullptr); // "1.5x", or "N/A" -> 0
+    } else if (key == "progress") {
+        Publish(value == "end");
+    } else if (key.empty() || key.find(' ') != std::string::npos) {
+        // Not a progress key: an ffmpeg warning or error
+        diagnostics.push_back(line);
+        if (diagnostics.size() > MaxDiagnosticLines) {
+            diagnostics.erase(diagnostics.begin());
+        }
+    }
+}
+
+void FFmpegProgressParser::Publish(bool finished) {
+    if (expectedDuration > 0) {
+        current.fraction = current.outTimeSeconds / expectedDuration;
+    } else if (expectedSize > 0) {
+        current.fraction = static_cast<double>(current.bytesWritten) / expectedSize;
+    }
+    current.fraction = finished ? 1.0 : std::min(std::max(current.fraction, 0.0), 1.0);
+    current.finished = finished;
+    
+    if (finished) {
+        current.etaSeconds = 0;
+    } else if (expectedDuration > 0 && current.speed > 0) {
+        current.etaSeconds = (expectedDuration - current.outTimeSeconds) / current.speed;
+    } else if (current.fraction > 0.01) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        current.etaSeconds = elapsed * (1.0 - current.fraction) / current.fraction;
+    }
+    
+    if (callback) {
+        callback(current);
+    }
+}
+
+std::vector<std::string> FFmpegWrapper::BuildFFmpegArguments(const std::string& input, 
+                                                             const std::string& output,
+                                                             const StreamOptions& options,
+                                                             const std::string& chapterFile) {
+    std::vector<std::string> args;
     
     // Base FFmpeg command with optimizations
-    cmd << "ffmpeg -y -hide_banner -loglevel warning";
-    cmd << " -fflags +genpts+discardcorrupt";
-    cmd << " -analyzeduration 200M -probesize 200M";
-    cmd << " -threads " << options.threads;
-    cmd << " -i \"" << input << "\"";
-    
-    // Always map main video stream
-    cmd << " -map 0:v:0";
-    
-    // Map audio streams based on selected languages
-    if (!options.audioLanguages.empty()) {
-        for (const auto& langName : options.audioLanguages) {
-            std::string langCode = LanguageNameToCode(langName);
-            cmd << " -map 0:a:m:language:" << langCode;
+    args.insert(args.end(), {options.ffmpegPath, "-y", "-hide_banner", "-loglevel", "warning"});
+    args.insert(args.end(), {"-nostdin", "-nostats", "-progress", "pipe:1"});
+    args.insert(args.end(), {"-fflags", "+genpts+discardcorrupt"});
+    args.insert(args.end(), {"-analyzeduration", "200M", "-probesize", "200M"});
+    args.insert(args.end(), {"-threads", std::to_string(options.threads)});
+    if (!options.inputClips.empty()) {
+        args.insert(args.end(), {"-f", "mpegts", "-i", "pipe:0"});
+    } else {
+        if (options.startTime > 0) {
+            args.insert(args.end(), {"-ss", std::to_string(options.startTime)});
+        }
+        args.insert(args.end(), {"-i", input});
+    }
+    if (!chapterFile.empty()) {
+        args.insert(args.end(), {"-f", "ffmetadata", "-i", chapterFile});
+    }
+    if (options.endTime > options.startTime) {
+        args.insert(args.end(), {"-t", std::to_string(options.endTime - options.startTime)});
+    }
+    
+    // Map main video stream
+    if (options.videoPid != 0) {
+        args.insert(args.end(), {"-map", PidStreamSpecifier(options.videoPid)});
+    } else {
+        args.insert(args.end(), {"-map", "0:v:0"});
+    }
+    
+    // Map audio streams by PID when known, otherwise by selected languages
+    if (!options.audioStreams.empty()) {
+        for (const auto& stream : options.audioStreams) {
+            args.insert(args.end(), {"-map", PidStreamSpecifier(stream.pid)});
+        }
+    } else if (!options.audioLanguages.empty()) {
+        for (LanguageId language : options.audioLanguages) {
+            args.insert(args.end(), {"-map", "0:a:m:language:" + language.Code()});
         }
     } else {
-        cmd << " -map 0:a"; // Map all audio if none specified
+        args.insert(args.end(), {"-map", "0:a"}); // Map all audio if none specified
     }
     
-    // Map subtitle streams based on selected languages
-    if (!options.subtitleLanguages.empty()) {
-        for (const auto& langName : options.subtitleLanguages) {
-            std::string langCode = LanguageNameToCode(langName);
-            cmd << " -map 0:s:m:language:" << langCode;
+    // Map subtitle streams by PID when known, otherwise by selected languages
+    if (!options.subtitleStreams.empty()) {
+        for (const auto& stream : options.subtitleStreams) {
+            args.insert(args.end(), {"-map", PidStreamSpecifier(stream.pid)});
+        }
+    } else if (!options.subtitleLanguages.empty()) {
+        for (LanguageId language : options.subtitleLanguages) {
+            args.insert(args.end(), {"-map", "0:s:m:language:" + language.Code()});
         }
     }
     
+    // Blu-ray PMTs rarely carry language descriptors, so tag PID-mapped streams explicitly
+    for (size_t i = 0; i < options.audioStreams.size(); i++) {
+        args.insert(args.end(), {"-metadata:s:a:" + std::to_string(i),
+                                 "language=" + options.audioStreams[i].language.Code()});
+    }
+    for (size_t i = 0; i < options.subtitleStreams.size(); i++) {
+        args.insert(args.end(), {"-metadata:s:s:" + std::to_string(i),
+                                 "language=" + options.subtitleStreams[i].language.Code()});
+    }
+    
     // Codec and optimization settings
     if (options.copyStreams) {
-        cmd << " -c copy";
+        args.insert(args.end(), {"-c", "copy"});
     }
     
-    cmd << " -avoid_negative_ts make_zero";
-    cmd << " -map_metadata 0 -map_chapters 0";
+    args.insert(args.end(), {"-avoid_negative_ts", "make_zero"});
+    args.insert(args.end(), {"-map_metadata", "0", "-map_chapters", chapterFile.empty() ? "0" : "1"});
     
     // MKV-specific optimizations
-    cmd << " -f matroska";
-    cmd << " -write_crc32 0";
-    cmd << " -cluster_size_limit 2M";
+    args.insert(args.end(), {"-f", "matroska"});
+    args.insert(args.end(), {"-write_crc32", "0"});
+    args.insert(args.end(), {"-cluster_size_limit", "2M"});
     
     // Output file
-    cmd << " \"" << output << "\"";
+    args.push_back(output);
     
-    return cmd.str();
-}
-
-std::string FFmpegWrapper::LanguageNameToCode(const std::string& languageName) {
-    auto it = languageNameToCode.find(languageName);
-    return (it != languageNameToCode.end()) ? it->second : "und";
+    return args;
 }
 
-bool FFmpegWrapper::IsFFmpegAvailable() {
-    STARTUPINFOA si = {};
-    PROCESS_INFORMATION pi = {};
-    si.cb = sizeof(si);
-    si.dwFlags = STARTF_USESHOWWINDOW;
-    si.wShowWindow = SW_HIDE;
-    
-    std::string command = "ffmpeg -version";
-    
-    BOOL success = CreateProcessA(
-        nullptr,
-        const_cast<char*>(command.c_str()),
-        nullptr, nullptr, FALSE, 0,
-        nullptr, nullptr, &si, &pi
-    );
-    
-    if (!success) {
+bool FFmpegWrapper::WriteChapterFile(const std::string& path, const std::vector<double>& chapters,
+                                     double duration) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
         return false;
     }
     
-    WaitForSingleObject(pi.hProcess, 5000); // 5 second timeout
-    
-    DWORD exitCode;
-    GetExitCodeProcess(pi.hProcess, &exitCode);
-    
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-    
-    return exitCode == 0;
+    file << ";FFMETADATA1\n";
+    for (size_t i = 0; i < chapters.size(); i++) {
+        double end = i + 1 < chapters.size() ? chapters[i + 1] : std::max(duration, chapters[i]);
+        char title[32];
+        std::snprintf(title, sizeof(title), "Chapter %02zu", i + 1);
+        file << "[CHAPTER]\nTIMEBASE=1/1000\n"
+             << "START=" << static_cast<int64_t>(chapters[i] * 1000.0 + 0.5) << "\n"
+             << "END=" << static_cast<int64_t>(end * 1000.0 + 0.5) << "\n"
+             << "title=" << title << "\n";
+    }
+    return static_cast<bool>(file);
 }
 
-std::string FFmpegWrapper::GetFFmpegVersion() {
-    // Create temporary file for output
-    char tempPath[MAX_PATH];
-    GetTempPathA(MAX_PATH, tempPath);
-    std::string tempFile = std::string(tempPath) + "ffmpeg_version.txt";
-    
-    std::string command = "ffmpeg -version > \"" + tempFile + "\" 2>&1";
-    
-    STARTUPINFOA si = {};
-    PROCESS_INFORMATION pi = {};
-    si.cb = sizeof(si);
-    si.dwFlags = STARTF_USESHOWWINDOW;
-    si.wShowWindow = SW_HIDE;
-    
-    BOOL success = CreateProcessA(
-        nullptr,
-        const_cast<char*>(command.c_str()),
-        nullptr, nullptr, FALSE, 0,
-        nullptr, nullptr, &si, &pi
-    );
-    
-    if (!success) {
-        return "Unknown";
+bool FFmpegWrapper::FeedClips(ChildProcess& process, const std::vector<ClipSpan>& clips) {
+    ClipPrefetcher prefetcher(clips);
+    std::vector<uint8_t> buffer(FeedChunkSize);
+    for (size_t i = 0; i < clips.size(); i++) {
+        if (!prefetcher.WaitOpened(i)) {
+            DebugLog("Cannot open clip " + clips[i].path.string());
+            return false;
+        }
+        
+        // Back-to-back clips form one transport stream, as ffmpeg's concat of an MPLS does
+        while (size_t got = prefetcher.Read(i, buffer.data(), buffer.size())) {
+            if (!process.WriteInput(buffer.data(), got)) {
+                return true; // ffmpeg stopped reading; its exit code tells why
+            }
+        }
+        if (prefetcher.Failed()) {
+            DebugLog("Read error in " + clips[i].path.string());
+            return false;
+        }
     }
-    
-    WaitForSingleObject(pi.hProcess, 5000);
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-    
-    // Read the output file
-    std::ifstream file(tempFile);
-    std::string result;
-    if (file.is_open()) {
-        std::getline(file, result);
-        file.close();
+    return true;
+}
+
+bool FFmpegWrapper::IsFFmpegAvailable(const std::string& ffmpegPath) {
+    std::string output;
+    return ChildProcess::Run({ffmpegPath, "-version"}, output, std::chrono::seconds(5)) == 0;
+}
+
+std::string FFmpegWrapper::GetFFmpegVersion(const std::string& ffmpegPath) {
+    std::string output;
+    if (ChildProcess::Run({ffmpegPath, "-version"}, output, std::chrono::seconds(5)) != 0) {
+        return "Unknown";
     }
     
-    // Clean up temp file
-    DeleteFileA(tempFile.c_str());
-    
+    // The first line is "ffmpeg version N ..."
+    std::string result = output.substr(0, output.find_first_of("\r\n"));
     return result.empty() ? "Unknown" : result;
-}
\ No newline at end of file
+}
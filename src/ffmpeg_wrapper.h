@@ -1,27 +1,130 @@
 #pragma once
+#include "clip_prefetcher.h"
+#include "language_id.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
+class CancelToken;
+class ChildProcess;
+
+// How a job turns a playlist into an MKV
+enum class RemuxBackend {
+    FFmpeg, // Spawn ffmpeg on the MPLS
+    Native  // Demux and mux in-process (NativeRemuxer)
+};
+
+// Snapshot of a running remux, reported by either backend
+struct RemuxProgress {
+    uint64_t bytesWritten = 0;
+    double outTimeSeconds = 0;
+    double speed = 0;        // Multiple of real time, 0 until known
+    double fraction = 0;     // 0..1 against the title's duration, or its size if that is unknown
+    double etaSeconds = -1;  // -1 until there is enough data
+    bool finished = false;
+};
+
+using ProgressCallback = std::function<void(const RemuxProgress&)>;
+
+// Incremental parser for ffmpeg's `-progress` key=value stream. Feed it raw
+// pipe reads; it reports a snapshot at every `progress=` line. Anything that
+// is not a progress key (warnings share the pipe) is kept for diagnostics.
+class FFmpegProgressParser {
+public:
+    static constexpr size_t MaxDiagnosticLines = 20;
+
+    FFmpegProgressParser(double expectedDuration, uint64_t expectedSize, ProgressCallback callback);
+
+    void Feed(const char* data, size_t size);
+
+    const std::vector<std::string>& DiagnosticLines() const { return diagnostics; }
+    const RemuxProgress& Current() const { return current; }
+
+private:
+    void HandleLine(const std::string& line);
+    void Publish(bool finished);
+
+    double expectedDuration;
+    uint64_t expectedSize;
+    ProgressCallback callback;
+    std::chrono::steady_clock::time_point started;
+
+    std::string partialLine;
+    RemuxProgress current;
+    std::vector<std::string> diagnostics;
+};
+
 class FFmpegWrapper {
 public:
+    // A stream selected by its transport stream PID, as listed in the playlist's STN_table
+    struct MappedStream {
+        uint16_t pid;
+        LanguageId language;
+    };
+    
     struct StreamOptions {
-        std::vector<std::string> audioLanguages;
-        std::vector<std::string> subtitleLanguages;
+        std::vector<LanguageId> audioLanguages;
+        std::vector<LanguageId> subtitleLanguages;
+        uint16_t videoPid = 0;
+        std::vector<MappedStream> audioStreams;    // Take precedence over audioLanguages
+        std::vector<MappedStream> subtitleStreams; // Take precedence over subtitleLanguages
         bool copyStreams = true;
+        RemuxBackend backend = RemuxBackend::FFmpeg;
         int threads = 8;
         std::string bufferSize = "256M";
+        
+        // Progress reporting; the expected values come from the scanned BDMVTitle
+        double expectedDuration = 0;
+        uint64_t expectedSize = 0;
+        ProgressCallback onProgress;
+        
+        // Cancelling stops the job and removes its partial output
+        const CancelToken* cancel = nullptr;
+        std::string ffmpegPath = "ffmpeg";
+        
+        // Built-in muxer only: bypass the OS cache when writing the MKV
+        bool unbufferedOutput = false;
+        
+        // 0-based angle of multi-angle play items. ffmpeg only plays angle 1
+        // of an MPLS, so other angles are fed to it as inputClips.
+        size_t angle = 0;
+        
+        // Clips to stream into ffmpeg's stdin in order, for playlists ffmpeg
+        // cannot open itself (inside a disc image); the MPLS input is then unused
+        std::vector<ClipSpan> inputClips;
+        
+        // Partial extraction: title time [startTime, endTime) in seconds, endTime 0
+        // for the rest of the title. The built-in muxer trims the title itself
+        // (BDMVParser::TrimTitle) and starts reading at the entry point before
+        // startTime. For ffmpeg, inputClips must already start at startTime
+        // (cut from a trimmed title); without them ffmpeg seeks in the MPLS.
+        double startTime = 0;
+        double endTime = 0;
+        bool HasRange() const { return startTime > 0 || endTime > 0; }
+        
+        // Chapter starts in seconds of output time (BDMVTitle::GetChapterStarts
+        // of the title as cut). ffmpeg reads them from an ffmetadata file next
+        // to the output; the built-in muxer writes them itself.
+        std::vector<double> chapters;
     };
     
     static bool RemuxBDMV(const std::string& inputMPLS, 
                          const std::string& outputMKV,
                          const StreamOptions& options);
     
-    static bool IsFFmpegAvailable();
-    static std::string GetFFmpegVersion();
+    static bool IsFFmpegAvailable(const std::string& ffmpegPath = "ffmpeg");
+    static std::string GetFFmpegVersion(const std::string& ffmpegPath = "ffmpeg");
     
 private:
-    static std::string BuildFFmpegCommand(const std::string& input, 
-                                        const std::string& output,
-                                        const StreamOptions& options);
-    static std::string LanguageNameToCode(const std::string& languageName);
+    static std::vector<std::string> BuildFFmpegArguments(const std::string& input, 
+                                                         const std::string& output,
+                                                         const StreamOptions& options,
+                                                         const std::string& chapterFile);
+    static bool RunFFmpeg(const std::vector<std::string>& arguments, const std::string& outputMKV,
+                          const StreamOptions& options);
+    static bool WriteChapterFile(const std::string& path, const std::vector<double>& chapters, double duration);
+    // False only if a clip could not be read
+    static bool FeedClips(ChildProcess& process, const std::vector<ClipSpan>& clips);
 };
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "job_journal.h"
+#include "platform.h"
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const char JournalHeader[] = "MultiREMUXer journal";
+
+std::vector<std::string> SplitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    std::istringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, '\t')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+bool ParseState(const std::string& name, JobState& state) {
+    for (JobState candidate : {JobState::Processing, JobState::Completed, JobState::Error, JobState::Stopped}) {
+        if (name == JobJournal::GetStateName(candidate)) {
+            state = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+JobJournal::JobJournal(const fs::path& outputDirectory) : path(outputDirectory / FileName) {}
+
+void JobJournal::Load() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+
+    std::ifstream file(path);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line) ||
+        line != std::string(JournalHeader) + " " + std::to_string(FormatVersion)) {
+        return;
+    }
+
+    // state \t outputSize \t source \t title \t output
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields = SplitFields(line);
+        JournalEntry entry;
+        if (fields.size() != 5 || !ParseState(fields[0], entry.state)) {
+            continue;
+        }
+        entry.outputSize = std::strtoull(fields[1].c_str(), nullptr, 10);
+        entry.source = fields[2];
+        entry.title = fields[3];
+        entry.output = fields[4];
+        entries[MakeKey(entry.source, entry.title)] = entry;
+    }
+}
+
+size_t JobJournal::RecoverInterrupted() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t interrupted = 0;
+    for (auto& pair : entries) {
+        JournalEntry& entry = pair.second;
+        if (entry.state != JobState::Processing) {
+            continue;
+        }
+        // Only the partial file can be incomplete; the final name is written by rename
+        std::error_code ec;
+        fs::remove(PartialPath(entry.output), ec);
+        entry.state = JobState::Stopped;
+        interrupted++;
+    }
+    if (interrupted > 0) {
+        Save();
+    }
+    return interrupted;
+}
+
+bool JobJournal::IsCompleted(const std::string& source, const std::string& title,
+                             const std::string& output) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = entries.find(MakeKey(source, title));
+    if (it == entries.end() || it->second.state != JobState::Completed || it->second.output != output) {
+        return false;
+    }
+    std::error_code ec;
+    uintmax_t size = fs::file_size(output, ec);
+    return !ec && size == it->second.outputSize;
+}
+
+bool JobJournal::Update(const std::string& source, const std::string& title, const std::string& output,
+                        JobState state, uint64_t outputSize) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    JournalEntry& entry = entries[MakeKey(source, title)];
+    entry.source = source;
+    entry.title = title;
+    entry.output = output;
+    entry.state = state;
+    entry.outputSize = outputSize;
+    return Save();
+}
+
+fs::path JobJournal::PartialPath(const fs::path& output) {
+    fs::path partial = output;
+    partial += ".partial";
+    return partial;
+}
+
+const char* JobJournal::GetStateName(JobState state) {
+    switch (state) {
+        case JobState::Processing: return "Processing";
+        case JobState::Completed:  return "Completed";
+        case JobState::Error:      return "Error";
+        case JobState::Stopped:    return "Stopped";
+        default:                   return "Unknown";
+    }
+}
+
+std::string JobJournal::MakeKey(const std::string& source, const std::string& title) {
+    return source + '\t' + title;
+}
+
+bool JobJournal::Save() const {
+    std::ostringstream text;
+    text << JournalHeader << ' ' << FormatVersion << '\n';
+    for (const auto& pair : entries) {
+        const JournalEntry& entry = pair.second;
+        // Windows paths cannot hold control characters; skip the odd POSIX one
+        // rather than corrupt the line structure
+        if ((entry.source + entry.title + entry.output).find_first_of("\t\r\n") != std::string::npos) {
+            continue;
+        }
+        text << GetStateName(entry.state) << '\t' << entry.outputSize << '\t'
+             << entry.source << '\t' << entry.title << '\t' << entry.output << '\n';
+    }
+
+    // Same temporary-file-and-rename scheme as ScanCache::Store, but the
+    // journal has to survive a power cut, so the data and the rename are
+    // synced to disk
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    fs::path tempPath = path;
+    tempPath += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::string data = text.str();
+        file.write(data.data(), data.size());
+        file.flush();
+        if (!file) {
+            file.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    if (!DurableRename(tempPath, path, ec)) {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
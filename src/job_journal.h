@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// Last known state of one title's remux. The names match the status column
+// (BDMVFile::status) so the journal reads like the UI did when it was written.
+enum class JobState {
+    Processing, // Started and not finished: the run was interrupted if seen on load
+    Completed,
+    Error,
+    Stopped
+};
+
+struct JournalEntry {
+    std::string source;     // Disc folder as added to the list
+    std::string title;      // Playlist file name, e.g. 00800.mpls
+    std::string output;     // Final MKV path
+    JobState state = JobState::Processing;
+    uint64_t outputSize = 0; // Size of the finished MKV, to notice it being replaced or truncated
+};
+
+// Persistent record of remux jobs, kept next to the outputs so a batch that
+// dies part way through can pick up where it stopped. Every update rewrites
+// the whole (small) journal to a temporary file and renames it into place,
+// so a crash leaves either the old or the new journal, never a torn one.
+//
+// Outputs are written to PartialPath(output) and only renamed to their final
+// name on success, so a final-named MKV is always complete.
+class JobJournal {
+public:
+    static constexpr const char* FileName = "multiremuxer-journal.txt";
+    static constexpr int FormatVersion = 1;
+
+    explicit JobJournal(const fs::path& outputDirectory);
+
+    // Reads the journal if there is one; a missing or unreadable journal is empty
+    void Load();
+
+    // Deletes the partial outputs of jobs the last run never finished and
+    // returns how many there were. Those jobs simply run again.
+    size_t RecoverInterrupted();
+
+    // True if the title finished in an earlier run and its output is still intact
+    bool IsCompleted(const std::string& source, const std::string& title, const std::string& output) const;
+
+    // Thread-safe; returns false if the journal could not be written
+    bool Update(const std::string& source, const std::string& title, const std::string& output,
+                JobState state, uint64_t outputSize = 0);
+
+    static fs::path PartialPath(const fs::path& output);
+    static const char* GetStateName(JobState state);
+
+private:
+    static std::string MakeKey(const std::string& source, const std::string& title);
+    bool Save() const; // Caller holds mutex
+
+    fs::path path;
+    mutable std::mutex mutex;
+    std::map<std::string, JournalEntry> entries;
+};
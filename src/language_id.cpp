@@ -0,0 +1,31 @@
+#include "language_id.h"
+#include <cctype>
+
+bool LanguageId::Parse(const std::string& text, LanguageId& id) {
+    auto equalsIgnoringCase = [&](const char* name) {
+        size_t i = 0;
+        for (; name[i] != '\0'; i++) {
+            if (i >= text.size() || std::tolower(static_cast<unsigned char>(name[i])) !=
+                                        std::tolower(static_cast<unsigned char>(text[i]))) {
+                return false;
+            }
+        }
+        return i == text.size();
+    };
+
+    if (text.size() == 3) {
+        // Malformed codes come back as und, which is only right if asked for
+        LanguageId code = FromCode(text);
+        if (!code.IsUndetermined() || equalsIgnoringCase("und")) {
+            id = code;
+            return true;
+        }
+    }
+    for (const auto& language : iso639::Languages) {
+        if (equalsIgnoringCase(language.name)) {
+            id = FromValue(language.code);
+            return true;
+        }
+    }
+    return false;
+}
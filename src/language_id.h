@@ -0,0 +1,648 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ISO 639-2 languages, for LanguageId. Codes are packed three lowercase
+// letters: ('e' << 16) | ('n' << 8) | 'g' for "eng", so the packed values sort
+// like the codes and the tables below can be binary searched at compile time.
+namespace iso639 {
+
+constexpr uint32_t Pack(const char (&code)[4]) {
+    return (static_cast<uint32_t>(static_cast<uint8_t>(code[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(code[1])) << 8) |
+           static_cast<uint32_t>(static_cast<uint8_t>(code[2]));
+}
+
+struct Language {
+    uint32_t code;
+    const char* name;
+};
+
+// Every bibliographic (B) code, in code order. Blu-ray discs use the B codes.
+inline constexpr Language Languages[] = {
+    {Pack("aar"), "Afar"},
+    {Pack("abk"), "Abkhazian"},
+    {Pack("ace"), "Achinese"},
+    {Pack("ach"), "Acoli"},
+    {Pack("ada"), "Adangme"},
+    {Pack("ady"), "Adyghe"},
+    {Pack("afa"), "Afro-Asiatic languages"},
+    {Pack("afh"), "Afrihili"},
+    {Pack("afr"), "Afrikaans"},
+    {Pack("ain"), "Ainu"},
+    {Pack("aka"), "Akan"},
+    {Pack("akk"), "Akkadian"},
+    {Pack("alb"), "Albanian"},
+    {Pack("ale"), "Aleut"},
+    {Pack("alg"), "Algonquian languages"},
+    {Pack("alt"), "Southern Altai"},
+    {Pack("amh"), "Amharic"},
+    {Pack("ang"), "Old English"},
+    {Pack("anp"), "Angika"},
+    {Pack("apa"), "Apache languages"},
+    {Pack("ara"), "Arabic"},
+    {Pack("arc"), "Aramaic"},
+    {Pack("arg"), "Aragonese"},
+    {Pack("arm"), "Armenian"},
+    {Pack("arn"), "Mapudungun"},
+    {Pack("arp"), "Arapaho"},
+    {Pack("art"), "Artificial languages"},
+    {Pack("arw"), "Arawak"},
+    {Pack("asm"), "Assamese"},
+    {Pack("ast"), "Asturian"},
+    {Pack("ath"), "Athapascan languages"},
+    {Pack("aus"), "Australian languages"},
+    {Pack("ava"), "Avaric"},
+    {Pack("ave"), "Avestan"},
+    {Pack("awa"), "Awadhi"},
+    {Pack("aym"), "Aymara"},
+    {Pack("aze"), "Azerbaijani"},
+    {Pack("bad"), "Banda languages"},
+    {Pack("bai"), "Bamileke languages"},
+    {Pack("bak"), "Bashkir"},
+    {Pack("bal"), "Baluchi"},
+    {Pack("bam"), "Bambara"},
+    {Pack("ban"), "Balinese"},
+    {Pack("baq"), "Basque"},
+    {Pack("bas"), "Basa"},
+    {Pack("bat"), "Baltic languages"},
+    {Pack("bej"), "Beja"},
+    {Pack("bel"), "Belarusian"},
+    {Pack("bem"), "Bemba"},
+    {Pack("ben"), "Bengali"},
+    {Pack("ber"), "Berber languages"},
+    {Pack("bho"), "Bhojpuri"},
+    {Pack("bih"), "Bihari languages"},
+    {Pack("bik"), "Bikol"},
+    {Pack("bin"), "Bini"},
+    {Pack("bis"), "Bislama"},
+    {Pack("bla"), "Siksika"},
+    {Pack("bnt"), "Bantu languages"},
+    {Pack("bos"), "Bosnian"},
+    {Pack("bra"), "Braj"},
+    {Pack("bre"), "Breton"},
+    {Pack("btk"), "Batak languages"},
+    {Pack("bua"), "Buriat"},
+    {Pack("bug"), "Buginese"},
+    {Pack("bul"), "Bulgarian"},
+    {Pack("bur"), "Burmese"},
+    {Pack("byn"), "Blin"},
+    {Pack("cad"), "Caddo"},
+    {Pack("cai"), "Central American Indian languages"},
+    {Pack("car"), "Galibi Carib"},
+    {Pack("cat"), "Catalan"},
+    {Pack("cau"), "Caucasian languages"},
+    {Pack("ceb"), "Cebuano"},
+    {Pack("cel"), "Celtic languages"},
+    {Pack("cha"), "Chamorro"},
+    {Pack("chb"), "Chibcha"},
+    {Pack("che"), "Chechen"},
+    {Pack("chg"), "Chagatai"},
+    {Pack("chi"), "Chinese"},
+    {Pack("chk"), "Chuukese"},
+    {Pack("chm"), "Mari"},
+    {Pack("chn"), "Chinook jargon"},
+    {Pack("cho"), "Choctaw"},
+    {Pack("chp"), "Chipewyan"},
+    {Pack("chr"), "Cherokee"},
+    {Pack("chu"), "Church Slavic"},
+    {Pack("chv"), "Chuvash"},
+    {Pack("chy"), "Cheyenne"},
+    {Pack("cmc"), "Chamic languages"},
+    {Pack("cnr"), "Montenegrin"},
+    {Pack("cop"), "Coptic"},
+    {Pack("cor"), "Cornish"},
+    {Pack("cos"), "Corsican"},
+    {Pack("cpe"), "English-based creoles and pidgins"},
+    {Pack("cpf"), "French-based creoles and pidgins"},
+    {Pack("cpp"), "Portuguese-based creoles and pidgins"},
+    {Pack("cre"), "Cree"},
+    {Pack("crh"), "Crimean Tatar"},
+    {Pack("crp"), "Creoles and pidgins"},
+    {Pack("csb"), "Kashubian"},
+    {Pack("cus"), "Cushitic languages"},
+    {Pack("cze"), "Czech"},
+    {Pack("dak"), "Dakota"},
+    {Pack("dan"), "Danish"},
+    {Pack("dar"), "Dargwa"},
+    {Pack("day"), "Land Dayak languages"},
+    {Pack("del"), "Delaware"},
+    {Pack("den"), "Slave (Athapascan)"},
+    {Pack("dgr"), "Dogrib"},
+    {Pack("din"), "Dinka"},
+    {Pack("div"), "Divehi"},
+    {Pack("doi"), "Dogri"},
+    {Pack("dra"), "Dravidian languages"},
+    {Pack("dsb"), "Lower Sorbian"},
+    {Pack("dua"), "Duala"},
+    {Pack("dum"), "Middle Dutch"},
+    {Pack("dut"), "Dutch"},
+    {Pack("dyu"), "Dyula"},
+    {Pack("dzo"), "Dzongkha"},
+    {Pack("efi"), "Efik"},
+    {Pack("egy"), "Ancient Egyptian"},
+    {Pack("eka"), "Ekajuk"},
+    {Pack("elx"), "Elamite"},
+    {Pack("eng"), "English"},
+    {Pack("enm"), "Middle English"},
+    {Pack("epo"), "Esperanto"},
+    {Pack("est"), "Estonian"},
+    {Pack("ewe"), "Ewe"},
+    {Pack("ewo"), "Ewondo"},
+    {Pack("fan"), "Fang"},
+    {Pack("fao"), "Faroese"},
+    {Pack("fat"), "Fanti"},
+    {Pack("fij"), "Fijian"},
+    {Pack("fil"), "Filipino"},
+    {Pack("fin"), "Finnish"},
+    {Pack("fiu"), "Finno-Ugrian languages"},
+    {Pack("fon"), "Fon"},
+    {Pack("fre"), "French"},
+    {Pack("frm"), "Middle French"},
+    {Pack("fro"), "Old French"},
+    {Pack("frr"), "Northern Frisian"},
+    {Pack("frs"), "Eastern Frisian"},
+    {Pack("fry"), "Western Frisian"},
+    {Pack("ful"), "Fulah"},
+    {Pack("fur"), "Friulian"},
+    {Pack("gaa"), "Ga"},
+    {Pack("gay"), "Gayo"},
+    {Pack("gba"), "Gbaya"},
+    {Pack("gem"), "Germanic languages"},
+    {Pack("geo"), "Georgian"},
+    {Pack("ger"), "German"},
+    {Pack("gez"), "Geez"},
+    {Pack("gil"), "Gilbertese"},
+    {Pack("gla"), "Scottish Gaelic"},
+    {Pack("gle"), "Irish"},
+    {Pack("glg"), "Galician"},
+    {Pack("glv"), "Manx"},
+    {Pack("gmh"), "Middle High German"},
+    {Pack("goh"), "Old High German"},
+    {Pack("gon"), "Gondi"},
+    {Pack("gor"), "Gorontalo"},
+    {Pack("got"), "Gothic"},
+    {Pack("grb"), "Grebo"},
+    {Pack("grc"), "Ancient Greek"},
+    {Pack("gre"), "Greek"},
+    {Pack("grn"), "Guarani"},
+    {Pack("gsw"), "Swiss German"},
+    {Pack("guj"), "Gujarati"},
+    {Pack("gwi"), "Gwich'in"},
+    {Pack("hai"), "Haida"},
+    {Pack("hat"), "Haitian"},
+    {Pack("hau"), "Hausa"},
+    {Pack("haw"), "Hawaiian"},
+    {Pack("heb"), "Hebrew"},
+    {Pack("her"), "Herero"},
+    {Pack("hil"), "Hiligaynon"},
+    {Pack("him"), "Himachali languages"},
+    {Pack("hin"), "Hindi"},
+    {Pack("hit"), "Hittite"},
+    {Pack("hmn"), "Hmong"},
+    {Pack("hmo"), "Hiri Motu"},
+    {Pack("hrv"), "Croatian"},
+    {Pack("hsb"), "Upper Sorbian"},
+    {Pack("hun"), "Hungarian"},
+    {Pack("hup"), "Hupa"},
+    {Pack("iba"), "Iban"},
+    {Pack("ibo"), "Igbo"},
+    {Pack("ice"), "Icelandic"},
+    {Pack("ido"), "Ido"},
+    {Pack("iii"), "Sichuan Yi"},
+    {Pack("ijo"), "Ijo languages"},
+    {Pack("iku"), "Inuktitut"},
+    {Pack("ile"), "Interlingue"},
+    {Pack("ilo"), "Iloko"},
+    {Pack("ina"), "Interlingua"},
+    {Pack("inc"), "Indic languages"},
+    {Pack("ind"), "Indonesian"},
+    {Pack("ine"), "Indo-European languages"},
+    {Pack("inh"), "Ingush"},
+    {Pack("ipk"), "Inupiaq"},
+    {Pack("ira"), "Iranian languages"},
+    {Pack("iro"), "Iroquoian languages"},
+    {Pack("ita"), "Italian"},
+    {Pack("jav"), "Javanese"},
+    {Pack("jbo"), "Lojban"},
+    {Pack("jpn"), "Japanese"},
+    {Pack("jpr"), "Judeo-Persian"},
+    {Pack("jrb"), "Judeo-Arabic"},
+    {Pack("kaa"), "Kara-Kalpak"},
+    {Pack("kab"), "Kabyle"},
+    {Pack("kac"), "Kachin"},
+    {Pack("kal"), "Kalaallisut"},
+    {Pack("kam"), "Kamba"},
+    {Pack("kan"), "Kannada"},
+    {Pack("kar"), "Karen languages"},
+    {Pack("kas"), "Kashmiri"},
+    {Pack("kau"), "Kanuri"},
+    {Pack("kaw"), "Kawi"},
+    {Pack("kaz"), "Kazakh"},
+    {Pack("kbd"), "Kabardian"},
+    {Pack("kha"), "Khasi"},
+    {Pack("khi"), "Khoisan languages"},
+    {Pack("khm"), "Khmer"},
+    {Pack("kho"), "Khotanese"},
+    {Pack("kik"), "Kikuyu"},
+    {Pack("kin"), "Kinyarwanda"},
+    {Pack("kir"), "Kirghiz"},
+    {Pack("kmb"), "Kimbundu"},
+    {Pack("kok"), "Konkani"},
+    {Pack("kom"), "Komi"},
+    {Pack("kon"), "Kongo"},
+    {Pack("kor"), "Korean"},
+    {Pack("kos"), "Kosraean"},
+    {Pack("kpe"), "Kpelle"},
+    {Pack("krc"), "Karachay-Balkar"},
+    {Pack("krl"), "Karelian"},
+    {Pack("kro"), "Kru languages"},
+    {Pack("kru"), "Kurukh"},
+    {Pack("kua"), "Kuanyama"},
+    {Pack("kum"), "Kumyk"},
+    {Pack("kur"), "Kurdish"},
+    {Pack("kut"), "Kutenai"},
+    {Pack("lad"), "Ladino"},
+    {Pack("lah"), "Lahnda"},
+    {Pack("lam"), "Lamba"},
+    {Pack("lao"), "Lao"},
+    {Pack("lat"), "Latin"},
+    {Pack("lav"), "Latvian"},
+    {Pack("lez"), "Lezghian"},
+    {Pack("lim"), "Limburgish"},
+    {Pack("lin"), "Lingala"},
+    {Pack("lit"), "Lithuanian"},
+    {Pack("lol"), "Mongo"},
+    {Pack("loz"), "Lozi"},
+    {Pack("ltz"), "Luxembourgish"},
+    {Pack("lua"), "Luba-Lulua"},
+    {Pack("lub"), "Luba-Katanga"},
+    {Pack("lug"), "Ganda"},
+    {Pack("lui"), "Luiseno"},
+    {Pack("lun"), "Lunda"},
+    {Pack("luo"), "Luo"},
+    {Pack("lus"), "Lushai"},
+    {Pack("mac"), "Macedonian"},
+    {Pack("mad"), "Madurese"},
+    {Pack("mag"), "Magahi"},
+    {Pack("mah"), "Marshallese"},
+    {Pack("mai"), "Maithili"},
+    {Pack("mak"), "Makasar"},
+    {Pack("mal"), "Malayalam"},
+    {Pack("man"), "Mandingo"},
+    {Pack("mao"), "Maori"},
+    {Pack("map"), "Austronesian languages"},
+    {Pack("mar"), "Marathi"},
+    {Pack("mas"), "Masai"},
+    {Pack("may"), "Malay"},
+    {Pack("mdf"), "Moksha"},
+    {Pack("mdr"), "Mandar"},
+    {Pack("men"), "Mende"},
+    {Pack("mga"), "Middle Irish"},
+    {Pack("mic"), "Mi'kmaq"},
+    {Pack("min"), "Minangkabau"},
+    {Pack("mis"), "Uncoded languages"},
+    {Pack("mkh"), "Mon-Khmer languages"},
+    {Pack("mlg"), "Malagasy"},
+    {Pack("mlt"), "Maltese"},
+    {Pack("mnc"), "Manchu"},
+    {Pack("mni"), "Manipuri"},
+    {Pack("mno"), "Manobo languages"},
+    {Pack("moh"), "Mohawk"},
+    {Pack("mon"), "Mongolian"},
+    {Pack("mos"), "Mossi"},
+    {Pack("mul"), "Multiple languages"},
+    {Pack("mun"), "Munda languages"},
+    {Pack("mus"), "Creek"},
+    {Pack("mwl"), "Mirandese"},
+    {Pack("mwr"), "Marwari"},
+    {Pack("myn"), "Mayan languages"},
+    {Pack("myv"), "Erzya"},
+    {Pack("nah"), "Nahuatl languages"},
+    {Pack("nai"), "North American Indian languages"},
+    {Pack("nap"), "Neapolitan"},
+    {Pack("nau"), "Nauru"},
+    {Pack("nav"), "Navajo"},
+    {Pack("nbl"), "South Ndebele"},
+    {Pack("nde"), "North Ndebele"},
+    {Pack("ndo"), "Ndonga"},
+    {Pack("nds"), "Low German"},
+    {Pack("nep"), "Nepali"},
+    {Pack("new"), "Newari"},
+    {Pack("nia"), "Nias"},
+    {Pack("nic"), "Niger-Kordofanian languages"},
+    {Pack("niu"), "Niuean"},
+    {Pack("nno"), "Norwegian Nynorsk"},
+    {Pack("nob"), "Norwegian Bokmal"},
+    {Pack("nog"), "Nogai"},
+    {Pack("non"), "Old Norse"},
+    {Pack("nor"), "Norwegian"},
+    {Pack("nqo"), "N'Ko"},
+    {Pack("nso"), "Northern Sotho"},
+    {Pack("nub"), "Nubian languages"},
+    {Pack("nwc"), "Classical Newari"},
+    {Pack("nya"), "Chichewa"},
+    {Pack("nym"), "Nyamwezi"},
+    {Pack("nyn"), "Nyankole"},
+    {Pack("nyo"), "Nyoro"},
+    {Pack("nzi"), "Nzima"},
+    {Pack("oci"), "Occitan"},
+    {Pack("oji"), "Ojibwa"},
+    {Pack("ori"), "Oriya"},
+    {Pack("orm"), "Oromo"},
+    {Pack("osa"), "Osage"},
+    {Pack("oss"), "Ossetian"},
+    {Pack("ota"), "Ottoman Turkish"},
+    {Pack("oto"), "Otomian languages"},
+    {Pack("paa"), "Papuan languages"},
+    {Pack("pag"), "Pangasinan"},
+    {Pack("pal"), "Pahlavi"},
+    {Pack("pam"), "Pampanga"},
+    {Pack("pan"), "Punjabi"},
+    {Pack("pap"), "Papiamento"},
+    {Pack("pau"), "Palauan"},
+    {Pack("peo"), "Old Persian"},
+    {Pack("per"), "Persian"},
+    {Pack("phi"), "Philippine languages"},
+    {Pack("phn"), "Phoenician"},
+    {Pack("pli"), "Pali"},
+    {Pack("pol"), "Polish"},
+    {Pack("pon"), "Pohnpeian"},
+    {Pack("por"), "Portuguese"},
+    {Pack("pra"), "Prakrit languages"},
+    {Pack("pro"), "Old Provencal"},
+    {Pack("pus"), "Pashto"},
+    {Pack("que"), "Quechua"},
+    {Pack("raj"), "Rajasthani"},
+    {Pack("rap"), "Rapanui"},
+    {Pack("rar"), "Rarotongan"},
+    {Pack("roa"), "Romance languages"},
+    {Pack("roh"), "Romansh"},
+    {Pack("rom"), "Romany"},
+    {Pack("rum"), "Romanian"},
+    {Pack("run"), "Rundi"},
+    {Pack("rup"), "Aromanian"},
+    {Pack("rus"), "Russian"},
+    {Pack("sad"), "Sandawe"},
+    {Pack("sag"), "Sango"},
+    {Pack("sah"), "Yakut"},
+    {Pack("sai"), "South American Indian languages"},
+    {Pack("sal"), "Salishan languages"},
+    {Pack("sam"), "Samaritan Aramaic"},
+    {Pack("san"), "Sanskrit"},
+    {Pack("sas"), "Sasak"},
+    {Pack("sat"), "Santali"},
+    {Pack("scn"), "Sicilian"},
+    {Pack("sco"), "Scots"},
+    {Pack("sel"), "Selkup"},
+    {Pack("sem"), "Semitic languages"},
+    {Pack("sga"), "Old Irish"},
+    {Pack("sgn"), "Sign languages"},
+    {Pack("shn"), "Shan"},
+    {Pack("sid"), "Sidamo"},
+    {Pack("sin"), "Sinhala"},
+    {Pack("sio"), "Siouan languages"},
+    {Pack("sit"), "Sino-Tibetan languages"},
+    {Pack("sla"), "Slavic languages"},
+    {Pack("slo"), "Slovak"},
+    {Pack("slv"), "Slovenian"},
+    {Pack("sma"), "Southern Sami"},
+    {Pack("sme"), "Northern Sami"},
+    {Pack("smi"), "Sami languages"},
+    {Pack("smj"), "Lule Sami"},
+    {Pack("smn"), "Inari Sami"},
+    {Pack("smo"), "Samoan"},
+    {Pack("sms"), "Skolt Sami"},
+    {Pack("sna"), "Shona"},
+    {Pack("snd"), "Sindhi"},
+    {Pack("snk"), "Soninke"},
+    {Pack("sog"), "Sogdian"},
+    {Pack("som"), "Somali"},
+    {Pack("son"), "Songhai languages"},
+    {Pack("sot"), "Southern Sotho"},
+    {Pack("spa"), "Spanish"},
+    {Pack("srd"), "Sardinian"},
+    {Pack("srn"), "Sranan Tongo"},
+    {Pack("srp"), "Serbian"},
+    {Pack("srr"), "Serer"},
+    {Pack("ssa"), "Nilo-Saharan languages"},
+    {Pack("ssw"), "Swati"},
+    {Pack("suk"), "Sukuma"},
+    {Pack("sun"), "Sundanese"},
+    {Pack("sus"), "Susu"},
+    {Pack("sux"), "Sumerian"},
+    {Pack("swa"), "Swahili"},
+    {Pack("swe"), "Swedish"},
+    {Pack("syc"), "Classical Syriac"},
+    {Pack("syr"), "Syriac"},
+    {Pack("tah"), "Tahitian"},
+    {Pack("tai"), "Tai languages"},
+    {Pack("tam"), "Tamil"},
+    {Pack("tat"), "Tatar"},
+    {Pack("tel"), "Telugu"},
+    {Pack("tem"), "Timne"},
+    {Pack("ter"), "Tereno"},
+    {Pack("tet"), "Tetum"},
+    {Pack("tgk"), "Tajik"},
+    {Pack("tgl"), "Tagalog"},
+    {Pack("tha"), "Thai"},
+    {Pack("tib"), "Tibetan"},
+    {Pack("tig"), "Tigre"},
+    {Pack("tir"), "Tigrinya"},
+    {Pack("tiv"), "Tiv"},
+    {Pack("tkl"), "Tokelau"},
+    {Pack("tlh"), "Klingon"},
+    {Pack("tli"), "Tlingit"},
+    {Pack("tmh"), "Tamashek"},
+    {Pack("tog"), "Tonga (Nyasa)"},
+    {Pack("ton"), "Tongan"},
+    {Pack("tpi"), "Tok Pisin"},
+    {Pack("tsi"), "Tsimshian"},
+    {Pack("tsn"), "Tswana"},
+    {Pack("tso"), "Tsonga"},
+    {Pack("tuk"), "Turkmen"},
+    {Pack("tum"), "Tumbuka"},
+    {Pack("tup"), "Tupi languages"},
+    {Pack("tur"), "Turkish"},
+    {Pack("tut"), "Altaic languages"},
+    {Pack("tvl"), "Tuvalu"},
+    {Pack("twi"), "Twi"},
+    {Pack("tyv"), "Tuvinian"},
+    {Pack("udm"), "Udmurt"},
+    {Pack("uga"), "Ugaritic"},
+    {Pack("uig"), "Uighur"},
+    {Pack("ukr"), "Ukrainian"},
+    {Pack("umb"), "Umbundu"},
+    {Pack("und"), "Unknown"},
+    {Pack("urd"), "Urdu"},
+    {Pack("uzb"), "Uzbek"},
+    {Pack("vai"), "Vai"},
+    {Pack("ven"), "Venda"},
+    {Pack("vie"), "Vietnamese"},
+    {Pack("vol"), "Volapuk"},
+    {Pack("vot"), "Votic"},
+    {Pack("wak"), "Wakashan languages"},
+    {Pack("wal"), "Wolaitta"},
+    {Pack("war"), "Waray"},
+    {Pack("was"), "Washo"},
+    {Pack("wel"), "Welsh"},
+    {Pack("wen"), "Sorbian languages"},
+    {Pack("wln"), "Walloon"},
+    {Pack("wol"), "Wolof"},
+    {Pack("xal"), "Kalmyk"},
+    {Pack("xho"), "Xhosa"},
+    {Pack("yao"), "Yao"},
+    {Pack("yap"), "Yapese"},
+    {Pack("yid"), "Yiddish"},
+    {Pack("yor"), "Yoruba"},
+    {Pack("ypk"), "Yupik languages"},
+    {Pack("zap"), "Zapotec"},
+    {Pack("zbl"), "Blissymbols"},
+    {Pack("zen"), "Zenaga"},
+    {Pack("zgh"), "Standard Moroccan Tamazight"},
+    {Pack("zha"), "Zhuang"},
+    {Pack("znd"), "Zande languages"},
+    {Pack("zul"), "Zulu"},
+    {Pack("zun"), "Zuni"},
+    {Pack("zxx"), "No linguistic content"},
+    {Pack("zza"), "Zaza"},
+};
+
+// Terminology (T) codes and the B codes they stand for, in T code order
+struct Alias {
+    uint32_t code;
+    uint32_t canonical;
+};
+
+inline constexpr Alias Aliases[] = {
+    {Pack("bod"), Pack("tib")}, {Pack("ces"), Pack("cze")}, {Pack("cym"), Pack("wel")},
+    {Pack("deu"), Pack("ger")}, {Pack("ell"), Pack("gre")}, {Pack("eus"), Pack("baq")},
+    {Pack("fas"), Pack("per")}, {Pack("fra"), Pack("fre")}, {Pack("hye"), Pack("arm")},
+    {Pack("isl"), Pack("ice")}, {Pack("kat"), Pack("geo")}, {Pack("mkd"), Pack("mac")},
+    {Pack("mri"), Pack("mao")}, {Pack("msa"), Pack("may")}, {Pack("mya"), Pack("bur")},
+    {Pack("nld"), Pack("dut")}, {Pack("ron"), Pack("rum")}, {Pack("slk"), Pack("slo")},
+    {Pack("sqi"), Pack("alb")}, {Pack("zho"), Pack("chi")},
+};
+
+constexpr size_t LanguageCount = sizeof(Languages) / sizeof(Languages[0]);
+constexpr size_t AliasCount = sizeof(Aliases) / sizeof(Aliases[0]);
+
+// Index of a packed code in Languages, or LanguageCount
+constexpr size_t FindLanguage(uint32_t code) {
+    size_t low = 0;
+    size_t high = LanguageCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (Languages[middle].code < code) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < LanguageCount && Languages[low].code == code ? low : LanguageCount;
+}
+
+// The B code for a T code; other codes are returned as they are
+constexpr uint32_t Canonical(uint32_t code) {
+    size_t low = 0;
+    size_t high = AliasCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (Aliases[middle].code < code) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < AliasCount && Aliases[low].code == code ? Aliases[low].canonical : code;
+}
+
+constexpr bool TablesSorted() {
+    for (size_t i = 1; i < LanguageCount; i++) {
+        if (Languages[i - 1].code >= Languages[i].code) {
+            return false;
+        }
+    }
+    for (size_t i = 1; i < AliasCount; i++) {
+        if (Aliases[i - 1].code >= Aliases[i].code) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(TablesSorted(), "ISO 639-2 tables must be sorted by code for the binary searches");
+
+} // namespace iso639
+
+// A language as a 32-bit ISO 639-2 code (see iso639::Pack): titles, stream
+// attributes, language selections and ffmpeg arguments all carry this rather
+// than display names, so comparing languages compares integers. T codes fold
+// into their B twins (fra is fre). Codes missing from the table stay what
+// they are and are shown by code; only malformed codes become "und".
+class LanguageId {
+public:
+    constexpr LanguageId() : value(iso639::Pack("und")) {}
+    constexpr explicit LanguageId(const char (&code)[4]) : value(FromLetters(code, 3)) {}
+
+    // Three ASCII letters in either case
+    static constexpr LanguageId FromCode(const char* code, size_t length) {
+        LanguageId id;
+        id.value = FromLetters(code, length);
+        return id;
+    }
+    static LanguageId FromCode(const std::string& code) { return FromCode(code.data(), code.size()); }
+
+    // The packed value, e.g. for the scan cache
+    constexpr uint32_t Value() const { return value; }
+    static constexpr LanguageId FromValue(uint32_t packed) {
+        const char code[3] = {static_cast<char>(packed >> 16), static_cast<char>(packed >> 8),
+                              static_cast<char>(packed)};
+        return packed > 0xFFFFFF ? LanguageId() : FromCode(code, 3);
+    }
+
+    // A code ("eng", "FRA") or an English name ("English", any case); false if neither
+    static bool Parse(const std::string& text, LanguageId& id);
+
+    constexpr bool IsKnown() const { return iso639::FindLanguage(value) != iso639::LanguageCount; }
+    constexpr bool IsUndetermined() const { return value == iso639::Pack("und"); }
+
+    std::string Code() const {
+        return {static_cast<char>(value >> 16), static_cast<char>(value >> 8), static_cast<char>(value)};
+    }
+
+    // English name; the code for languages missing from the table
+    std::string Name() const {
+        size_t index = iso639::FindLanguage(value);
+        return index != iso639::LanguageCount ? iso639::Languages[index].name : Code();
+    }
+
+    constexpr bool operator==(LanguageId other) const { return value == other.value; }
+    constexpr bool operator!=(LanguageId other) const { return value != other.value; }
+    constexpr bool operator<(LanguageId other) const { return value < other.value; }
+
+private:
+    static constexpr uint32_t FromLetters(const char* code, size_t length) {
+        if (length != 3) {
+            return iso639::Pack("und");
+        }
+        uint32_t packed = 0;
+        for (size_t i = 0; i < 3; i++) {
+            char c = code[i];
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+            if (c < 'a' || c > 'z') {
+                return iso639::Pack("und");
+            }
+            packed = (packed << 8) | static_cast<uint8_t>(c);
+        }
+        return iso639::Canonical(packed);
+    }
+
+    uint32_t value;
+};
+
+static_assert(LanguageId("fra") == LanguageId("fre"), "T codes fold into B codes");
+static_assert(LanguageId("eng").IsKnown() && !LanguageId("qaa").IsKnown(), "");
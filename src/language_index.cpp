@@ -0,0 +1,72 @@
+#include "language_index.h"
+#include <algorithm>
+
+size_t LanguageIndex::LowerBound(LanguageId language, const std::string& name) const {
+    // Names are unique in the ISO table, but codes without one show as the code
+    auto it = std::lower_bound(rows.begin(), rows.end(), language, [&](const Row& row, LanguageId value) {
+        return row.name != name ? row.name < name : row.language < value;
+    });
+    return static_cast<size_t>(it - rows.begin());
+}
+
+void LanguageIndex::Add(const std::vector<LanguageId>& languages, std::vector<RowChange>& changes) {
+    for (LanguageId language : languages) {
+        std::string name = language.Name();
+        size_t row = LowerBound(language, name);
+        if (row < rows.size() && rows[row].language == language) {
+            rows[row].titles++;
+            continue;
+        }
+        Row added;
+        added.language = language;
+        added.name = std::move(name);
+        added.titles = 1;
+        added.checked = std::find(checkedByDefault.begin(), checkedByDefault.end(), language) !=
+                        checkedByDefault.end();
+        if (added.checked) {
+            checkedCount++;
+        }
+        rows.insert(rows.begin() + row, std::move(added));
+        changes.push_back({true, row, language, rows[row].checked});
+    }
+}
+
+void LanguageIndex::Remove(const std::vector<LanguageId>& languages, std::vector<RowChange>& changes) {
+    for (LanguageId language : languages) {
+        size_t row = LowerBound(language, language.Name());
+        if (row >= rows.size() || rows[row].language != language) {
+            continue; // Never counted in
+        }
+        if (--rows[row].titles > 0) {
+            continue;
+        }
+        if (rows[row].checked) {
+            checkedCount--;
+        }
+        rows.erase(rows.begin() + row);
+        changes.push_back({false, row, language, false});
+    }
+}
+
+void LanguageIndex::SetChecked(size_t row, bool checked) {
+    if (row >= rows.size() || rows[row].checked == checked) {
+        return;
+    }
+    rows[row].checked = checked;
+    if (checked) {
+        checkedCount++;
+    } else {
+        checkedCount--;
+    }
+}
+
+std::vector<LanguageId> LanguageIndex::CheckedLanguages() const {
+    std::vector<LanguageId> languages;
+    languages.reserve(checkedCount);
+    for (const auto& row : rows) {
+        if (row.checked) {
+            languages.push_back(row.language);
+        }
+    }
+    return languages;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "language_id.h"
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The rows of one of the UI's language lists (audio or subtitles): every
+// language some queued title carries, in display name order, with the number of
+// titles carrying it and whether its row is checked. Titles are counted in
+// and out as discs are added, removed or re-analyzed, and only the rows that
+// appear or disappear are reported, so a list view applies the difference
+// instead of being rebuilt.
+class LanguageIndex {
+public:
+    // A row to insert into or delete from the list view. Apply changes in
+    // the order they are reported; each row number is valid at that point.
+    struct RowChange {
+        bool inserted = false;
+        size_t row = 0;
+        LanguageId language;
+        bool checked = false; // Inserted rows: the initial check box state
+    };
+
+    // New rows of these languages start out checked
+    explicit LanguageIndex(std::vector<LanguageId> checkedByDefault = {})
+        : checkedByDefault(std::move(checkedByDefault)) {}
+
+    // One title's languages (each listed once) counted in or out
+    void Add(const std::vector<LanguageId>& languages, std::vector<RowChange>& changes);
+    void Remove(const std::vector<LanguageId>& languages, std::vector<RowChange>& changes);
+
+    size_t RowCount() const { return rows.size(); }
+    LanguageId RowLanguage(size_t row) const { return rows[row].language; }
+    const std::string& RowName(size_t row) const { return rows[row].name; }
+
+    // Mirrors a row's check box, e.g. from LVN_ITEMCHANGED; rows out of range are ignored
+    void SetChecked(size_t row, bool checked);
+    bool IsChecked(size_t row) const { return row < rows.size() && rows[row].checked; }
+    size_t CheckedCount() const { return checkedCount; }
+
+    // Checked languages in row order
+    std::vector<LanguageId> CheckedLanguages() const;
+
+private:
+    struct Row {
+        LanguageId language;
+        std::string name; // LanguageId::Name(), the sort key
+        size_t titles = 0;
+        bool checked = false;
+    };
+
+    // First row not ordered before the language, which has this name
+    size_t LowerBound(LanguageId language, const std::string& name) const;
+
+    std::vector<LanguageId> checkedByDefault;
+    std::vector<Row> rows;
+    size_t checkedCount = 0;
+};
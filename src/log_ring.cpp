@@ -0,0 +1,126 @@
+#include "log_ring.h"
+#include <cstdio>
+#include <ctime>
+
+std::string FormatLogLine(const LogEntry& entry) {
+    std::time_t time = std::chrono::system_clock::to_time_t(entry.time);
+    std::tm local = {};
+#ifdef _WIN32
+    localtime_s(&local, &time);
+#else
+    localtime_r(&time, &local);
+#endif
+    char stamp[16];
+    std::snprintf(stamp, sizeof(stamp), "[%02d:%02d:%02d] ", local.tm_hour, local.tm_min, local.tm_sec);
+    return stamp + entry.message;
+}
+
+LogRing::LogRing(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slots.reset(new Slot[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool LogRing::Push(std::string message) {
+    // A slot is free for position p when its sequence is p, and holds the
+    // line of position p once its sequence is p + 1
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+        slot = &slots[position & mask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed); // Full: the consumer is a lap behind
+            return false;
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->entry.time = std::chrono::system_clock::now();
+    slot->entry.message = std::move(message);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+size_t LogRing::Drain(std::vector<LogEntry>& entries, size_t maxEntries) {
+    size_t taken = 0;
+    while (taken < maxEntries) {
+        Slot& slot = slots[dequeuePosition & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePosition + 1) {
+            break; // Empty, or the next line is still being written
+        }
+        entries.push_back(std::move(slot.entry));
+        slot.entry.message = std::string();
+        slot.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+        dequeuePosition++;
+        taken++;
+    }
+    return taken;
+}
+
+bool RotatingLogFile::Open(const fs::path& logPath, uint64_t maxBytes, int backupCount) {
+    path = logPath;
+    maxSize = maxBytes;
+    backups = backupCount;
+
+    std::error_code ec;
+    if (path.has_parent_path()) {
+        fs::create_directories(path.parent_path(), ec);
+    }
+    size = fs::exists(path, ec) ? fs::file_size(path, ec) : 0;
+    if (ec) {
+        size = 0;
+    }
+    file.open(path, std::ios::binary | std::ios::app);
+    return file.is_open();
+}
+
+void RotatingLogFile::Write(const std::string& text) {
+    if (!file.is_open() || text.empty()) {
+        return;
+    }
+    if (size > 0 && size + text.size() > maxSize) {
+        Rotate();
+        if (!file.is_open()) {
+            return;
+        }
+    }
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    file.flush();
+    size += text.size();
+}
+
+void RotatingLogFile::Rotate() {
+    file.close();
+
+    // name.N-1 -> name.N, ..., name -> name.1; the oldest falls off the end
+    auto numbered = [&](int index) {
+        fs::path rotated = path;
+        rotated += "." + std::to_string(index);
+        return rotated;
+    };
+    std::error_code ec;
+    if (backups > 0) {
+        fs::remove(numbered(backups), ec);
+        for (int i = backups - 1; i >= 1; i--) {
+            fs::rename(numbered(i), numbered(i + 1), ec);
+        }
+        fs::rename(path, numbered(1), ec);
+    }
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    size = 0;
+}
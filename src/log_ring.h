@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct LogEntry {
+    std::chrono::system_clock::time_point time;
+    std::string message;
+};
+
+// "[12:34:56] message", in local time
+std::string FormatLogLine(const LogEntry& entry);
+
+// Bounded multi-producer, single-consumer queue of log lines (Vyukov's
+// bounded queue with per-slot sequence numbers). Workers push without locks
+// or blocking; the UI drains whatever has arrived once per tick. A full ring
+// drops the line and counts it, so a flood of output can neither stall the
+// workers nor grow without limit.
+class LogRing {
+public:
+    static constexpr size_t DefaultCapacity = 4096;
+
+    // The capacity is rounded up to a power of two
+    explicit LogRing(size_t capacity = DefaultCapacity);
+
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    // Any thread; false if the line was dropped
+    bool Push(std::string message);
+
+    // Consumer thread only: appends up to maxEntries queued lines, oldest
+    // first, and returns how many were taken
+    size_t Drain(std::vector<LogEntry>& entries, size_t maxEntries = SIZE_MAX);
+
+    // Lines dropped since the last call
+    size_t TakeDropped() { return dropped.exchange(0, std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        LogEntry entry;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> enqueuePosition{0};
+    alignas(64) size_t dequeuePosition = 0;
+    std::atomic<size_t> dropped{0};
+};
+
+// Append-only log file that rolls over to "<name>.1" .. "<name>.N" when it
+// would grow past maxSize, so a long session cannot fill the disk
+class RotatingLogFile {
+public:
+    static constexpr uint64_t DefaultMaxSize = 8 * 1024 * 1024;
+    static constexpr int DefaultBackups = 3;
+
+    bool Open(const fs::path& logPath, uint64_t maxBytes = DefaultMaxSize, int backupCount = DefaultBackups);
+    bool IsOpen() const { return file.is_open(); }
+
+    // One batch of complete lines ("\n"-terminated), written and flushed together
+    void Write(const std::string& text);
+
+private:
+    void Rotate();
+
+    fs::path path;
+    std::ofstream file;
+    uint64_t size = 0;
+    uint64_t maxSize = DefaultMaxSize;
+    int backups = DefaultBackups;
+};
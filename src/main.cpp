@@ -8,13 +8,22 @@
 #include <map>
 #include <set>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
 #include <filesystem>
 #include <fstream>
 #include <regex>
 #include <iostream>
 #include <algorithm>
+#include <cstdlib>
 #include "bdmv_parser.h"
 #include "ffmpeg_wrapper.h"
+#include "scan_pool.h"
+#include "remux_batch.h"
+#include "cancel_token.h"
+#include "language_index.h"
+#include "log_ring.h"
 
 namespace fs = std::filesystem;
 
@@ -29,17 +38,71 @@ namespace fs = std::filesystem;
 #define ID_BUTTON_STOP          1008
 #define ID_EDIT_OUTPUT          1009
 #define ID_BUTTON_OUTPUT_BROWSE 1010
+#define ID_CHECK_NATIVE_MUXER   1011
+
+// Timers
+#define ID_TIMER_PROGRESS       2001
+#define PROGRESS_REFRESH_MS     250
+#define ID_TIMER_LOG            2002
+#define LOG_REFRESH_MS          100
+
+// Console history; older lines are trimmed in chunks once it grows past this
+#define CONSOLE_MAX_LINES       2000
 
 // Custom messages
-#define WM_UPDATE_PROGRESS      (WM_USER + 1)
-#define WM_ADD_LOG             (WM_USER + 2)
 #define WM_PROCESSING_COMPLETE  (WM_USER + 3)
+#define WM_DISC_SCANNED         (WM_USER + 4)
+#define WM_FILE_STATUS          (WM_USER + 5)
+#define WM_TITLE_ANALYZED       (WM_USER + 6)
+
+// Posted with WM_TITLE_ANALYZED by the deep scan tier
+struct AnalyzedTitle {
+    size_t file;
+    size_t index;
+    BDMVTitle title;
+};
 
-struct BDMVFile {
-    std::string path;
-    std::string description;
-    std::vector<BDMVTitle> titles;
-    std::string status;
+// Where pool threads hand results to the window. Scan tasks hold it by
+// shared_ptr and can outlive the window, and even the MultiRemuxer (the scan
+// pool is a static that drains its queue at exit), so WM_DESTROY detaches it:
+// from then on results are dropped, and their payloads freed, instead of
+// being posted to a window that is gone.
+class UiSink {
+public:
+    UiSink(HWND window, LogRing& log) : window(window), log(&log) {}
+    
+    // Posts a message owning `payload`; the payload is freed if it cannot be delivered
+    template <typename T>
+    void Post(UINT message, WPARAM wParam, T* payload) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!window || !PostMessage(window, message, wParam, (LPARAM)payload)) {
+            delete payload;
+        }
+    }
+    
+    void Log(const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (log) {
+            log->Push(message);
+        }
+    }
+    
+    bool Detached() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return window == nullptr;
+    }
+    
+    // Once this returns nothing more is posted or logged
+    void Detach() {
+        std::lock_guard<std::mutex> lock(mutex);
+        window = nullptr;
+        log = nullptr;
+    }
+    
+private:
+    std::mutex mutex;
+    HWND window;
+    LogRing* log;
 };
 
 class MultiRemuxer {
@@ -53,14 +116,36 @@ private:
     HWND hOutputEdit;
     HWND hStartButton;
     HWND hStopButton;
+    HWND hNativeMuxerCheck;
     
     std::vector<BDMVFile> files;
-    std::vector<std::string> selectedAudioLanguages;
-    std::vector<std::string> selectedSubtitleLanguages;
+    std::vector<LanguageId> selectedAudioLanguages;
+    std::vector<LanguageId> selectedSubtitleLanguages;
+    // Rows and check boxes of hAudioListView / hSubtitleListView; English is checked by default
+    LanguageIndex audioLanguageIndex{std::vector<LanguageId>{LanguageId("eng")}};
+    LanguageIndex subtitleLanguageIndex{std::vector<LanguageId>{LanguageId("eng")}};
+    bool applyingLanguageChanges = false; // The index already knows the states being set
     std::string outputDirectory;
     
-    bool isProcessing = false;
+    std::atomic<bool> isProcessing{false};
+    bool useNativeMuxer = false;
+    int pendingScans = 0;
+    size_t pendingAnalyses = 0; // Titles still in the deep scan tier
+    
+    // Remux progress written by scheduler threads and read by the UI timer,
+    // so a job can report as often as it likes without flooding the queue
+    std::mutex progressMutex;
+    std::map<size_t, RemuxProgress> runningProgress;
+    size_t jobsTotal = 0;
+    size_t jobsFinished = 0;
+    std::map<size_t, std::string> shownProgress; // UI thread only
     std::thread processingThread;
+    std::shared_ptr<CancelToken> cancelToken; // One per run, fired by Stop
+    
+    // Log lines from any thread, shown and written out once per LOG_REFRESH_MS
+    LogRing logRing;
+    RotatingLogFile logFile; // Mirror of the console when MULTIREMUX_LOG names a file
+    std::shared_ptr<UiSink> uiSink; // Scan results and status lines from other threads
     
 public:
     MultiRemuxer() {}
@@ -95,6 +180,12 @@ public:
         if (!hMainWindow) return false;
         
         CreateControls();
+        uiSink = std::make_shared<UiSink>(hMainWindow, logRing);
+        
+        if (const char* logPath = std::getenv("MULTIREMUX_LOG")) {
+            logFile.Open(logPath);
+        }
+        SetTimer(hMainWindow, ID_TIMER_LOG, LOG_REFRESH_MS, nullptr);
         
         // Enable drag and drop
         DragAcceptFiles(hMainWindow, TRUE);
@@ -126,11 +217,11 @@ public:
         ListView_InsertColumn(hFileListView, 1, &lvc);
         
         lvc.pszText = (LPWSTR)L"Description";
-        lvc.cx = 400;
+        lvc.cx = 300;
         ListView_InsertColumn(hFileListView, 2, &lvc);
         
         lvc.pszText = (LPWSTR)L"Status";
-        lvc.cx = 100;
+        lvc.cx = 240;
         ListView_InsertColumn(hFileListView, 3, &lvc);
         
         // Audio languages list
@@ -178,6 +269,7 @@ public:
             DEFAULT_QUALITY, FIXED_PITCH | FF_MODERN, L"Consolas"
         );
         SendMessage(hConsoleEdit, WM_SETFONT, (WPARAM)hConsoleFont, TRUE);
+        SendMessage(hConsoleEdit, EM_SETLIMITTEXT, 0, 0); // History is capped by line count instead
         
         // Progress bar
         hProgressBar = CreateWindow(
@@ -223,6 +315,13 @@ public:
             hMainWindow, (HMENU)ID_BUTTON_STOP, nullptr, nullptr
         );
         
+        hNativeMuxerCheck = CreateWindow(
+            L"BUTTON", L"Use built-in muxer (no ffmpeg)",
+            WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX,
+            850, 520, 250, 25,
+            hMainWindow, (HMENU)ID_CHECK_NATIVE_MUXER, nullptr, nullptr
+        );
+        
         CreateWindow(L"BUTTON", L"Add Files/Folders",
             WS_CHILD | WS_VISIBLE,
             20, 40, 150, 30,
@@ -265,32 +364,56 @@ public:
                 HandleDropFiles((HDROP)wParam);
                 break;
                 
-            case WM_UPDATE_PROGRESS:
-                SendMessage(hProgressBar, PBM_SETPOS, wParam, 0);
+            case WM_TIMER:
+                if (wParam == ID_TIMER_PROGRESS) {
+                    OnProgressTimer();
+                } else if (wParam == ID_TIMER_LOG) {
+                    FlushConsoleLog();
+                }
                 break;
                 
-            case WM_ADD_LOG: {
-                std::string* logMessage = reinterpret_cast<std::string*>(lParam);
-                AddConsoleLog(*logMessage);
-                delete logMessage;
-                break;
-            }
-            
             case WM_PROCESSING_COMPLETE:
                 OnProcessingComplete();
                 break;
                 
+            case WM_DISC_SCANNED:
+                OnDiscScanned(reinterpret_cast<BDMVFile*>(lParam));
+                break;
+                
+            case WM_TITLE_ANALYZED:
+                OnTitleAnalyzed(reinterpret_cast<AnalyzedTitle*>(lParam));
+                break;
+                
+            case WM_FILE_STATUS: {
+                std::string* status = reinterpret_cast<std::string*>(lParam);
+                OnFileStatus(static_cast<size_t>(wParam), *status);
+                delete status;
+                break;
+            }
+                
             case WM_NOTIFY: {
                 LPNMHDR pnmhdr = (LPNMHDR)lParam;
                 if (pnmhdr->idFrom == ID_LISTVIEW_AUDIO && pnmhdr->code == LVN_ITEMCHANGED) {
-                    UpdateSelectedAudioLanguages();
+                    OnLanguageItemChanged(audioLanguageIndex, reinterpret_cast<LPNMLISTVIEW>(lParam));
                 } else if (pnmhdr->idFrom == ID_LISTVIEW_SUBTITLES && pnmhdr->code == LVN_ITEMCHANGED) {
-                    UpdateSelectedSubtitleLanguages();
+                    OnLanguageItemChanged(subtitleLanguageIndex, reinterpret_cast<LPNMLISTVIEW>(lParam));
                 }
                 break;
             }
             
             case WM_DESTROY:
+                // Don't leave ffmpeg running, or half-written files behind
+                if (cancelToken) {
+                    cancelToken->Cancel();
+                }
+                if (processingThread.joinable()) {
+                    processingThread.join();
+                }
+                // Scans and title analyses still queued or running report nowhere from here on
+                uiSink->Detach();
+                FreePostedPayloads();
+                KillTimer(hMainWindow, ID_TIMER_LOG);
+                FlushConsoleLog(); // The last lines still reach the log file
                 PostQuitMessage(0);
                 break;
                 
@@ -300,6 +423,20 @@ public:
         return 0;
     }
     
+    // Results posted before the sink was detached that will never be handled
+    void FreePostedPayloads() {
+        MSG msg;
+        while (PeekMessage(&msg, hMainWindow, WM_DISC_SCANNED, WM_TITLE_ANALYZED, PM_REMOVE)) {
+            if (msg.message == WM_DISC_SCANNED) {
+                delete reinterpret_cast<BDMVFile*>(msg.lParam);
+            } else if (msg.message == WM_TITLE_ANALYZED) {
+                delete reinterpret_cast<AnalyzedTitle*>(msg.lParam);
+            } else {
+                delete reinterpret_cast<std::string*>(msg.lParam);
+            }
+        }
+    }
+    
     void HandleCommand(WORD commandId) {
         switch (commandId) {
             case ID_BUTTON_BROWSE:
@@ -335,47 +472,96 @@ public:
         }
         
         DragFinish(hDrop);
-        RefreshLanguageLists();
     }
     
     void AnalyzeAndAddFile(const std::string& path) {
-        try {
-            fs::path fsPath(path);
+        // Structural scan on the pool, posted back as WM_DISC_SCANNED; the
+        // disc is listed from that, and its languages follow title by title
+        // The task only holds the sink, never this
+        pendingScans++;
+        ScanPool::Instance().Submit([sink = uiSink, path]() {
+            if (sink->Detached()) {
+                return; // Closed while this disc was still queued
+            }
+            BDMVFile* file = new BDMVFile();
+            if (!AnalyzeFile(path, *file, sink)) {
+                delete file;
+                file = nullptr;
+            }
+            sink->Post(WM_DISC_SCANNED, 0, file);
+        });
+    }
+    
+    // Runs on a scan pool thread, so it only reports through the sink
+    static bool AnalyzeFile(const std::string& path, BDMVFile& file, const std::shared_ptr<UiSink>& sink) {
+        return RemuxBatch::AnalyzeDisc(path, file, [sink](const std::string& message) { sink->Log(message); },
+                                       ScanDepth::Structure);
+    }
+    
+    void OnDiscScanned(BDMVFile* file) {
+        pendingScans--;
+        
+        if (file) {
+            files.push_back(*file);
+            delete file;
             
-            // Check if it's a BDMV folder or contains BDMV
-            if (fs::is_directory(fsPath)) {
-                if (fsPath.filename() == "BDMV" || fs::exists(fsPath / "BDMV")) {
-                    // Use BDMVParser to analyze the folder
-                    std::vector<BDMVTitle> titles = BDMVParser::ParseBDMVFolder(path);
-                    
-                    if (!titles.empty()) {
-                        BDMVFile file;
-                        file.path = path;
-                        file.status = "Ready";
-                        
-                        if (fsPath.filename() == "BDMV") {
-                            file.description = fsPath.parent_path().filename().string();
-                        } else {
-                            file.description = fsPath.filename().string();
-                        }
-                        
-                        // Convert BDMVTitle to our internal format
-                        for (const auto& title : titles) {
-                            file.titles.push_back(title);
-                        }
-                        
-                        files.push_back(file);
-                        AddFileToListView(file, files.size());
-                        AddConsoleLog("Added: " + file.description);
+            const BDMVFile& added = files.back();
+            AddFileToListView(added, files.size());
+            AddConsoleLog("Added: " + added.description);
+            if (!added.indexSummary.empty()) {
+                AddConsoleLog("  index.bdmv: " + added.indexSummary);
+            }
+            for (const auto& title : added.titles) {
+                if (!title.duplicates.empty()) {
+                    std::string dropped;
+                    for (const auto& name : title.duplicates) {
+                        dropped += (dropped.empty() ? "" : ", ") + name;
                     }
+                    AddConsoleLog("  Kept " + title.filename + " over " + dropped + ": " + title.selectionNote);
                 }
-            } else if (fsPath.extension() == ".iso") {
-                AddConsoleLog("ISO files require mounting - not yet implemented");
             }
-        } catch (const std::exception& e) {
-            AddConsoleLog("Error analyzing: " + path + " - " + e.what());
+            RefreshLanguageLists({}, added.titles);
+            
+            size_t fileIndex = files.size() - 1;
+            pendingAnalyses += RemuxBatch::AnalyzeTitlesAsync(added,
+                [sink = uiSink, fileIndex](size_t index, const BDMVTitle& title) {
+                    sink->Post(WM_TITLE_ANALYZED, 0, new AnalyzedTitle{fileIndex, index, title});
+                });
+        }
+        
+        if (pendingScans == 0) {
+            AddConsoleLog("Scan complete: " + std::to_string(files.size()) + " discs queued");
         }
     }
+    
+    void OnTitleAnalyzed(AnalyzedTitle* analyzed) {
+        pendingAnalyses--;
+        
+        // File indices are stable: discs are only ever appended
+        if (analyzed->file < files.size() && analyzed->index < files[analyzed->file].titles.size()) {
+            BDMVTitle& title = files[analyzed->file].titles[analyzed->index];
+            if (title.filename == analyzed->title.filename) {
+                // The title's structural languages are counted out, the analyzed ones in
+                UpdateLanguageList(hAudioListView, audioLanguageIndex, title.audioLanguages,
+                                   analyzed->title.audioLanguages);
+                UpdateLanguageList(hSubtitleListView, subtitleLanguageIndex, title.subtitleLanguages,
+                                   analyzed->title.subtitleLanguages);
+                title.audioLanguages = std::move(analyzed->title.audioLanguages);
+                title.subtitleLanguages = std::move(analyzed->title.subtitleLanguages);
+                title.analyzed = analyzed->title.analyzed;
+            }
+        }
+        delete analyzed;
+        
+        if (pendingAnalyses == 0 && pendingScans == 0) {
+            AddConsoleLog("Stream analysis complete");
+        }
+    }
+    
+    // Any thread: queued for the next log tick, without a message per line
+    void PostLog(const std::string& message) {
+        logRing.Push(message);
+    }
         
     void AddFileToListView(const BDMVFile& file, int index) {
         LVITEM lvi = {};
@@ -400,82 +586,62 @@ public:
         ListView_SetItemText(hFileListView, index - 1, 3, (LPWSTR)status.c_str());
     }
     
-    void RefreshLanguageLists() {
-        // Clear existing items
-        ListView_DeleteAllItems(hAudioListView);
-        ListView_DeleteAllItems(hSubtitleListView);
-        
-        // Collect all unique languages
-        std::set<std::string> audioLangs, subtitleLangs;
-        
-        for (const auto& file : files) {
-            for (const auto& title : file.titles) {
-                audioLangs.insert(title.audioLanguages.begin(), title.audioLanguages.end());
-                subtitleLangs.insert(title.subtitleLanguages.begin(), title.subtitleLanguages.end());
-            }
+    // Counts titles out of (e.g. a removed disc) and into the language
+    // indexes; the list views only see the rows that appear or disappear
+    void RefreshLanguageLists(const std::vector<BDMVTitle>& removed, const std::vector<BDMVTitle>& added) {
+        for (const auto& title : removed) {
+            UpdateLanguageList(hAudioListView, audioLanguageIndex, title.audioLanguages, {});
+            UpdateLanguageList(hSubtitleListView, subtitleLanguageIndex, title.subtitleLanguages, {});
         }
-        
-        // Add to list views
-        int index = 0;
-        for (const auto& lang : audioLangs) {
-            LVITEM lvi = {};
-            lvi.mask = LVIF_TEXT;
-            lvi.iItem = index++;
-            std::wstring wLang(lang.begin(), lang.end());
-            lvi.pszText = (LPWSTR)wLang.c_str();
-            ListView_InsertItem(hAudioListView, &lvi);
-            
-            // Check English by default
-            if (lang == "English") {
-                ListView_SetCheckState(hAudioListView, index - 1, TRUE);
-            }
+        for (const auto& title : added) {
+            UpdateLanguageList(hAudioListView, audioLanguageIndex, {}, title.audioLanguages);
+            UpdateLanguageList(hSubtitleListView, subtitleLanguageIndex, {}, title.subtitleLanguages);
+        }
+    }
+    
+    void UpdateLanguageList(HWND listView, LanguageIndex& index, const std::vector<LanguageId>& removed,
+                            const std::vector<LanguageId>& added) {
+        std::vector<LanguageIndex::RowChange> changes;
+        index.Remove(removed, changes);
+        index.Add(added, changes);
+        if (changes.empty()) {
+            return;
         }
         
-        index = 0;
-        for (const auto& lang : subtitleLangs) {
+        applyingLanguageChanges = true;
+        SendMessage(listView, WM_SETREDRAW, FALSE, 0);
+        for (const auto& change : changes) {
+            int row = static_cast<int>(change.row);
+            if (!change.inserted) {
+                ListView_DeleteItem(listView, row);
+                continue;
+            }
+            
             LVITEM lvi = {};
             lvi.mask = LVIF_TEXT;
-            lvi.iItem = index++;
-            std::wstring wLang(lang.begin(), lang.end());
+            lvi.iItem = row;
+            std::string name = change.language.Name();
+            std::wstring wLang(name.begin(), name.end());
             lvi.pszText = (LPWSTR)wLang.c_str();
-            ListView_InsertItem(hSubtitleListView, &lvi);
-            
-            // Check English by default
-            if (lang == "English") {
-                ListView_SetCheckState(hSubtitleListView, index - 1, TRUE);
-            }
-        }
-        
-        UpdateSelectedAudioLanguages();
-        UpdateSelectedSubtitleLanguages();
-    }
-    
-    void UpdateSelectedAudioLanguages() {
-        selectedAudioLanguages.clear();
-        int itemCount = ListView_GetItemCount(hAudioListView);
-        
-        for (int i = 0; i < itemCount; i++) {
-            if (ListView_GetCheckState(hAudioListView, i)) {
-                wchar_t buffer[256];
-                ListView_GetItemText(hAudioListView, i, 0, buffer, 256);
-                std::wstring wLang(buffer);
-                selectedAudioLanguages.emplace_back(wLang.begin(), wLang.end());
+            ListView_InsertItem(listView, &lvi);
+            if (change.checked) {
+                ListView_SetCheckState(listView, row, TRUE);
             }
         }
+        SendMessage(listView, WM_SETREDRAW, TRUE, 0);
+        applyingLanguageChanges = false;
+        InvalidateRect(listView, nullptr, TRUE);
     }
     
-    void UpdateSelectedSubtitleLanguages() {
-        selectedSubtitleLanguages.clear();
-        int itemCount = ListView_GetItemCount(hSubtitleListView);
-        
-        for (int i = 0; i < itemCount; i++) {
-            if (ListView_GetCheckState(hSubtitleListView, i)) {
-                wchar_t buffer[256];
-                ListView_GetItemText(hSubtitleListView, i, 0, buffer, 256);
-                std::wstring wLang(buffer);
-                selectedSubtitleLanguages.emplace_back(wLang.begin(), wLang.end());
-            }
+    // One row's check box changed: O(1), nothing is rescanned
+    void OnLanguageItemChanged(LanguageIndex& index, LPNMLISTVIEW change) {
+        if (applyingLanguageChanges || change->iItem < 0 || !(change->uChanged & LVIF_STATE) ||
+            !((change->uNewState ^ change->uOldState) & LVIS_STATEIMAGEMASK)) {
+            return;
         }
+        // State image 2 is the checked box, 1 the empty one
+        bool checked = ((change->uNewState & LVIS_STATEIMAGEMASK) >> 12) == 2;
+        index.SetChecked(static_cast<size_t>(change->iItem), checked);
     }
     
     void BrowseForFiles() {
@@ -492,7 +658,6 @@ public:
                 std::wstring wPath(path);
                 std::string strPath(wPath.begin(), wPath.end());
                 AnalyzeAndAddFile(strPath);
-                RefreshLanguageLists();
             }
             CoTaskMemFree(pidl);
         }
@@ -527,95 +692,119 @@ public:
             return;
         }
         
+        // The previous run has posted WM_PROCESSING_COMPLETE, so this is quick
+        if (processingThread.joinable()) {
+            processingThread.join();
+        }
+        
+        // Read by ProcessFiles, which starts below
+        selectedAudioLanguages = audioLanguageIndex.CheckedLanguages();
+        selectedSubtitleLanguages = subtitleLanguageIndex.CheckedLanguages();
+        
         isProcessing = true;
+        cancelToken = std::make_shared<CancelToken>();
+        useNativeMuxer = SendMessage(hNativeMuxerCheck, BM_GETCHECK, 0, 0) == BST_CHECKED;
         EnableWindow(hStartButton, FALSE);
         EnableWindow(hStopButton, TRUE);
         
+        SendMessage(hProgressBar, PBM_SETPOS, 0, 0);
+        shownProgress.clear();
+        SetTimer(hMainWindow, ID_TIMER_PROGRESS, PROGRESS_REFRESH_MS, nullptr);
+        
         // Start processing thread
-        processingThread = std::thread(&MultiRemuxer::ProcessFiles, this);
-        processingThread.detach();
+        processingThread = std::thread(&MultiRemuxer::ProcessFiles, this, files, cancelToken);
         
         AddConsoleLog("Processing started...");
     }
     
     void StopProcessing() {
         isProcessing = false;
+        // Drops queued jobs and terminates running ffmpeg trees; the jobs
+        // remove their partial output and report "Stopped"
+        if (cancelToken) {
+            cancelToken->Cancel();
+        }
         AddConsoleLog("Processing stopped by user");
     }
     
-    void ProcessFiles() {
-        try {
-            fs::create_directories(outputDirectory);
-            
-            for (size_t i = 0; i < files.size() && isProcessing; i++) {
-                auto& file = files[i];
-                
-                // Update status in list view
-                std::wstring status = L"Processing...";
-                ListView_SetItemText(hFileListView, static_cast<int>(i), 3, (LPWSTR)status.c_str());
-                
-                // Process main title (longest duration)
-                if (!file.titles.empty()) {
-                    auto mainTitle = *std::max_element(file.titles.begin(), file.titles.end(),
-                        [](const BDMVTitle& a, const BDMVTitle& b) {
-                            return a.duration < b.duration;
-                        });
-                    
-                    std::string outputFile = outputDirectory + "\\" + file.description + ".mkv";
-                    
-                    bool success = ProcessTitle(file.path, mainTitle, outputFile);
-                    
-                    if (success) {
-                        file.status = "Completed";
-                        status = L"Completed";
-                    } else {
-                        file.status = "Error";
-                        status = L"Error";
-                    }
-                    
-                    ListView_SetItemText(hFileListView, static_cast<int>(i), 3, (LPWSTR)status.c_str());
-                }
-                
-                // Update progress
-                int progress = (int)(((i + 1.0) / files.size()) * 100);
-                PostMessage(hMainWindow, WM_UPDATE_PROGRESS, progress, 0);
-                
-                std::string* logMsg = new std::string("Processed: " + file.description);
-                PostMessage(hMainWindow, WM_ADD_LOG, 0, (LPARAM)logMsg);
-            }
-            
-        } catch (const std::exception& e) {
-            std::string* logMsg = new std::string("Processing error: " + std::string(e.what()));
-            PostMessage(hMainWindow, WM_ADD_LOG, 0, (LPARAM)logMsg);
+    // Runs on its own thread with a snapshot of the list, so the UI may keep adding discs
+    void ProcessFiles(std::vector<BDMVFile> batch, std::shared_ptr<CancelToken> cancel) {
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            runningProgress.clear();
+            jobsTotal = batch.size();
+            jobsFinished = 0;
         }
         
+        BatchOptions options;
+        options.outputDirectory = outputDirectory;
+        options.languages.audioLanguages = selectedAudioLanguages;
+        options.languages.subtitleLanguages = selectedSubtitleLanguages;
+        options.backend = useNativeMuxer ? RemuxBackend::Native : RemuxBackend::FFmpeg;
+        
+        BatchEvents events;
+        events.onLog = [this](const std::string& message) { PostLog(message); };
+        events.onStatus = [this](size_t index, const std::string& status) { PostFileStatus(index, status); };
+        events.onProgress = [this](size_t index, const RemuxProgress& progress) {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            runningProgress[index] = progress;
+        };
+        events.onFinished = [this](size_t index, bool) {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            runningProgress.erase(index);
+            jobsFinished++;
+        };
+        
+        RemuxBatch::Run(batch, options, events, *cancel);
+        
         PostMessage(hMainWindow, WM_PROCESSING_COMPLETE, 0, 0);
     }
     
-    bool ProcessTitle(const std::string& bdmvPath, const BDMVTitle& title, const std::string& outputFile) {
-        try {
-            // Build MPLS file path
-            std::string mplsPath = bdmvPath;
-            if (fs::path(bdmvPath).filename() != "BDMV") {
-                mplsPath += "\\BDMV";
+    void PostFileStatus(size_t index, const std::string& status) {
+        uiSink->Post(WM_FILE_STATUS, index, new std::string(status));
+    }
+    
+    void OnFileStatus(size_t index, const std::string& status) {
+        if (index >= files.size()) {
+            return;
+        }
+        files[index].status = status;
+        std::wstring wStatus(status.begin(), status.end());
+        ListView_SetItemText(hFileListView, static_cast<int>(index), 3, (LPWSTR)wStatus.c_str());
+    }
+    
+    // Coalesced progress: one progress bar and status refresh per timer tick
+    void OnProgressTimer() {
+        std::map<size_t, RemuxProgress> snapshot;
+        double overall = 0;
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            snapshot = runningProgress;
+            if (jobsTotal == 0) {
+                return;
+            }
+            double done = static_cast<double>(jobsFinished);
+            for (const auto& entry : runningProgress) {
+                done += entry.second.fraction;
+            }
+            overall = done / jobsTotal;
+        }
+        
+        SendMessage(hProgressBar, PBM_SETPOS, static_cast<int>(overall * 100), 0);
+        
+        for (const auto& entry : snapshot) {
+            std::string text = RemuxBatch::FormatProgress(entry.second);
+            std::string& shown = shownProgress[entry.first];
+            if (text != shown && entry.first < files.size()) {
+                shown = text;
+                std::wstring wText(text.begin(), text.end());
+                ListView_SetItemText(hFileListView, static_cast<int>(entry.first), 3, (LPWSTR)wText.c_str());
             }
-            mplsPath += "\\PLAYLIST\\" + title.filename;
-            
-            // Use FFmpegWrapper to process
-            FFmpegWrapper::StreamOptions options;
-            options.audioLanguages = selectedAudioLanguages;
-            options.subtitleLanguages = selectedSubtitleLanguages;
-            options.threads = 8; // Use 8 threads for good performance
-            
-            return FFmpegWrapper::RemuxBDMV(mplsPath, outputFile, options);
-            
-        } catch (const std::exception& e) {
-            AddConsoleLog("Error processing title: " + std::string(e.what()));
-            return false;
         }
     }
     
     void OnProcessingComplete() {
+        KillTimer(hMainWindow, ID_TIMER_PROGRESS);
         isProcessing = false;
         EnableWindow(hStartButton, TRUE);
         EnableWindow(hStopButton, FALSE);
@@ -624,23 +813,63 @@ public:
     }
     
     void AddConsoleLog(const std::string& message) {
-        // Get current time
-        SYSTEMTIME st;
-        GetLocalTime(&st);
+        PostLog(message);
+    }
+    
+    // One drain per tick: every queued line goes to the log file, and the
+    // console gets them in a single append, trimmed to CONSOLE_MAX_LINES
+    void FlushConsoleLog() {
+        std::vector<LogEntry> entries;
+        logRing.Drain(entries);
+        size_t dropped = logRing.TakeDropped();
+        if (entries.empty() && dropped == 0) {
+            return;
+        }
         
-        char timeStr[32];
-        sprintf_s(timeStr, "[%02d:%02d:%02d] ", st.wHour, st.wMinute, st.wSecond);
+        std::vector<std::string> lines;
+        lines.reserve(entries.size() + 1);
+        for (const auto& entry : entries) {
+            lines.push_back(FormatLogLine(entry));
+        }
+        if (dropped > 0) {
+            lines.push_back(FormatLogLine({std::chrono::system_clock::now(),
+                                           std::to_string(dropped) + " log lines dropped"}));
+        }
         
-        std::string fullMessage = timeStr + message + "\r\n";
+        if (logFile.IsOpen()) {
+            std::string text;
+            for (const auto& line : lines) {
+                text += line + "\n";
+            }
+            logFile.Write(text);
+        }
         
-        // Append to console
+        // Lines that would be trimmed straight away are not shown at all
+        size_t first = lines.size() > CONSOLE_MAX_LINES ? lines.size() - CONSOLE_MAX_LINES : 0;
+        std::wstring text;
+        for (size_t i = first; i < lines.size(); i++) {
+            text.append(lines[i].begin(), lines[i].end());
+            text += L"\r\n";
+        }
+        
+        SendMessage(hConsoleEdit, WM_SETREDRAW, FALSE, 0);
         int length = GetWindowTextLength(hConsoleEdit);
         SendMessage(hConsoleEdit, EM_SETSEL, length, length);
+        SendMessage(hConsoleEdit, EM_REPLACESEL, FALSE, (LPARAM)text.c_str());
+        
+        // Trim to three quarters of the cap, so this happens once in a while
+        int lineCount = static_cast<int>(SendMessage(hConsoleEdit, EM_GETLINECOUNT, 0, 0));
+        if (lineCount > CONSOLE_MAX_LINES) {
+            int remove = lineCount - CONSOLE_MAX_LINES * 3 / 4;
+            int end = static_cast<int>(SendMessage(hConsoleEdit, EM_LINEINDEX, remove, 0));
+            SendMessage(hConsoleEdit, EM_SETSEL, 0, end);
+            SendMessage(hConsoleEdit, EM_REPLACESEL, FALSE, (LPARAM)L"");
+            length = GetWindowTextLength(hConsoleEdit);
+            SendMessage(hConsoleEdit, EM_SETSEL, length, length);
+        }
         
-        std::wstring wMessage(fullMessage.begin(), fullMessage.end());
-        SendMessage(hConsoleEdit, EM_REPLACESEL, FALSE, (LPARAM)wMessage.c_str());
-        
-        // Scroll to bottom
+        SendMessage(hConsoleEdit, WM_SETREDRAW, TRUE, 0);
+        InvalidateRect(hConsoleEdit, nullptr, TRUE);
         SendMessage(hConsoleEdit, EM_SCROLLCARET, 0, 0);
     }
     
@@ -0,0 +1,456 @@
+#include "mkv_writer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Matroska element IDs (with their length marker bits)
+enum : uint32_t {
+    EbmlHeaderId = 0x1A45DFA3,
+    EbmlVersionId = 0x4286,
+    EbmlReadVersionId = 0x42F7,
+    EbmlMaxIdLengthId = 0x42F2,
+    EbmlMaxSizeLengthId = 0x42F3,
+    DocTypeId = 0x4282,
+    DocTypeVersionId = 0x4287,
+    DocTypeReadVersionId = 0x4285,
+    VoidId = 0xEC,
+
+    SegmentId = 0x18538067,
+    SeekHeadId = 0x114D9B74,
+    SeekId = 0x4DBB,
+    SeekIdId = 0x53AB,
+    SeekPositionId = 0x53AC,
+
+    InfoId = 0x1549A966,
+    TimecodeScaleId = 0x2AD7B1,
+    DurationId = 0x4489,
+    MuxingAppId = 0x4D80,
+    WritingAppId = 0x5741,
+
+    TracksId = 0x1654AE6B,
+    TrackEntryId = 0xAE,
+    TrackNumberId = 0xD7,
+    TrackUidId = 0x73C5,
+    TrackTypeId = 0x83,
+    FlagDefaultId = 0x88,
+    FlagLacingId = 0x9C,
+    LanguageId = 0x22B59C,
+    CodecIdId = 0x86,
+    CodecPrivateId = 0x63A2,
+    VideoId = 0xE0,
+    PixelWidthId = 0xB0,
+    PixelHeightId = 0xBA,
+    AudioId = 0xE1,
+    SamplingFrequencyId = 0xB5,
+    ChannelsId = 0x9F,
+    BitDepthId = 0x6264,
+
+    ClusterId = 0x1F43B675,
+    TimecodeId = 0xE7,
+    SimpleBlockId = 0xA3,
+
+    CuesId = 0x1C53BB6B,
+    CuePointId = 0xBB,
+    CueTimeId = 0xB3,
+    CueTrackPositionsId = 0xB7,
+    CueTrackId = 0xF7,
+    CueClusterPositionId = 0xF1,
+
+    ChaptersId = 0x1043A770,
+    EditionEntryId = 0x45B9,
+    EditionUidId = 0x45BC,
+    ChapterAtomId = 0xB6,
+    ChapterUidId = 0x73C4,
+    ChapterTimeStartId = 0x91,
+    ChapterDisplayId = 0x80,
+    ChapStringId = 0x85,
+    ChapLanguageId = 0x437C
+};
+
+constexpr size_t SeekHeadReserve = 200;
+constexpr uint64_t UnknownSize = 0x01FFFFFFFFFFFFFFull;
+
+// Appends EBML elements to a byte vector. Masters get an 8-byte size field
+// that is patched once their children are written.
+class EbmlBuffer {
+public:
+    explicit EbmlBuffer(std::vector<uint8_t>& output) : out(output) {}
+
+    void Id(uint32_t id) {
+        int bytes = id > 0xFFFFFF ? 4 : id > 0xFFFF ? 3 : id > 0xFF ? 2 : 1;
+        for (int i = bytes - 1; i >= 0; i--) {
+            out.push_back(static_cast<uint8_t>(id >> (i * 8)));
+        }
+    }
+
+    void Size(uint64_t size) {
+        int bytes = 1;
+        while (bytes < 8 && size >= (1ull << (7 * bytes)) - 1) {
+            bytes++;
+        }
+        SizeFixed(size, bytes);
+    }
+
+    void SizeFixed(uint64_t size, int bytes) {
+        size |= 1ull << (7 * bytes);
+        for (int i = bytes - 1; i >= 0; i--) {
+            out.push_back(static_cast<uint8_t>(size >> (i * 8)));
+        }
+    }
+
+    void UInt(uint32_t id, uint64_t value) {
+        int bytes = 1;
+        while (bytes < 8 && (value >> (bytes * 8)) != 0) {
+            bytes++;
+        }
+        Id(id);
+        Size(bytes);
+        for (int i = bytes - 1; i >= 0; i--) {
+            out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+
+    void Float(uint32_t id, double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        Id(id);
+        Size(8);
+        for (int i = 7; i >= 0; i--) {
+            out.push_back(static_cast<uint8_t>(bits >> (i * 8)));
+        }
+    }
+
+    void String(uint32_t id, const std::string& value) {
+        Binary(id, reinterpret_cast<const uint8_t*>(value.data()), value.size());
+    }
+
+    void Binary(uint32_t id, const uint8_t* data, size_t size) {
+        Id(id);
+        Size(size);
+        out.insert(out.end(), data, data + size);
+    }
+
+    size_t BeginMaster(uint32_t id) {
+        Id(id);
+        SizeFixed(0, 8);
+        return out.size();
+    }
+
+    void EndMaster(size_t start) {
+        uint64_t size = (out.size() - start) | (1ull << 56);
+        for (int i = 0; i < 8; i++) {
+            out[start - 8 + i] = static_cast<uint8_t>(size >> ((7 - i) * 8));
+        }
+    }
+
+    // Fills exactly totalSize bytes (at least 2) with a Void element
+    void Void(size_t totalSize) {
+        Id(VoidId);
+        size_t payload = totalSize - 2;
+        if (payload < 127) {
+            SizeFixed(payload, 1);
+        } else {
+            payload--;
+            SizeFixed(payload, 2);
+        }
+        out.insert(out.end(), payload, 0);
+    }
+
+    size_t Tell() const { return out.size(); }
+
+private:
+    std::vector<uint8_t>& out;
+};
+
+bool PatchFile(OutputWriter& output, uint64_t offset, const std::vector<uint8_t>& bytes) {
+    return output.Patch(offset, bytes.data(), bytes.size());
+}
+
+} // namespace
+
+MatroskaWriter::~MatroskaWriter() {
+    if (output.IsOpen()) {
+        Abort();
+    }
+}
+
+bool MatroskaWriter::Open(const fs::path& path, const std::vector<MkvTrack>& trackList,
+                          const OutputWriter::Options& outputOptions) {
+    if (output.IsOpen() || trackList.empty() || trackList.size() > 126) {
+        return false;
+    }
+
+    if (!output.Open(path, outputOptions)) {
+        return false;
+    }
+
+    filePath = path;
+    tracks = trackList;
+    cues.clear();
+    bytesWritten = 0;
+    clusterOpen = false;
+    endTimeMs = 0;
+
+    cueTrack = 1;
+    for (size_t i = 0; i < tracks.size(); i++) {
+        if (tracks[i].type == MkvTrackType::Video) {
+            cueTrack = i + 1;
+            break;
+        }
+    }
+
+    std::vector<uint8_t> header;
+    EbmlBuffer ebml(header);
+
+    size_t master = ebml.BeginMaster(EbmlHeaderId);
+    ebml.UInt(EbmlVersionId, 1);
+    ebml.UInt(EbmlReadVersionId, 1);
+    ebml.UInt(EbmlMaxIdLengthId, 4);
+    ebml.UInt(EbmlMaxSizeLengthId, 8);
+    ebml.String(DocTypeId, "matroska");
+    ebml.UInt(DocTypeVersionId, 4);
+    ebml.UInt(DocTypeReadVersionId, 2);
+    ebml.EndMaster(master);
+
+    // Segment size stays "unknown" until Close() patches it, so a file cut
+    // short by a crash is still readable up to its last complete cluster
+    ebml.Id(SegmentId);
+    segmentSizeOffset = ebml.Tell();
+    for (int i = 7; i >= 0; i--) {
+        header.push_back(static_cast<uint8_t>(UnknownSize >> (i * 8)));
+    }
+    segmentDataStart = ebml.Tell();
+
+    seekHeadOffset = ebml.Tell();
+    ebml.Void(SeekHeadReserve);
+
+    infoPosition = ebml.Tell() - segmentDataStart;
+    master = ebml.BeginMaster(InfoId);
+    ebml.UInt(TimecodeScaleId, TimecodeScale);
+    ebml.String(MuxingAppId, "Multi-REMUXer");
+    ebml.String(WritingAppId, "Multi-REMUXer");
+    ebml.Float(DurationId, 0.0);
+    durationOffset = ebml.Tell() - 8;
+    ebml.EndMaster(master);
+
+    tracksPosition = ebml.Tell() - segmentDataStart;
+    master = ebml.BeginMaster(TracksId);
+    for (size_t i = 0; i < tracks.size(); i++) {
+        const MkvTrack& track = tracks[i];
+        size_t entry = ebml.BeginMaster(TrackEntryId);
+        ebml.UInt(TrackNumberId, i + 1);
+        ebml.UInt(TrackUidId, i + 1);
+        ebml.UInt(TrackTypeId, static_cast<uint8_t>(track.type));
+        ebml.UInt(FlagDefaultId, track.isDefault ? 1 : 0);
+        ebml.UInt(FlagLacingId, 0);
+        ebml.String(LanguageId, track.language.empty() ? "und" : track.language);
+        ebml.String(CodecIdId, track.codecId);
+        if (!track.codecPrivate.empty()) {
+            ebml.Binary(CodecPrivateId, track.codecPrivate.data(), track.codecPrivate.size());
+        }
+
+        if (track.type == MkvTrackType::Video) {
+            size_t video = ebml.BeginMaster(VideoId);
+            ebml.UInt(PixelWidthId, track.width);
+            ebml.UInt(PixelHeightId, track.height);
+            ebml.EndMaster(video);
+        } else if (track.type == MkvTrackType::Audio) {
+            size_t audio = ebml.BeginMaster(AudioId);
+            ebml.Float(SamplingFrequencyId, track.sampleRate > 0 ? track.sampleRate : 48000.0);
+            ebml.UInt(ChannelsId, track.channels > 0 ? track.channels : 2);
+            if (track.bitDepth > 0) {
+                ebml.UInt(BitDepthId, track.bitDepth);
+            }
+            ebml.EndMaster(audio);
+        }
+        ebml.EndMaster(entry);
+    }
+    ebml.EndMaster(master);
+
+    if (!WriteBytes(header)) {
+        Abort();
+        return false;
+    }
+    return true;
+}
+
+bool MatroskaWriter::WriteFrame(size_t trackNumber, uint64_t timestampNs, bool keyframe,
+                                const uint8_t* data, size_t size) {
+    if (!output.IsOpen() || trackNumber == 0 || trackNumber > tracks.size()) {
+        return false;
+    }
+
+    uint64_t timeMs = timestampNs / TimecodeScale;
+    int64_t relative = static_cast<int64_t>(timeMs) - static_cast<int64_t>(clusterTimeMs);
+    bool cueFrame = trackNumber == cueTrack && keyframe;
+
+    // Clusters start on keyframes of the cue track once they are big or long
+    // enough, and unconditionally when a block timecode would overflow
+    bool startCluster = !clusterOpen ||
+        relative > INT16_MAX || relative < INT16_MIN ||
+        cluster.size() >= 4 * ClusterSizeLimit ||
+        (cueFrame && (!clusterHasCue || cluster.size() >= ClusterSizeLimit ||
+                      timeMs >= clusterTimeMs + ClusterTimeLimitMs));
+
+    if (startCluster) {
+        if (!FlushCluster()) {
+            return false;
+        }
+        clusterOpen = true;
+        clusterTimeMs = timeMs;
+        clusterHasCue = cueFrame;
+        relative = 0;
+    }
+
+    EbmlBuffer ebml(cluster);
+    ebml.Id(SimpleBlockId);
+    ebml.Size(size + 4);
+    cluster.push_back(static_cast<uint8_t>(0x80 | trackNumber));
+    cluster.push_back(static_cast<uint8_t>(static_cast<int16_t>(relative) >> 8));
+    cluster.push_back(static_cast<uint8_t>(static_cast<int16_t>(relative) & 0xFF));
+    cluster.push_back(keyframe ? 0x80 : 0x00);
+    cluster.insert(cluster.end(), data, data + size);
+
+    endTimeMs = std::max(endTimeMs, timeMs);
+    return true;
+}
+
+bool MatroskaWriter::FlushCluster() {
+    if (!clusterOpen) {
+        return true;
+    }
+
+    uint64_t position = SegmentPosition();
+    if (clusterHasCue) {
+        cues.push_back({clusterTimeMs, cueTrack, position});
+    }
+
+    std::vector<uint8_t> header;
+    EbmlBuffer ebml(header);
+    ebml.Id(ClusterId);
+
+    std::vector<uint8_t> timecode;
+    EbmlBuffer(timecode).UInt(TimecodeId, clusterTimeMs);
+    ebml.Size(timecode.size() + cluster.size());
+    header.insert(header.end(), timecode.begin(), timecode.end());
+
+    bool ok = WriteBytes(header) && WriteBytes(cluster);
+    cluster.clear();
+    clusterOpen = false;
+    return ok;
+}
+
+bool MatroskaWriter::WriteBytes(const std::vector<uint8_t>& bytes) {
+    if (!output.Write(bytes.data(), bytes.size())) {
+        return false;
+    }
+    bytesWritten += bytes.size();
+    return true;
+}
+
+bool MatroskaWriter::Close() {
+    if (!output.IsOpen()) {
+        return false;
+    }
+    if (!FlushCluster()) {
+        Abort();
+        return false;
+    }
+
+    std::vector<uint8_t> trailer;
+    EbmlBuffer ebml(trailer);
+
+    uint64_t cuesPosition = 0;
+    if (!cues.empty()) {
+        cuesPosition = SegmentPosition();
+        size_t master = ebml.BeginMaster(CuesId);
+        for (const auto& cue : cues) {
+            size_t point = ebml.BeginMaster(CuePointId);
+            ebml.UInt(CueTimeId, cue.timeMs);
+            size_t positions = ebml.BeginMaster(CueTrackPositionsId);
+            ebml.UInt(CueTrackId, cue.track);
+            ebml.UInt(CueClusterPositionId, cue.clusterPosition);
+            ebml.EndMaster(positions);
+            ebml.EndMaster(point);
+        }
+        ebml.EndMaster(master);
+    }
+
+    uint64_t chaptersPosition = 0;
+    if (!chapters.empty()) {
+        chaptersPosition = SegmentPosition() + trailer.size();
+        size_t master = ebml.BeginMaster(ChaptersId);
+        size_t edition = ebml.BeginMaster(EditionEntryId);
+        ebml.UInt(EditionUidId, 1);
+        for (size_t i = 0; i < chapters.size(); i++) {
+            size_t atom = ebml.BeginMaster(ChapterAtomId);
+            ebml.UInt(ChapterUidId, i + 1);
+            ebml.UInt(ChapterTimeStartId, chapters[i].startNs);
+            size_t display = ebml.BeginMaster(ChapterDisplayId);
+            ebml.String(ChapStringId, chapters[i].title);
+            ebml.String(ChapLanguageId, "eng");
+            ebml.EndMaster(display);
+            ebml.EndMaster(atom);
+        }
+        ebml.EndMaster(edition);
+        ebml.EndMaster(master);
+    }
+
+    if (!WriteBytes(trailer)) {
+        Abort();
+        return false;
+    }
+
+    // Seek head in the space reserved at the start of the segment
+    std::vector<uint8_t> seekHead;
+    EbmlBuffer seek(seekHead);
+    size_t master = seek.BeginMaster(SeekHeadId);
+    auto addSeek = [&](uint32_t id, uint64_t position) {
+        std::vector<uint8_t> idBytes;
+        EbmlBuffer(idBytes).Id(id);
+        size_t entry = seek.BeginMaster(SeekId);
+        seek.Binary(SeekIdId, idBytes.data(), idBytes.size());
+        seek.UInt(SeekPositionId, position);
+        seek.EndMaster(entry);
+    };
+    addSeek(InfoId, infoPosition);
+    addSeek(TracksId, tracksPosition);
+    if (!cues.empty()) {
+        addSeek(CuesId, cuesPosition);
+    }
+    if (!chapters.empty()) {
+        addSeek(ChaptersId, chaptersPosition);
+    }
+    seek.EndMaster(master);
+    seek.Void(SeekHeadReserve - seekHead.size());
+
+    std::vector<uint8_t> segmentSize;
+    EbmlBuffer(segmentSize).SizeFixed(bytesWritten - segmentDataStart, 8);
+
+    double durationMs = static_cast<double>(endTimeMs);
+    uint64_t durationBits;
+    std::memcpy(&durationBits, &durationMs, sizeof(durationBits));
+    std::vector<uint8_t> duration(8);
+    for (int i = 0; i < 8; i++) {
+        duration[i] = static_cast<uint8_t>(durationBits >> ((7 - i) * 8));
+    }
+
+    // Everything is on disk before the header fields that point into it
+    bool ok = output.Finish() &&
+              PatchFile(output, seekHeadOffset, seekHead) &&
+              PatchFile(output, segmentSizeOffset, segmentSize) &&
+              PatchFile(output, durationOffset, duration);
+
+    ok = output.Close() && ok;
+    return ok;
+}
+
+void MatroskaWriter::Abort() {
+    output.Abort();
+    cluster.clear();
+    clusterOpen = false;
+
+    std::error_code ec;
+    fs::remove(filePath, ec);
+}
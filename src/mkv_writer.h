@@ -0,0 +1,105 @@
+#pragma once
+#include "output_writer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+enum class MkvTrackType : uint8_t {
+    Video = 1,
+    Audio = 2,
+    Subtitle = 0x11
+};
+
+struct MkvTrack {
+    MkvTrackType type = MkvTrackType::Video;
+    std::string codecId;               // Matroska codec ID, e.g. "V_MPEG4/ISO/AVC"
+    std::vector<uint8_t> codecPrivate;
+    std::string language = "und";
+    bool isDefault = false;
+
+    // Video
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // Audio
+    double sampleRate = 0;
+    uint32_t channels = 0;
+    uint32_t bitDepth = 0;
+};
+
+struct MkvChapter {
+    uint64_t startNs = 0;
+    std::string title;
+};
+
+// Streaming Matroska writer for already-encoded frames. The file is written in
+// one pass: clusters go out through an OutputWriter as they fill up, and the
+// seek head, duration, cues and chapters are filled in by Close().
+class MatroskaWriter {
+public:
+    // Timestamps are stored in milliseconds (TimecodeScale = 1000000)
+    static constexpr uint64_t TimecodeScale = 1000000;
+    static constexpr size_t ClusterSizeLimit = 2 * 1024 * 1024;
+    static constexpr uint64_t ClusterTimeLimitMs = 5000;
+
+    MatroskaWriter() = default;
+    ~MatroskaWriter();
+
+    MatroskaWriter(const MatroskaWriter&) = delete;
+    MatroskaWriter& operator=(const MatroskaWriter&) = delete;
+
+    // Creates the file and writes the EBML header, Info and Tracks.
+    // Track numbers are the 1-based positions in `tracks`.
+    bool Open(const fs::path& path, const std::vector<MkvTrack>& tracks,
+              const OutputWriter::Options& outputOptions = {});
+
+    // Frames must arrive in roughly increasing order per track. Timestamps are
+    // in nanoseconds from the start of the output.
+    bool WriteFrame(size_t trackNumber, uint64_t timestampNs, bool keyframe,
+                    const uint8_t* data, size_t size);
+
+    void SetChapters(const std::vector<MkvChapter>& chapterList) { chapters = chapterList; }
+
+    // Flushes the last cluster and writes cues, chapters and the seek head
+    bool Close();
+
+    // Deletes the partially written file
+    void Abort();
+
+    uint64_t BytesWritten() const { return bytesWritten; }
+
+private:
+    struct CuePoint {
+        uint64_t timeMs;
+        size_t track;
+        uint64_t clusterPosition; // Relative to the segment data
+    };
+
+    bool FlushCluster();
+    bool WriteBytes(const std::vector<uint8_t>& bytes);
+    uint64_t SegmentPosition() const { return bytesWritten - segmentDataStart; }
+
+    OutputWriter output;
+    fs::path filePath;
+    std::vector<MkvTrack> tracks;
+    std::vector<MkvChapter> chapters;
+    std::vector<CuePoint> cues;
+
+    uint64_t bytesWritten = 0;
+    uint64_t segmentSizeOffset = 0;  // File offset of the Segment's size field
+    uint64_t segmentDataStart = 0;   // File offset of the first Segment child
+    uint64_t seekHeadOffset = 0;     // File offset of the Void reserved for the SeekHead
+    uint64_t durationOffset = 0;     // File offset of the Duration float payload
+    uint64_t infoPosition = 0;
+    uint64_t tracksPosition = 0;
+
+    std::vector<uint8_t> cluster;    // Blocks of the open cluster
+    bool clusterOpen = false;
+    uint64_t clusterTimeMs = 0;
+    bool clusterHasCue = false;
+    size_t cueTrack = 0;             // Track whose keyframes start clusters and get cues
+    uint64_t endTimeMs = 0;
+};
@@ -0,0 +1,945 @@
+#include "native_remuxer.h"
+#include "mkv_writer.h"
+#include "ts_demuxer.h"
+#include "cancel_token.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+enum class Codec {
+    Unsupported,
+    Mpeg2,
+    H264,
+    Hevc,
+    AC3,
+    EAC3,
+    TrueHD,
+    DTS,
+    LPCM,
+    PGS
+};
+
+Codec GetCodec(uint8_t codingType) {
+    switch (codingType) {
+        case 0x01: case 0x02: return Codec::Mpeg2;
+        case 0x1B: return Codec::H264;
+        case 0x24: return Codec::Hevc;
+        case 0x80: return Codec::LPCM;
+        case 0x81: return Codec::AC3;
+        case 0x83: return Codec::TrueHD;
+        case 0x82: case 0x85: case 0x86: case 0xA2: return Codec::DTS;
+        case 0x84: case 0xA1: return Codec::EAC3;
+        case 0x90: return Codec::PGS;
+        default: return Codec::Unsupported; // VC-1, text subtitles, IG menus
+    }
+}
+
+const char* GetCodecId(Codec codec) {
+    switch (codec) {
+        case Codec::Mpeg2:  return "V_MPEG2";
+        case Codec::H264:   return "V_MPEG4/ISO/AVC";
+        case Codec::Hevc:   return "V_MPEGH/ISO/HEVC";
+        case Codec::AC3:    return "A_AC3";
+        case Codec::EAC3:   return "A_EAC3";
+        case Codec::TrueHD: return "A_TRUEHD";
+        case Codec::DTS:    return "A_DTS";
+        case Codec::LPCM:   return "A_PCM/INT/BIG";
+        case Codec::PGS:    return "S_HDMV/PGS";
+        default:            return "";
+    }
+}
+
+// MSB-first bit reader over an RBSP (emulation prevention bytes removed)
+class BitReader {
+public:
+    explicit BitReader(const std::vector<uint8_t>& bytes) : data(bytes) {}
+
+    uint32_t Bits(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++) {
+            size_t byte = position >> 3;
+            uint32_t bit = byte < data.size() ? (data[byte] >> (7 - (position & 7))) & 1 : 0;
+            value = (value << 1) | bit;
+            position++;
+        }
+        return value;
+    }
+
+    void Skip(size_t count) { position += count; }
+
+    uint32_t UE() {
+        int zeros = 0;
+        while (Bits(1) == 0 && zeros < 32) {
+            zeros++;
+        }
+        return zeros == 0 ? 0 : ((1u << zeros) - 1) + Bits(zeros);
+    }
+
+    int32_t SE() {
+        uint32_t value = UE();
+        return (value & 1) ? static_cast<int32_t>((value + 1) / 2) : -static_cast<int32_t>(value / 2);
+    }
+
+private:
+    const std::vector<uint8_t>& data;
+    size_t position = 0;
+};
+
+std::vector<uint8_t> ToRbsp(const uint8_t* nal, size_t size) {
+    std::vector<uint8_t> rbsp;
+    rbsp.reserve(size);
+    int zeros = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (zeros >= 2 && nal[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] == 0 ? zeros + 1 : 0;
+        rbsp.push_back(nal[i]);
+    }
+    return rbsp;
+}
+
+struct NalUnit {
+    const uint8_t* data;
+    size_t size;
+};
+
+// Splits an Annex B byte stream at its start codes
+std::vector<NalUnit> SplitAnnexB(const uint8_t* data, size_t size) {
+    std::vector<NalUnit> units;
+    size_t start = SIZE_MAX;
+    size_t i = 0;
+    while (i + 3 <= size) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            if (start != SIZE_MAX) {
+                size_t end = i;
+                while (end > start && data[end - 1] == 0) {
+                    end--;
+                }
+                units.push_back({data + start, end - start});
+            }
+            i += 3;
+            start = i;
+        } else {
+            i++;
+        }
+    }
+    if (start != SIZE_MAX && start < size) {
+        size_t end = size;
+        while (end > start && data[end - 1] == 0) {
+            end--;
+        }
+        units.push_back({data + start, end - start});
+    }
+    return units;
+}
+
+void AppendU16(std::vector<uint8_t>& out, size_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void AppendLengthPrefixed(std::vector<uint8_t>& out, const NalUnit& nal) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(nal.size >> shift));
+    }
+    out.insert(out.end(), nal.data, nal.data + nal.size);
+}
+
+void SkipH264ScalingList(BitReader& bits, int size) {
+    int last = 8;
+    int next = 8;
+    for (int i = 0; i < size; i++) {
+        if (next != 0) {
+            next = (last + bits.SE() + 256) % 256;
+        }
+        last = next == 0 ? last : next;
+    }
+}
+
+void ParseH264Size(const NalUnit& sps, uint32_t& width, uint32_t& height) {
+    std::vector<uint8_t> rbsp = ToRbsp(sps.data + 1, sps.size - 1);
+    BitReader bits(rbsp);
+
+    uint32_t profile = bits.Bits(8);
+    bits.Skip(16); // constraint flags, level
+    bits.UE();     // seq_parameter_set_id
+
+    uint32_t chromaFormat = 1;
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 244 || profile == 44 ||
+        profile == 83 || profile == 86 || profile == 118 || profile == 128) {
+        chromaFormat = bits.UE();
+        if (chromaFormat == 3) {
+            bits.Skip(1);
+        }
+        bits.UE(); // bit_depth_luma_minus8
+        bits.UE(); // bit_depth_chroma_minus8
+        bits.Skip(1);
+        if (bits.Bits(1)) {
+            for (int i = 0; i < (chromaFormat == 3 ? 12 : 8); i++) {
+                if (bits.Bits(1)) {
+                    SkipH264ScalingList(bits, i < 6 ? 16 : 64);
+                }
+            }
+        }
+    }
+
+    bits.UE(); // log2_max_frame_num_minus4
+    uint32_t pocType = bits.UE();
+    if (pocType == 0) {
+        bits.UE();
+    } else if (pocType == 1) {
+        bits.Skip(1);
+        bits.SE();
+        bits.SE();
+        uint32_t cycle = bits.UE();
+        for (uint32_t i = 0; i < cycle && i < 256; i++) {
+            bits.SE();
+        }
+    }
+    bits.UE();     // max_num_ref_frames
+    bits.Skip(1);  // gaps_in_frame_num_allowed
+
+    uint32_t widthMbs = bits.UE() + 1;
+    uint32_t heightUnits = bits.UE() + 1;
+    uint32_t frameMbsOnly = bits.Bits(1);
+    if (!frameMbsOnly) {
+        bits.Skip(1);
+    }
+    bits.Skip(1); // direct_8x8_inference
+
+    width = widthMbs * 16;
+    height = (2 - frameMbsOnly) * heightUnits * 16;
+    if (bits.Bits(1)) {
+        uint32_t cropUnitX = chromaFormat == 3 ? 1 : 2;
+        uint32_t cropUnitY = (chromaFormat == 1 ? 2 : 1) * (2 - frameMbsOnly);
+        uint32_t left = bits.UE(), right = bits.UE(), top = bits.UE(), bottom = bits.UE();
+        width -= (left + right) * cropUnitX;
+        height -= (top + bottom) * cropUnitY;
+    }
+}
+
+std::vector<uint8_t> BuildAvcC(const NalUnit& sps, const NalUnit& pps) {
+    std::vector<uint8_t> avcC = {1, sps.data[1], sps.data[2], sps.data[3], 0xFF, 0xE1};
+    AppendU16(avcC, sps.size);
+    avcC.insert(avcC.end(), sps.data, sps.data + sps.size);
+    avcC.push_back(1);
+    AppendU16(avcC, pps.size);
+    avcC.insert(avcC.end(), pps.data, pps.data + pps.size);
+    return avcC;
+}
+
+std::vector<uint8_t> BuildHvcC(const NalUnit& vps, const NalUnit& sps, const NalUnit& pps,
+                               uint32_t& width, uint32_t& height) {
+    std::vector<uint8_t> rbsp = ToRbsp(sps.data + 2, sps.size - 2);
+    BitReader bits(rbsp);
+
+    bits.Skip(4); // sps_video_parameter_set_id
+    uint32_t maxSubLayersMinus1 = bits.Bits(3);
+    uint32_t temporalIdNested = bits.Bits(1);
+
+    // general_profile_tier_level is byte aligned here and copied verbatim
+    uint8_t profileTierLevel[12];
+    for (uint8_t& byte : profileTierLevel) {
+        byte = static_cast<uint8_t>(bits.Bits(8));
+    }
+
+    std::vector<bool> profilePresent(maxSubLayersMinus1), levelPresent(maxSubLayersMinus1);
+    for (uint32_t i = 0; i < maxSubLayersMinus1; i++) {
+        profilePresent[i] = bits.Bits(1) != 0;
+        levelPresent[i] = bits.Bits(1) != 0;
+    }
+    if (maxSubLayersMinus1 > 0) {
+        bits.Skip(2 * (8 - maxSubLayersMinus1));
+    }
+    for (uint32_t i = 0; i < maxSubLayersMinus1; i++) {
+        bits.Skip((profilePresent[i] ? 88 : 0) + (levelPresent[i] ? 8 : 0));
+    }
+
+    bits.UE(); // sps_seq_parameter_set_id
+    uint32_t chromaFormat = bits.UE();
+    if (chromaFormat == 3) {
+        bits.Skip(1);
+    }
+    width = bits.UE();
+    height = bits.UE();
+    if (bits.Bits(1)) {
+        uint32_t subWidth = (chromaFormat == 1 || chromaFormat == 2) ? 2 : 1;
+        uint32_t subHeight = chromaFormat == 1 ? 2 : 1;
+        uint32_t left = bits.UE(), right = bits.UE(), top = bits.UE(), bottom = bits.UE();
+        width -= (left + right) * subWidth;
+        height -= (top + bottom) * subHeight;
+    }
+    uint32_t bitDepthLuma = bits.UE();
+    uint32_t bitDepthChroma = bits.UE();
+
+    std::vector<uint8_t> hvcC;
+    hvcC.reserve(23 + 3 * 5 + vps.size + sps.size + pps.size);
+    hvcC.push_back(1); // configurationVersion
+    hvcC.insert(hvcC.end(), profileTierLevel, profileTierLevel + 12);
+    hvcC.push_back(0xF0); // min_spatial_segmentation_idc = 0
+    hvcC.push_back(0x00);
+    hvcC.push_back(0xFC); // parallelismType = 0
+    hvcC.push_back(static_cast<uint8_t>(0xFC | (chromaFormat & 3)));
+    hvcC.push_back(static_cast<uint8_t>(0xF8 | (bitDepthLuma & 7)));
+    hvcC.push_back(static_cast<uint8_t>(0xF8 | (bitDepthChroma & 7)));
+    AppendU16(hvcC, 0); // avgFrameRate
+    hvcC.push_back(static_cast<uint8_t>(((maxSubLayersMinus1 + 1) << 3) | (temporalIdNested << 2) | 3));
+
+    hvcC.push_back(3);
+    for (const NalUnit* nal : {&vps, &sps, &pps}) {
+        hvcC.push_back(static_cast<uint8_t>(0x80 | ((nal->data[0] >> 1) & 0x3F)));
+        AppendU16(hvcC, 1);
+        AppendU16(hvcC, nal->size);
+        hvcC.insert(hvcC.end(), nal->data, nal->data + nal->size);
+    }
+    return hvcC;
+}
+
+struct AudioFormat {
+    double sampleRate = 0;
+    uint32_t channels = 0;
+};
+
+const uint32_t ac3Channels[8] = {2, 1, 2, 3, 3, 4, 4, 5};
+
+bool ParseAC3Header(const uint8_t* data, size_t size, AudioFormat& format) {
+    if (size < 8 || data[0] != 0x0B || data[1] != 0x77) {
+        return false;
+    }
+
+    uint32_t bsid = data[5] >> 3;
+    if (bsid <= 10) {
+        static const double rates[3] = {48000, 44100, 32000};
+        uint32_t fscod = data[4] >> 6;
+        if (fscod == 3) {
+            return false;
+        }
+        std::vector<uint8_t> bytes(data + 6, data + 8);
+        BitReader bits(bytes);
+        uint32_t acmod = bits.Bits(3);
+        if ((acmod & 1) && acmod != 1) bits.Skip(2); // cmixlev
+        if (acmod & 4) bits.Skip(2);                 // surmixlev
+        if (acmod == 2) bits.Skip(2);                // dsurmod
+        format.sampleRate = rates[fscod];
+        format.channels = ac3Channels[acmod] + bits.Bits(1);
+        return true;
+    }
+
+    // E-AC-3 independent substream
+    static const double rates[3] = {48000, 44100, 32000};
+    static const double reducedRates[3] = {24000, 22050, 16000};
+    uint32_t fscod = data[4] >> 6;
+    uint32_t fscod2 = (data[4] >> 4) & 3;
+    if (fscod == 3 && fscod2 == 3) {
+        return false;
+    }
+    format.sampleRate = fscod == 3 ? reducedRates[fscod2] : rates[fscod];
+    format.channels = ac3Channels[(data[4] >> 1) & 7] + (data[4] & 1);
+    return true;
+}
+
+bool ParseDTSHeader(const uint8_t* data, size_t size, AudioFormat& format) {
+    if (size < 12 || data[0] != 0x7F || data[1] != 0xFE || data[2] != 0x80 || data[3] != 0x01) {
+        return false;
+    }
+
+    static const uint32_t channels[16] = {1, 2, 2, 2, 2, 3, 3, 4, 4, 5, 6, 6, 6, 7, 8, 8};
+    static const double rates[16] = {0, 8000, 16000, 32000, 0, 0, 11025, 22050,
+                                     44100, 0, 0, 12000, 24000, 48000, 0, 0};
+    std::vector<uint8_t> bytes(data + 4, data + 12);
+    BitReader bits(bytes);
+    bits.Skip(1 + 5 + 1 + 7 + 14); // FTYPE, SHORT, CPF, NBLKS, FSIZE
+    uint32_t amode = bits.Bits(6);
+    uint32_t sfreq = bits.Bits(4);
+    bits.Skip(5 + 1 + 1 + 1 + 1 + 1 + 3 + 1 + 1); // RATE .. ASPF
+    uint32_t lfe = bits.Bits(2) != 0 ? 1 : 0;
+
+    format.sampleRate = rates[sfreq];
+    format.channels = (amode < 16 ? channels[amode] : 2) + lfe;
+    return format.sampleRate > 0;
+}
+
+struct LPCMFormat {
+    uint32_t channels = 0;     // Coded channels, without the padding channel
+    uint32_t bitsPerSample = 0;
+    double sampleRate = 0;
+};
+
+bool ParseLPCMHeader(const uint8_t* data, size_t size, LPCMFormat& format) {
+    if (size < 4) {
+        return false;
+    }
+    static const uint32_t channels[16] = {0, 1, 0, 2, 3, 3, 4, 4, 5, 6, 7, 8, 0, 0, 0, 0};
+    static const uint32_t bitDepths[4] = {0, 16, 20, 24};
+
+    format.channels = channels[data[2] >> 4];
+    format.bitsPerSample = bitDepths[data[3] >> 6];
+    switch (data[2] & 0x0F) {
+        case 1: format.sampleRate = 48000; break;
+        case 4: format.sampleRate = 96000; break;
+        case 5: format.sampleRate = 192000; break;
+        default: format.sampleRate = 0; break;
+    }
+    return format.channels > 0 && format.bitsPerSample > 0 && format.sampleRate > 0;
+}
+
+uint32_t GetChannelCount(const std::string& layout) {
+    if (layout == "mono") return 1;
+    if (layout == "stereo") return 2;
+    return 6;
+}
+
+struct TrackState {
+    StreamInfo stream;
+    Codec codec = Codec::Unsupported;
+    MkvTrack track;
+    bool configured = false;
+    uint64_t lastTimestampNs = 0;
+    LPCMFormat lpcm;
+};
+
+struct PendingFrame {
+    size_t track;
+    uint64_t timestampNs;
+    bool keyframe;
+    std::vector<uint8_t> data;
+};
+
+// Holds frames until every track's codec configuration is known, then
+// writes the header and streams everything else straight to the writer
+class RemuxSession {
+public:
+    static constexpr size_t PendingLimit = 64 * 1024 * 1024;
+    static constexpr std::chrono::milliseconds ProgressInterval{250};
+
+    RemuxSession(std::vector<TrackState> trackStates, const fs::path& outputPath,
+                 const OutputWriter::Options& outputOptions, double expectedDuration, ProgressCallback onProgress)
+        : tracks(std::move(trackStates)), output(outputPath), outputOptions(outputOptions), trackByPid(8192, SIZE_MAX),
+          expectedDuration(expectedDuration), onProgress(std::move(onProgress)),
+          started(std::chrono::steady_clock::now()), lastReport(started) {
+        for (size_t i = 0; i < tracks.size(); i++) {
+            trackByPid[tracks[i].stream.pid & 0x1FFF] = i;
+        }
+    }
+
+    std::vector<uint16_t> Pids() const {
+        std::vector<uint16_t> pids;
+        for (const auto& state : tracks) {
+            pids.push_back(state.stream.pid);
+        }
+        return pids;
+    }
+
+    // Maps the 45kHz [inTime, outTime) window of a play item onto the output
+    void BeginPlayItem(const PlayItem& item) {
+        inPts = static_cast<uint64_t>(item.inTime) * 2;
+        windowPts = static_cast<uint64_t>(item.outTime - item.inTime) * 2;
+    }
+
+    void EndPlayItem() {
+        itemOffsetNs += windowPts * 100000 / 9;
+    }
+
+    void OnPES(const PESPacket& pes) {
+        size_t index = trackByPid[pes.pid & 0x1FFF];
+        if (failed || index == SIZE_MAX || pes.size == 0) {
+            return;
+        }
+        TrackState& state = tracks[index];
+
+        uint64_t timestampNs = state.lastTimestampNs;
+        if (pes.header.hasPts) {
+            // Distance from the IN point, modulo the 33-bit PTS wrap
+            uint64_t delta = (pes.header.pts - inPts) & ((1ull << 33) - 1);
+            if (delta >= windowPts) {
+                return; // Before IN (wrapped negative) or at/after OUT
+            }
+            timestampNs = itemOffsetNs + delta * 100000 / 9;
+        }
+        state.lastTimestampNs = timestampNs;
+
+        std::vector<uint8_t> frame;
+        bool keyframe = true;
+        if (!Convert(state, pes.data, pes.size, frame, keyframe)) {
+            return;
+        }
+        if (!failed) {
+            Write(index, timestampNs, keyframe, std::move(frame));
+        }
+
+        outTimeNs = std::max(outTimeNs, timestampNs);
+        if (onProgress && ++packetsSinceCheck >= 256) {
+            packetsSinceCheck = 0;
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastReport >= ProgressInterval) {
+                lastReport = now;
+                ReportProgress(false);
+            }
+        }
+    }
+
+    bool Finish(const std::vector<MkvChapter>& chapters, std::string& error) {
+        if (!failed && !headerWritten) {
+            WriteHeader();
+        }
+        if (failed) {
+            error = this->error;
+            writer.Abort();
+            return false;
+        }
+        writer.SetChapters(chapters);
+        if (!writer.Close()) {
+            writer.Abort();
+            error = "failed to finalize " + output.string();
+            return false;
+        }
+        if (onProgress) {
+            ReportProgress(true);
+        }
+        return true;
+    }
+
+    void Abort() {
+        writer.Abort();
+    }
+
+    void Fail(const std::string& message) {
+        if (!failed) {
+            failed = true;
+            error = message;
+        }
+    }
+
+    bool Failed() const { return failed; }
+
+private:
+    void ReportProgress(bool finished) {
+        RemuxProgress progress;
+        progress.bytesWritten = writer.BytesWritten();
+        progress.outTimeSeconds = outTimeNs / 1e9;
+        progress.finished = finished;
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        if (elapsed > 0) {
+            progress.speed = progress.outTimeSeconds / elapsed;
+        }
+        if (expectedDuration > 0) {
+            progress.fraction = finished ? 1.0 : std::min(progress.outTimeSeconds / expectedDuration, 1.0);
+            if (progress.speed > 0) {
+                progress.etaSeconds = finished ? 0 : (expectedDuration - progress.outTimeSeconds) / progress.speed;
+            }
+        }
+        onProgress(progress);
+    }
+
+    bool Convert(TrackState& state, const uint8_t* data, size_t size,
+                 std::vector<uint8_t>& frame, bool& keyframe) {
+        switch (state.codec) {
+            case Codec::H264:
+            case Codec::Hevc:
+                return ConvertNalStream(state, data, size, frame, keyframe);
+
+            case Codec::Mpeg2:
+                return ConvertMpeg2(state, data, size, frame, keyframe);
+
+            case Codec::TrueHD:
+                // The PID interleaves an AC-3 core for legacy players; keep only the MLP frames
+                if (size >= 2 && data[0] == 0x0B && data[1] == 0x77) {
+                    return false;
+                }
+                state.configured = true;
+                frame.assign(data, data + size);
+                return true;
+
+            case Codec::AC3:
+            case Codec::EAC3:
+            case Codec::DTS: {
+                if (!state.configured) {
+                    AudioFormat format;
+                    bool parsed = state.codec == Codec::DTS ? ParseDTSHeader(data, size, format)
+                                                            : ParseAC3Header(data, size, format);
+                    if (parsed) {
+                        state.track.sampleRate = state.stream.sampleRate > 0 ? state.stream.sampleRate : format.sampleRate;
+                        state.track.channels = format.channels;
+                        state.configured = true;
+                    }
+                }
+                frame.assign(data, data + size);
+                return true;
+            }
+
+            case Codec::LPCM:
+                return ConvertLPCM(state, data, size, frame);
+
+            case Codec::PGS:
+                frame.assign(data, data + size);
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    bool ConvertNalStream(TrackState& state, const uint8_t* data, size_t size,
+                          std::vector<uint8_t>& frame, bool& keyframe) {
+        bool hevc = state.codec == Codec::Hevc;
+        std::vector<NalUnit> units = SplitAnnexB(data, size);
+        const NalUnit* vps = nullptr;
+        const NalUnit* sps = nullptr;
+        const NalUnit* pps = nullptr;
+
+        keyframe = false;
+        frame.reserve(size + 4 * units.size());
+        for (const auto& nal : units) {
+            if (nal.size < (hevc ? 3u : 2u)) {
+                continue;
+            }
+            int type = hevc ? (nal.data[0] >> 1) & 0x3F : nal.data[0] & 0x1F;
+            if (hevc) {
+                if (type == 35) continue; // access unit delimiter
+                if (type == 32) vps = &nal;
+                if (type == 33) sps = &nal;
+                if (type == 34) pps = &nal;
+                keyframe |= type >= 16 && type <= 21;
+            } else {
+                if (type == 9) continue;
+                if (type == 7) sps = &nal;
+                if (type == 8) pps = &nal;
+                // Blu-ray GOPs open with an I picture that repeats the SPS, not always an IDR
+                keyframe |= type == 5 || type == 7;
+            }
+            AppendLengthPrefixed(frame, nal);
+        }
+
+        if (!state.configured && sps && pps && sps->size > 4) {
+            if (hevc) {
+                if (vps) {
+                    state.track.codecPrivate = BuildHvcC(*vps, *sps, *pps, state.track.width, state.track.height);
+                    state.configured = true;
+                }
+            } else {
+                state.track.codecPrivate = BuildAvcC(*sps, *pps);
+                ParseH264Size(*sps, state.track.width, state.track.height);
+                state.configured = true;
+            }
+        }
+
+        // Nothing decodable precedes the first keyframe
+        return !frame.empty() && (state.configured || keyframe);
+    }
+
+    bool ConvertMpeg2(TrackState& state, const uint8_t* data, size_t size,
+                      std::vector<uint8_t>& frame, bool& keyframe) {
+        keyframe = false;
+        for (size_t i = 0; i + 6 <= size; i++) {
+            if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) {
+                continue;
+            }
+            if (data[i + 3] == 0xB3 && !state.configured && i + 8 <= size) {
+                state.track.width = (data[i + 4] << 4) | (data[i + 5] >> 4);
+                state.track.height = ((data[i + 5] & 0x0F) << 8) | data[i + 6];
+
+                // Sequence header plus its extension, up to the next other start code
+                size_t end = i + 4;
+                while (end + 4 <= size) {
+                    if (data[end] == 0 && data[end + 1] == 0 && data[end + 2] == 1 && data[end + 3] != 0xB5) {
+                        break;
+                    }
+                    end++;
+                }
+                state.track.codecPrivate.assign(data + i, data + std::min(end, size));
+                state.configured = true;
+            } else if (data[i + 3] == 0x00) {
+                keyframe = ((data[i + 5] >> 3) & 7) == 1;
+                break;
+            }
+        }
+
+        frame.assign(data, data + size);
+        return state.configured;
+    }
+
+    bool ConvertLPCM(TrackState& state, const uint8_t* data, size_t size, std::vector<uint8_t>& frame) {
+        LPCMFormat format;
+        if (!ParseLPCMHeader(data, size, format)) {
+            return false;
+        }
+        if (!state.configured) {
+            state.lpcm = format;
+            state.track.sampleRate = format.sampleRate;
+            state.track.channels = format.channels;
+            state.track.bitDepth = format.bitsPerSample == 16 ? 16 : 24;
+            state.configured = true;
+        }
+
+        // Samples are big-endian and stored for an even channel count; drop the padding channel
+        size_t sampleBytes = format.bitsPerSample == 16 ? 2 : 3;
+        size_t codedChannels = (format.channels + 1) & ~1u;
+        size_t frameBytes = sampleBytes * codedChannels;
+        const uint8_t* samples = data + 4;
+        size_t sampleFrames = (size - 4) / frameBytes;
+
+        if (codedChannels == format.channels) {
+            frame.assign(samples, samples + sampleFrames * frameBytes);
+        } else {
+            size_t keepBytes = sampleBytes * format.channels;
+            frame.resize(sampleFrames * keepBytes);
+            for (size_t i = 0; i < sampleFrames; i++) {
+                std::copy(samples + i * frameBytes, samples + i * frameBytes + keepBytes,
+                          frame.begin() + i * keepBytes);
+            }
+        }
+        return !frame.empty();
+    }
+
+    void Write(size_t index, uint64_t timestampNs, bool keyframe, std::vector<uint8_t> frame) {
+        if (headerWritten) {
+            if (!writer.WriteFrame(index + 1, timestampNs, keyframe, frame.data(), frame.size())) {
+                Fail("write failed on " + output.string());
+            }
+            return;
+        }
+
+        pendingBytes += frame.size();
+        pending.push_back({index, timestampNs, keyframe, std::move(frame)});
+
+        bool allConfigured = std::all_of(tracks.begin(), tracks.end(),
+            [](const TrackState& state) { return state.configured; });
+        if (allConfigured || pendingBytes >= PendingLimit) {
+            WriteHeader();
+        }
+    }
+
+    void WriteHeader() {
+        std::vector<MkvTrack> mkvTracks;
+        for (auto& state : tracks) {
+            if (!state.configured && state.track.type == MkvTrackType::Video) {
+                Fail("no decodable video found for PID 0x" + ToHex(state.stream.pid));
+                return;
+            }
+            mkvTracks.push_back(state.track);
+        }
+
+        headerWritten = true;
+        if (!writer.Open(output, mkvTracks, outputOptions)) {
+            Fail("cannot create " + output.string());
+            return;
+        }
+
+        for (auto& frame : pending) {
+            if (!writer.WriteFrame(frame.track + 1, frame.timestampNs, frame.keyframe,
+                                   frame.data.data(), frame.data.size())) {
+                Fail("write failed on " + output.string());
+                return;
+            }
+        }
+        pending.clear();
+        pending.shrink_to_fit();
+    }
+
+    static std::string ToHex(uint16_t value) {
+        char text[8];
+        std::snprintf(text, sizeof(text), "%04X", value);
+        return text;
+    }
+
+    std::vector<TrackState> tracks;
+    fs::path output;
+    OutputWriter::Options outputOptions;
+    std::vector<size_t> trackByPid;
+    MatroskaWriter writer;
+
+    std::vector<PendingFrame> pending;
+    size_t pendingBytes = 0;
+    bool headerWritten = false;
+
+    uint64_t inPts = 0;
+    uint64_t windowPts = 0;
+    uint64_t itemOffsetNs = 0;
+
+    double expectedDuration;
+    ProgressCallback onProgress;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point lastReport;
+    uint64_t outTimeNs = 0;
+    size_t packetsSinceCheck = 0;
+
+    bool failed = false;
+    std::string error;
+};
+
+const StreamInfo* FindStream(const BDMVTitle& title, uint16_t pid) {
+    for (const auto& stream : title.streams) {
+        if (stream.pid == pid && stream.subPathId == -1) {
+            return &stream;
+        }
+    }
+    return nullptr;
+}
+
+// The selected streams in output order: video, audio, subtitles
+std::vector<std::pair<const StreamInfo*, LanguageId>> SelectStreams(
+    const BDMVTitle& title, const FFmpegWrapper::StreamOptions& options) {
+    std::vector<std::pair<const StreamInfo*, LanguageId>> selected;
+    if (const StreamInfo* video = FindStream(title, options.videoPid)) {
+        selected.emplace_back(video, video->language);
+    }
+    for (const auto* list : {&options.audioStreams, &options.subtitleStreams}) {
+        for (const auto& mapped : *list) {
+            if (const StreamInfo* stream = FindStream(title, mapped.pid)) {
+                selected.emplace_back(stream, mapped.language);
+            }
+        }
+    }
+    return selected;
+}
+
+} // namespace
+
+bool NativeRemuxer::SupportsStreams(const BDMVTitle& title,
+                                    const FFmpegWrapper::StreamOptions& options,
+                                    std::string& reason) {
+    if (!options.copyStreams) {
+        reason = "only stream copy is supported";
+        return false;
+    }
+    if (options.videoPid == 0 || !FindStream(title, options.videoPid)) {
+        reason = "no video stream PID for this title";
+        return false;
+    }
+    if (title.playItems.empty()) {
+        reason = "playlist has no play items";
+        return false;
+    }
+
+    for (const auto& entry : SelectStreams(title, options)) {
+        if (GetCodec(entry.first->codingType) == Codec::Unsupported) {
+            reason = entry.first->codec + " is not supported";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NativeRemuxer::RemuxTitle(const fs::path& bdmvPath,
+                               const BDMVTitle& title,
+                               const std::string& outputMKV,
+                               const FFmpegWrapper::StreamOptions& options,
+                               std::string& error) {
+    if (!SupportsStreams(title, options, error)) {
+        return false;
+    }
+
+    fs::path streamDir = bdmvPath;
+    if (streamDir.filename() != "BDMV") {
+        streamDir /= "BDMV";
+    }
+    streamDir /= "STREAM";
+
+    // A time range plays a cut copy of the title that starts on an entry point
+    BDMVTitle playback = title;
+    double startTime = options.startTime;
+    if (options.HasRange() && !BDMVParser::TrimTitle(playback, streamDir, startTime, options.endTime)) {
+        error = "the time range is outside the title";
+        return false;
+    }
+
+    std::vector<TrackState> tracks;
+    bool hasDefaultAudio = false;
+    for (const auto& entry : SelectStreams(title, options)) {
+        TrackState state;
+        state.stream = *entry.first;
+        state.codec = GetCodec(state.stream.codingType);
+        state.track.codecId = GetCodecId(state.codec);
+        state.track.language = entry.second.Code();
+
+        if (state.stream.kind == StreamKind::Video) {
+            state.track.type = MkvTrackType::Video;
+            state.track.isDefault = true;
+        } else if (state.stream.kind == StreamKind::Audio) {
+            state.track.type = MkvTrackType::Audio;
+            state.track.isDefault = !hasDefaultAudio;
+            state.track.sampleRate = state.stream.sampleRate;
+            state.track.channels = GetChannelCount(state.stream.channelLayout);
+            hasDefaultAudio = true;
+        } else {
+            state.track.type = MkvTrackType::Subtitle;
+            state.configured = true;
+        }
+        tracks.push_back(std::move(state));
+    }
+
+    // The title's size covers every stream, so it bounds the output; the
+    // unused part of the preallocation is trimmed when the file is finished
+    OutputWriter::Options outputOptions;
+    outputOptions.expectedSize = options.expectedSize;
+    outputOptions.unbuffered = options.unbufferedOutput;
+
+    RemuxSession session(std::move(tracks), outputMKV, outputOptions, options.expectedDuration, options.onProgress);
+    std::vector<uint16_t> pids = session.Pids();
+
+    // Checked per PES: an atomic load, so a cancel lands within one packet
+    auto isCancelled = [&options]() { return options.cancel && options.cancel->IsCancelled(); };
+
+    // The whole clip chain is known up front, so the next clip is read
+    // ahead while the current one is still being demuxed. Only the chosen
+    // angle's clips are in it, each limited to its play item's EP_map range;
+    // the other angles and the unplayed parts of clips are never read.
+    std::vector<ClipSpan> clips;
+    for (const auto& clip : playback.GetClips(options.angle)) {
+        ClipSpan span;
+        span.path = streamDir / (clip.clipName + ".m2ts");
+        if (clip.byteLength != 0) {
+            span.offset = clip.byteOffset;
+            span.length = clip.byteLength;
+        }
+        clips.push_back(span);
+    }
+    ClipPrefetcher prefetcher(clips);
+
+    for (size_t i = 0; i < playback.playItems.size(); i++) {
+        const PlayItem& item = playback.playItems[i];
+        if (isCancelled() || session.Failed()) {
+            break;
+        }
+
+        M2TSReader reader;
+        if (!reader.Open(prefetcher, i)) {
+            session.Abort();
+            error = "cannot open " + clips[i].path.string();
+            return false;
+        }
+
+        TSDemuxer demuxer([&](const PESPacket& pes) {
+            if (isCancelled()) {
+                demuxer.Stop();
+                return;
+            }
+            session.OnPES(pes);
+        });
+        demuxer.SelectPids(pids);
+
+        session.BeginPlayItem(item);
+        TSDemuxer::Demux(reader, demuxer);
+        session.EndPlayItem();
+        if (prefetcher.Failed()) {
+            session.Fail("read error in " + clips[i].path.string());
+        }
+    }
+
+    // Finish() removes the partial file when the session failed
+    if (isCancelled()) {
+        session.Fail("cancelled");
+    }
+    std::vector<MkvChapter> chapters;
+    for (size_t i = 0; i < options.chapters.size(); i++) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "Chapter %02zu", i + 1);
+        chapters.push_back({static_cast<uint64_t>(options.chapters[i] * 1e9), name});
+    }
+    return session.Finish(chapters, error);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <filesystem>
+#include "bdmv_parser.h"
+#include "ffmpeg_wrapper.h"
+
+namespace fs = std::filesystem;
+
+// In-process alternative to FFmpegWrapper::RemuxBDMV. Demuxes the playlist's
+// clips with TSDemuxer and repackages the PES payloads as Matroska frames, so
+// there is no probe phase and no child process. Stream copy only.
+class NativeRemuxer {
+public:
+    // Fails with a reason if any selected stream uses a codec we cannot write
+    static bool SupportsStreams(const BDMVTitle& title,
+                                const FFmpegWrapper::StreamOptions& options,
+                                std::string& reason);
+
+    static bool RemuxTitle(const fs::path& bdmvPath,
+                           const BDMVTitle& title,
+                           const std::string& outputMKV,
+                           const FFmpegWrapper::StreamOptions& options,
+                           std::string& error);
+};
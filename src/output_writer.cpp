@@ -0,0 +1,328 @@
+#include "output_writer.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+OutputWriter::~OutputWriter() {
+    if (isOpen) {
+        Abort();
+    }
+}
+
+bool OutputWriter::Open(const fs::path& path, const Options& options) {
+    if (isOpen) {
+        return false;
+    }
+
+    filePath = path;
+    blockSize = std::max<size_t>(options.blockSize, Alignment);
+    blockSize = (blockSize + Alignment - 1) / Alignment * Alignment;
+
+    direct = options.unbuffered;
+    if (!OpenFile(direct, true)) {
+        // Not every filesystem takes unbuffered writes (tmpfs, some network shares)
+        if (!direct || !OpenFile(false, true)) {
+            return false;
+        }
+        direct = false;
+    }
+    if (options.expectedSize > 0) {
+        Preallocate(options.expectedSize);
+    }
+
+    size_t count = std::max<size_t>(options.blockCount, 2);
+    for (size_t i = 0; i < count; i++) {
+        allBlocks.push_back(static_cast<uint8_t*>(::operator new(blockSize, std::align_val_t(Alignment))));
+    }
+    freeBlocks.assign(allBlocks.begin() + 1, allBlocks.end());
+    current = {allBlocks[0], 0, 0};
+
+    isOpen = true;
+    finished = false;
+    stopping = false;
+    failed = false;
+    position = 0;
+    flusher = std::thread(&OutputWriter::FlushLoop, this);
+    return true;
+}
+
+bool OutputWriter::Write(const void* data, size_t size) {
+    if (!isOpen || finished || failed) {
+        return false;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        size_t count = std::min(blockSize - current.used, size);
+        std::memcpy(current.data + current.used, bytes, count);
+        current.used += count;
+        position += count;
+        bytes += count;
+        size -= count;
+
+        if (current.used == blockSize && !Submit()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OutputWriter::Submit() {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t nextOffset = current.offset + current.used;
+    pending.push_back(current);
+    changed.notify_all();
+
+    // The only place the muxer waits on the disk
+    changed.wait(lock, [this]() { return !freeBlocks.empty() || failed; });
+    if (failed) {
+        current = {};
+        return false;
+    }
+    current = {freeBlocks.back(), 0, nextOffset};
+    freeBlocks.pop_back();
+    return true;
+}
+
+void OutputWriter::FlushLoop() {
+    while (true) {
+        Block block;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            block = pending.front();
+            pending.pop_front();
+        }
+
+        // Unbuffered writes must cover whole alignment units; the tail is
+        // padded here and cut off again by Truncate
+        size_t size = block.used;
+        if (direct) {
+            size = (size + Alignment - 1) / Alignment * Alignment;
+            std::memset(block.data + block.used, 0, size - block.used);
+        }
+        bool ok = failed || WriteFileAt(block.offset, block.data, size);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ok) {
+            failed = true;
+        }
+        freeBlocks.push_back(block.data);
+        changed.notify_all();
+    }
+}
+
+void OutputWriter::StopFlusher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+}
+
+bool OutputWriter::Finish() {
+    if (!isOpen) {
+        return false;
+    }
+    if (finished) {
+        return !failed;
+    }
+    finished = true;
+
+    if (current.data && current.used > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(current);
+    }
+    current = {};
+    StopFlusher();
+
+    // Drops the preallocated remainder and any padding of the last block
+    if (!failed && !Truncate(position)) {
+        failed = true;
+    }
+
+    // Patches are small and unaligned, so they go through the cache
+    if (direct) {
+        CloseFile();
+        if (!OpenFile(false, false)) {
+            failed = true;
+        }
+        direct = false;
+    }
+    return !failed;
+}
+
+bool OutputWriter::Patch(uint64_t offset, const void* data, size_t size) {
+    if (!isOpen || !finished || failed || offset + size > position) {
+        return false;
+    }
+    if (!WriteFileAt(offset, data, size)) {
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool OutputWriter::Close() {
+    if (!isOpen) {
+        return false;
+    }
+    bool ok = Finish();
+    CloseFile();
+    FreeBlocks();
+    isOpen = false;
+    return ok && !failed;
+}
+
+void OutputWriter::Abort() {
+    if (!isOpen) {
+        return;
+    }
+    failed = true; // Queued blocks are dropped, not written
+    StopFlusher();
+    CloseFile();
+    FreeBlocks();
+    isOpen = false;
+}
+
+void OutputWriter::FreeBlocks() {
+    for (uint8_t* block : allBlocks) {
+        ::operator delete(block, std::align_val_t(Alignment));
+    }
+    allBlocks.clear();
+    freeBlocks.clear();
+    pending.clear();
+    current = {};
+}
+
+#ifdef _WIN32
+
+bool OutputWriter::OpenFile(bool unbuffered, bool create) {
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | (unbuffered ? FILE_FLAG_NO_BUFFERING : 0);
+    HANDLE file = CreateFileW(filePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              create ? CREATE_ALWAYS : OPEN_EXISTING, flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    handle = file;
+    return true;
+}
+
+bool OutputWriter::WriteFileAt(uint64_t offset, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD written = 0;
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        if (!WriteFile(handle, bytes, chunk, &written, &overlapped) || written == 0) {
+            return false;
+        }
+        bytes += written;
+        offset += written;
+        size -= written;
+    }
+    return true;
+}
+
+void OutputWriter::Preallocate(uint64_t size) {
+    // Reserves clusters without moving end-of-file; best effort
+    FILE_ALLOCATION_INFO info = {};
+    info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+    SetFileInformationByHandle(handle, FileAllocationInfo, &info, sizeof(info));
+}
+
+bool OutputWriter::Truncate(uint64_t size) {
+    FILE_END_OF_FILE_INFO info = {};
+    info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+    return SetFileInformationByHandle(handle, FileEndOfFileInfo, &info, sizeof(info)) != 0;
+}
+
+void OutputWriter::CloseFile() {
+    if (handle) {
+        CloseHandle(handle);
+        handle = nullptr;
+    }
+}
+
+#else
+
+bool OutputWriter::OpenFile(bool unbuffered, bool create) {
+    int flags = O_WRONLY | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : 0);
+    if (unbuffered) {
+#if defined(O_DIRECT)
+        flags |= O_DIRECT;
+#elif !defined(F_NOCACHE)
+        return false;
+#endif
+    }
+
+    int file = open(filePath.c_str(), flags, 0644);
+    if (file < 0) {
+        return false;
+    }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    if (unbuffered) {
+        fcntl(file, F_NOCACHE, 1);
+    }
+#endif
+    fd = file;
+    return true;
+}
+
+bool OutputWriter::WriteFileAt(uint64_t offset, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        offset += static_cast<uint64_t>(written);
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void OutputWriter::Preallocate(uint64_t size) {
+#ifdef __linux__
+    // Extents are reserved up front without moving end-of-file, as on
+    // Windows, so an interrupted mux is not padded with zeros. Best effort,
+    // and never emulated by writing zeros the way posix_fallocate does on
+    // filesystems without support.
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+#else
+    (void)size;
+#endif
+}
+
+bool OutputWriter::Truncate(uint64_t size) {
+    return ftruncate(fd, static_cast<off_t>(size)) == 0;
+}
+
+void OutputWriter::CloseFile() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+#endif
@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Sequential output file with a dedicated flush thread. Writes are copied
+// into one of a few large aligned blocks; full blocks go to the disk in the
+// background, so the muxer only waits when every block is still in flight.
+// The file can be preallocated from the expected size (less fragmentation
+// on multi-GB outputs) and written unbuffered (O_DIRECT / FILE_FLAG_NO_BUFFERING),
+// which keeps a batch of remuxes from flooding the page cache.
+class OutputWriter {
+public:
+    static constexpr size_t Alignment = 4096; // Satisfies unbuffered I/O on 512e and 4Kn disks
+    static constexpr size_t DefaultBlockSize = 8 * 1024 * 1024;
+
+    struct Options {
+        size_t blockSize = DefaultBlockSize; // Rounded up to Alignment
+        size_t blockCount = 3;               // 2 = double buffering, 3 = triple
+        uint64_t expectedSize = 0;           // Preallocated when non-zero; the file is trimmed on Finish
+        bool unbuffered = false;             // Falls back to buffered writes where unsupported
+    };
+
+    OutputWriter() = default;
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    // Creates or truncates the file
+    bool Open(const fs::path& path, const Options& options);
+    bool IsOpen() const { return isOpen; }
+
+    // Appends; false once any write has failed
+    bool Write(const void* data, size_t size);
+
+    // Writes everything out and trims the file to Position(). After this
+    // only Patch and Close are allowed.
+    bool Finish();
+
+    // Overwrites bytes that were already written, e.g. a header's size field
+    bool Patch(uint64_t offset, const void* data, size_t size);
+
+    // Finishes if needed and closes; false if any write failed
+    bool Close();
+
+    // Stops without finishing; the caller deletes the file
+    void Abort();
+
+    uint64_t Position() const { return position; }
+
+private:
+    struct Block {
+        uint8_t* data = nullptr;
+        size_t used = 0;
+        uint64_t offset = 0;
+    };
+
+    bool Submit();
+    void FlushLoop();
+    void StopFlusher();
+    void FreeBlocks();
+
+    // Platform file operations, in output_writer.cpp
+    bool OpenFile(bool unbuffered, bool create);
+    bool WriteFileAt(uint64_t offset, const void* data, size_t size);
+    void Preallocate(uint64_t size);
+    bool Truncate(uint64_t size);
+    void CloseFile();
+
+    fs::path filePath;
+    bool isOpen = false;
+    bool finished = false;
+    bool direct = false; // Unbuffered writes are actually in effect
+    size_t blockSize = 0;
+    uint64_t position = 0;
+
+    Block current;
+    std::vector<uint8_t*> allBlocks;
+
+    std::thread flusher;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Block> pending;       // Full blocks, oldest first
+    std::vector<uint8_t*> freeBlocks;
+    bool stopping = false;
+    std::atomic<bool> failed{false};
+
+#ifdef _WIN32
+    void* handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
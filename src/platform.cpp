@@ -0,0 +1,202 @@
+#include "platform.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void DebugLog(const std::string& message) {
+#ifdef _WIN32
+    OutputDebugStringA((message + "\n").c_str());
+#else
+    // Like OutputDebugString, silent unless someone is listening
+    static const bool enabled = std::getenv("MULTIREMUX_DEBUG") != nullptr;
+    if (enabled) {
+        std::fprintf(stderr, "%s\n", message.c_str());
+    }
+#endif
+}
+
+#ifdef _WIN32
+
+bool DurableRename(const std::filesystem::path& from, const std::filesystem::path& to, std::error_code& ec) {
+    ec.clear();
+    HANDLE file = CreateFileW(from.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        ec.assign(static_cast<int>(GetLastError()), std::system_category());
+        return false;
+    }
+    BOOL flushed = FlushFileBuffers(file);
+    DWORD error = GetLastError();
+    CloseHandle(file);
+    if (!flushed) {
+        ec.assign(static_cast<int>(error), std::system_category());
+        return false;
+    }
+
+    if (!MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        ec.assign(static_cast<int>(GetLastError()), std::system_category());
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool DurableRename(const std::filesystem::path& from, const std::filesystem::path& to, std::error_code& ec) {
+    ec.clear();
+    int file = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        ec.assign(errno, std::generic_category());
+        return false;
+    }
+    int result = fsync(file);
+    int error = errno;
+    ::close(file);
+    if (result != 0) {
+        ec.assign(error, std::generic_category());
+        return false;
+    }
+
+    std::filesystem::rename(from, to, ec);
+    if (ec) {
+        return false;
+    }
+
+    // The new directory entry is only on disk once the directory is; best
+    // effort, as some file systems cannot sync a directory
+    std::filesystem::path directory = to.parent_path();
+    int directoryFd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd >= 0) {
+        fsync(directoryFd);
+        ::close(directoryFd);
+    }
+    return true;
+}
+
+#endif
+
+RandomAccessFile::~RandomAccessFile() {
+    Close();
+}
+
+#ifdef _WIN32
+
+bool RandomAccessFile::Open(const std::filesystem::path& path) {
+    Close();
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+    handle = file;
+    size = static_cast<uint64_t>(fileSize.QuadPart);
+    return true;
+}
+
+void RandomAccessFile::Close() {
+    if (handle) {
+        CloseHandle(handle);
+        handle = nullptr;
+    }
+    size = 0;
+}
+
+bool RandomAccessFile::IsOpen() const {
+    return handle != nullptr;
+}
+
+size_t RandomAccessFile::ReadAt(uint64_t offset, void* buffer, size_t count) const {
+    size_t total = 0;
+    while (total < count) {
+        // The offset travels in the OVERLAPPED; a synchronous handle still blocks
+        OVERLAPPED overlapped = {};
+        uint64_t position = offset + total;
+        overlapped.Offset = static_cast<DWORD>(position);
+        overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(count - total, 1u << 30));
+        DWORD got = 0;
+        if (!::ReadFile(handle, static_cast<char*>(buffer) + total, chunk, &got, &overlapped) || got == 0) {
+            break;
+        }
+        total += got;
+    }
+    return total;
+}
+
+void RandomAccessFile::WillNeed(uint64_t, uint64_t) const {
+    // Nothing to do: the handle is opened with FILE_FLAG_SEQUENTIAL_SCAN, and
+    // the cache manager's read-ahead follows sequential readers on its own
+}
+
+#else
+
+bool RandomAccessFile::Open(const std::filesystem::path& path) {
+    Close();
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0) {
+        ::close(file);
+        return false;
+    }
+    fd = file;
+    size = static_cast<uint64_t>(info.st_size);
+    return true;
+}
+
+void RandomAccessFile::Close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    size = 0;
+}
+
+bool RandomAccessFile::IsOpen() const {
+    return fd >= 0;
+}
+
+size_t RandomAccessFile::ReadAt(uint64_t offset, void* buffer, size_t count) const {
+    size_t total = 0;
+    while (total < count) {
+        ssize_t got = pread(fd, static_cast<char*>(buffer) + total, count - total,
+                            static_cast<off_t>(offset + total));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        total += static_cast<size_t>(got);
+    }
+    return total;
+}
+
+void RandomAccessFile::WillNeed(uint64_t offset, uint64_t length) const {
+#ifdef POSIX_FADV_WILLNEED
+    // Starts asynchronous read-ahead into the page cache and returns at once
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+#else
+    (void)offset;
+    (void)length;
+#endif
+}
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+// OS-specific helpers for the portable core (everything but the Win32 UI in
+// main.cpp). Child processes are in ChildProcess.
+
+// Diagnostic output: the debugger on Windows; stderr elsewhere when
+// MULTIREMUX_DEBUG is set
+void DebugLog(const std::string& message);
+
+// Renames `from` over `to` so that after a crash or power cut `to` holds its
+// old contents or all of from's, never a name without the data: from's data
+// is flushed first (fsync / FlushFileBuffers), then the rename itself
+// (the directory's fsync / MOVEFILE_WRITE_THROUGH)
+bool DurableRename(const std::filesystem::path& from, const std::filesystem::path& to, std::error_code& ec);
+
+// Read-only file for positioned reads (pread / ReadFile with an offset).
+// ReadAt does not move a shared file position, so one instance can serve
+// several threads at once, e.g. every clip reader of a disc image.
+class RandomAccessFile {
+public:
+    RandomAccessFile() = default;
+    ~RandomAccessFile();
+
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+    bool IsOpen() const;
+
+    // Returns the number of bytes read; short only at end of file or on error
+    size_t ReadAt(uint64_t offset, void* buffer, size_t size) const;
+    uint64_t Size() const { return size; }
+
+    // Hint that the range will be read soon (posix_fadvise WILLNEED); best effort
+    void WillNeed(uint64_t offset, uint64_t length) const;
+
+private:
+#ifdef _WIN32
+    void* handle = nullptr;
+#else
+    int fd = -1;
+#endif
+    uint64_t size = 0;
+};
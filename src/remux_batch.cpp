@@ -0,0 +1,408 @@
+#include "remux_batch.h"
+#include "disc_filesystem.h"
+#include "job_journal.h"
+#include "native_remuxer.h"
+#include "platform.h"
+#include "scan_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <memory>
+
+namespace {
+
+void Log(const BatchEvents& events, const std::string& message) {
+    if (events.onLog) {
+        events.onLog(message);
+    }
+}
+
+void Status(const BatchEvents& events, size_t index, const std::string& status) {
+    if (events.onStatus) {
+        events.onStatus(index, status);
+    }
+}
+
+} // namespace
+
+bool RemuxBatch::AnalyzeDisc(const std::string& path, BDMVFile& file,
+                             const std::function<void(const std::string&)>& onLog, ScanDepth depth) {
+    try {
+        fs::path fsPath(path);
+
+        // A disc image is read in place, like the folder it would mount as
+        bool isImage = DiscFileSystem::IsImageFile(fsPath);
+        if (isImage) {
+            std::string error;
+            if (!DiscFileSystem::OpenImage(fsPath, error)) {
+                if (onLog) {
+                    onLog("Cannot read image " + path + ": " + error);
+                }
+                return false;
+            }
+        }
+
+        // Check if it's a BDMV folder or contains BDMV
+        if (isImage || fs::is_directory(fsPath)) {
+            if (fsPath.filename() == "BDMV" || DiscFileSystem::Exists(fsPath / "BDMV")) {
+                // Use BDMVParser to analyze the folder
+                std::vector<BDMVTitle> titles = BDMVParser::ParseBDMVFolder(path, true, depth);
+
+                if (!titles.empty()) {
+                    file.path = path;
+                    file.status = "Ready";
+
+                    if (fsPath.filename() == "BDMV") {
+                        file.description = fsPath.parent_path().filename().string();
+                    } else if (isImage) {
+                        file.description = fsPath.stem().string();
+                    } else {
+                        file.description = fsPath.filename().string();
+                    }
+
+                    file.titles = std::move(titles);
+
+                    // BD-J discs are the ones that usually ship decoy playlists
+                    BDMVIndex index;
+                    fs::path bdmvPath = fsPath.filename() == "BDMV" ? fsPath : fsPath / "BDMV";
+                    if (BDMVParser::ParseIndexFile(bdmvPath / "index.bdmv", index)) {
+                        size_t bdjTitles = std::count_if(index.titles.begin(), index.titles.end(),
+                            [](const IndexTitle& t) { return t.isBDJ; });
+                        file.indexSummary = std::to_string(index.titles.size()) + " titles, " +
+                                            std::to_string(bdjTitles) + " BD-J";
+                    }
+                    return true;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        if (onLog) {
+            onLog("Error analyzing: " + path + " - " + e.what());
+        }
+    }
+    return false;
+}
+
+size_t RemuxBatch::AnalyzeTitlesAsync(const BDMVFile& file,
+                                      const std::function<void(size_t index, const BDMVTitle& title)>& onTitle) {
+    // Shared by the title tasks; the last one to finish stores the scan
+    struct Scan {
+        std::string path;
+        fs::path streamDir;
+        std::vector<BDMVTitle> titles;
+        ClipInfoCache clipCache;
+        std::shared_ptr<IOThrottle> throttle;
+        std::atomic<size_t> remaining{0};
+    };
+    auto scan = std::make_shared<Scan>();
+    scan->path = file.path;
+    fs::path root(file.path);
+    scan->streamDir = (root.filename() == "BDMV" ? root : root / "BDMV") / "STREAM";
+    scan->titles = file.titles;
+    scan->throttle = IOThrottle::ForPath(root);
+
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < scan->titles.size(); i++) {
+        if (!scan->titles[i].analyzed) {
+            pending.push_back(i);
+        }
+    }
+    scan->remaining = pending.size();
+
+    for (size_t index : pending) {
+        ScanPool::Instance().Submit([scan, index, onTitle]() {
+            BDMVTitle& title = scan->titles[index];
+            {
+                IOThrottle::Slot slot(*scan->throttle);
+                BDMVParser::AnalyzeTitleStreams(title, scan->streamDir, &scan->clipCache);
+            }
+            if (onTitle) {
+                onTitle(index, title);
+            }
+            // Every other task has written its title before its decrement
+            if (--scan->remaining == 0) {
+                BDMVParser::StoreScan(scan->path, scan->titles);
+            }
+        });
+    }
+    return pending.size();
+}
+
+const BDMVTitle* RemuxBatch::SelectMainTitle(const BDMVFile& file) {
+    if (file.titles.empty()) {
+        return nullptr;
+    }
+    return &*std::max_element(file.titles.begin(), file.titles.end(),
+        [](const BDMVTitle& a, const BDMVTitle& b) {
+            return a.duration < b.duration;
+        });
+}
+
+fs::path RemuxBatch::GetOutputPath(const BatchOptions& options, const BDMVFile& file) {
+    std::string range;
+    if (options.firstChapter > 0) {
+        range = options.lastChapter == options.firstChapter
+            ? " (chapter " + std::to_string(options.firstChapter) + ")"
+            : " (chapters " + std::to_string(options.firstChapter) + "-" +
+              (options.lastChapter > 0 ? std::to_string(options.lastChapter) : std::string("end")) + ")";
+    } else if (options.HasRange()) {
+        char text[64];
+        std::snprintf(text, sizeof(text), options.endTime > 0 ? " (%.0f-%.0fs)" : " (from %.0fs)",
+                      options.startTime, options.endTime);
+        range = text;
+    }
+    return fs::path(options.outputDirectory) / (file.description + range + ".mkv");
+}
+
+void RemuxBatch::SelectStreamsByPID(const BDMVTitle& title, const LanguagePolicy& languages,
+                                    FFmpegWrapper::StreamOptions& options) {
+    auto isSelected = [](const std::vector<LanguageId>& selected, const StreamInfo& stream) {
+        return std::find(selected.begin(), selected.end(), stream.language) != selected.end();
+    };
+
+    // Only main-clip streams of the primary set can be mapped from the MPLS input
+    std::vector<FFmpegWrapper::MappedStream> allAudio;
+    for (const auto& stream : title.streams) {
+        if (stream.role != StreamRole::Primary || stream.subPathId != -1) {
+            continue;
+        }
+
+        if (stream.kind == StreamKind::Video && options.videoPid == 0) {
+            options.videoPid = stream.pid;
+        } else if (stream.kind == StreamKind::Audio) {
+            allAudio.push_back({stream.pid, stream.language});
+            if (isSelected(languages.audioLanguages, stream)) {
+                options.audioStreams.push_back({stream.pid, stream.language});
+            }
+        } else if (stream.IsSubtitle() && isSelected(languages.subtitleLanguages, stream)) {
+            options.subtitleStreams.push_back({stream.pid, stream.language});
+        }
+    }
+
+    // Map all audio when none of the selected languages exist on this title
+    if (options.audioStreams.empty()) {
+        options.audioStreams = allAudio;
+    }
+}
+
+size_t RemuxBatch::Run(const std::vector<BDMVFile>& files, const BatchOptions& options,
+                       const BatchEvents& events, const CancelToken& cancel) {
+    std::atomic<size_t> completed{0};
+
+    try {
+        fs::create_directories(options.outputDirectory);
+
+        // Picks up a batch that an earlier run did not finish. Declared
+        // before the scheduler, which waits for the jobs that use it.
+        JobJournal journal(options.outputDirectory);
+        journal.Load();
+        if (size_t interrupted = journal.RecoverInterrupted()) {
+            Log(events, "Restarting " + std::to_string(interrupted) + " title(s) interrupted in an earlier run");
+        }
+
+        RemuxScheduler scheduler(options.limits);
+
+        // Declared after the scheduler, so it is unregistered before the
+        // scheduler's destructor waits for the running jobs
+        CancelToken::Registration stopRegistration = cancel.OnCancel([&scheduler]() {
+            scheduler.Cancel();
+        });
+
+        for (size_t i = 0; i < files.size() && !cancel.IsCancelled(); i++) {
+            const BDMVFile& file = files[i];
+            const BDMVTitle* main = SelectMainTitle(file);
+            if (!main) {
+                if (events.onFinished) {
+                    events.onFinished(i, false);
+                }
+                continue;
+            }
+
+            BDMVTitle mainTitle = *main;
+            std::string bdmvPath = file.path;
+            std::string description = file.description;
+            std::string outputFile = GetOutputPath(options, file).string();
+
+            if (journal.IsCompleted(bdmvPath, mainTitle.filename, outputFile)) {
+                completed++;
+                Status(events, i, "Completed");
+                Log(events, "Already completed, skipping: " + description);
+                if (events.onFinished) {
+                    events.onFinished(i, true);
+                }
+                continue;
+            }
+
+            // Everything the job needs is copied in, so callers may change their lists meanwhile
+            RemuxJob job;
+            job.priority = -static_cast<int>(i); // Keep list order among jobs that can start
+            job.source = bdmvPath;
+            job.destination = options.outputDirectory;
+            job.run = [i, bdmvPath, mainTitle, outputFile, &journal, &options, &events](
+                          int threads, const CancelToken& jobCancel) {
+                Status(events, i, "Processing...");
+                ProgressCallback onProgress;
+                if (events.onProgress) {
+                    onProgress = [i, &events](const RemuxProgress& progress) { events.onProgress(i, progress); };
+                }
+
+                // Journalled before any output exists, so a crash from here on is
+                // seen as an interrupted job on the next run
+                journal.Update(bdmvPath, mainTitle.filename, outputFile, JobState::Processing);
+
+                // Only a finished file gets the final name, and only once its
+                // data is on disk: the skip check on the next run trusts a
+                // Completed entry whose file has the recorded size
+                fs::path partialFile = JobJournal::PartialPath(outputFile);
+                bool success = ProcessTitle(bdmvPath, mainTitle, partialFile.string(), options, threads,
+                                            onProgress, jobCancel, events);
+
+                std::error_code ec;
+                uint64_t outputSize = 0;
+                if (success) {
+                    DurableRename(partialFile, outputFile, ec);
+                    outputSize = ec ? 0 : fs::file_size(outputFile, ec);
+                    if (ec) {
+                        Log(events, "Cannot finalize " + outputFile + ": " + ec.message());
+                        success = false;
+                    }
+                }
+                if (!success) {
+                    fs::remove(partialFile, ec);
+                }
+
+                JobState state = success ? JobState::Completed
+                               : jobCancel.IsCancelled() ? JobState::Stopped : JobState::Error;
+                journal.Update(bdmvPath, mainTitle.filename, outputFile, state, outputSize);
+                return success;
+            };
+            job.done = [i, description, &cancel, &events, &completed](bool success) {
+                if (success) {
+                    completed++;
+                }
+                if (events.onFinished) {
+                    events.onFinished(i, success);
+                }
+
+                std::string status = success ? "Completed" : cancel.IsCancelled() ? "Stopped" : "Error";
+                Status(events, i, status);
+                Log(events, status + ": " + description);
+            };
+
+            // Blocks while the scheduler's queue is full
+            if (!scheduler.Submit(std::move(job))) {
+                break;
+            }
+        }
+
+        scheduler.Wait();
+
+    } catch (const std::exception& e) {
+        Log(events, "Processing error: " + std::string(e.what()));
+    }
+
+    return files.size() - completed;
+}
+
+bool RemuxBatch::ProcessTitle(const std::string& bdmvPath, const BDMVTitle& title, const std::string& outputFile,
+                              const BatchOptions& batchOptions, int threads, const ProgressCallback& onProgress,
+                              const CancelToken& cancel, const BatchEvents& events) {
+    try {
+        // Build MPLS file path
+        fs::path mplsPath = bdmvPath;
+        if (mplsPath.filename() != "BDMV") {
+            mplsPath /= "BDMV";
+        }
+        mplsPath = mplsPath / "PLAYLIST" / title.filename;
+
+        // Use FFmpegWrapper to process
+        FFmpegWrapper::StreamOptions options;
+        options.audioLanguages = batchOptions.languages.audioLanguages;
+        options.subtitleLanguages = batchOptions.languages.subtitleLanguages;
+        SelectStreamsByPID(title, batchOptions.languages, options);
+        options.threads = threads; // Share of the scheduler's CPU budget
+        options.backend = batchOptions.backend;
+        options.ffmpegPath = batchOptions.ffmpegPath;
+        options.unbufferedOutput = batchOptions.unbufferedOutput;
+        options.angle = batchOptions.angle;
+        options.onProgress = onProgress;
+        options.cancel = &cancel;
+        
+        // A chapter range is a time range on the title's marks
+        options.startTime = batchOptions.startTime;
+        options.endTime = batchOptions.endTime;
+        if (batchOptions.firstChapter > 0) {
+            int lastChapter = batchOptions.lastChapter > 0 ? batchOptions.lastChapter : INT_MAX;
+            if (!title.GetChapterRange(batchOptions.firstChapter, lastChapter, options.startTime, options.endTime)) {
+                Log(events, title.filename + " has no chapter " + std::to_string(batchOptions.firstChapter));
+                return false;
+            }
+        }
+        
+        // The cut title starts on the entry point before the range, which is
+        // where reading starts; progress is measured against what is read
+        fs::path streamDir = mplsPath.parent_path().parent_path() / "STREAM";
+        BDMVTitle playback = title;
+        double playbackStart = options.startTime;
+        if (options.HasRange() && !BDMVParser::TrimTitle(playback, streamDir, playbackStart, options.endTime)) {
+            Log(events, "The time range is outside " + title.filename);
+            return false;
+        }
+        options.expectedDuration = playback.duration;
+        options.expectedSize = playback.size;
+        options.chapters = playback.GetChapterStarts();
+        
+        // ffmpeg cannot open files inside an image, nor pick an angle of an
+        // MPLS, so in those cases it gets the chosen angle's clips on stdin.
+        // So does a range, so that only the range's packets are read.
+        bool otherAngle = options.angle > 0 && title.GetAngleCount() > 1;
+        if (DiscFileSystem::IsInImage(mplsPath) || otherAngle || options.HasRange()) {
+            for (const auto& clip : playback.GetClips(options.angle)) {
+                ClipSpan span;
+                span.path = streamDir / (clip.clipName + ".m2ts");
+                if (clip.byteLength != 0) {
+                    span.offset = clip.byteOffset;
+                    span.length = clip.byteLength;
+                }
+                options.inputClips.push_back(span);
+            }
+        }
+
+        if (options.backend == RemuxBackend::Native) {
+            std::string error;
+            if (NativeRemuxer::SupportsStreams(title, options, error)) {
+                if (NativeRemuxer::RemuxTitle(bdmvPath, title, outputFile, options, error)) {
+                    return true;
+                }
+                if (!cancel.IsCancelled()) {
+                    Log(events, "Built-in muxer failed on " + title.filename + ": " + error);
+                }
+                return false;
+            }
+            Log(events, "Built-in muxer skipped for " + title.filename + " (" + error + "), using ffmpeg");
+        }
+
+        options.startTime = playbackStart; // Where the stdin feed begins
+        return FFmpegWrapper::RemuxBDMV(mplsPath.string(), outputFile, options);
+
+    } catch (const std::exception& e) {
+        Log(events, "Error processing title: " + std::string(e.what()));
+        return false;
+    }
+}
+
+std::string RemuxBatch::FormatProgress(const RemuxProgress& progress) {
+    char text[96];
+    int length = snprintf(text, sizeof(text), "%d%% | %.1f GB",
+                          static_cast<int>(progress.fraction * 100), progress.bytesWritten / 1e9);
+    if (progress.speed > 0) {
+        length += snprintf(text + length, sizeof(text) - length, " | %.1fx", progress.speed);
+    }
+    if (progress.etaSeconds >= 0) {
+        int eta = static_cast<int>(progress.etaSeconds);
+        snprintf(text + length, sizeof(text) - length, " | ETA %d:%02d:%02d",
+                 eta / 3600, (eta / 60) % 60, eta % 60);
+    }
+    return text;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "bdmv_parser.h"
+#include "cancel_token.h"
+#include "ffmpeg_wrapper.h"
+#include "remux_scheduler.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// A disc root added to the batch
+struct BDMVFile {
+    std::string path;
+    std::string description;
+    std::vector<BDMVTitle> titles;
+    std::string status;
+    std::string indexSummary;
+};
+
+// Which streams go into each MKV; an empty audio list keeps all audio
+struct LanguagePolicy {
+    std::vector<LanguageId> audioLanguages;
+    std::vector<LanguageId> subtitleLanguages;
+};
+
+struct BatchOptions {
+    std::string outputDirectory;
+    LanguagePolicy languages;
+    RemuxBackend backend = RemuxBackend::FFmpeg;
+    std::string ffmpegPath = "ffmpeg";
+    bool unbufferedOutput = false; // Built-in muxer only; see OutputWriter
+    size_t angle = 0;              // 0-based; titles with fewer angles use their first
+
+    // Partial extraction of each main title: a time range in seconds, or
+    // chapters (1-based) when firstChapter is set. endTime / lastChapter 0
+    // run to the end of the title.
+    double startTime = 0;
+    double endTime = 0;
+    int firstChapter = 0;
+    int lastChapter = 0;
+
+    bool HasRange() const { return firstChapter > 0 || startTime > 0 || endTime > 0; }
+    RemuxScheduler::Limits limits;
+};
+
+// Everything a front end hears about a batch. All callbacks are invoked on
+// scheduler threads and must be thread-safe; any of them may be empty.
+struct BatchEvents {
+    std::function<void(const std::string& message)> onLog;
+    std::function<void(size_t index, const std::string& status)> onStatus;
+    std::function<void(size_t index, const RemuxProgress& progress)> onProgress;
+    std::function<void(size_t index, bool success)> onFinished; // Once per file, including skipped ones
+};
+
+// The processing loop shared by the Win32 UI and the multiremux CLI: picks
+// each disc's main title, maps the selected streams, and runs the jobs on a
+// RemuxScheduler with a JobJournal in the output directory.
+class RemuxBatch {
+public:
+    // Scans a BDMV folder (or its parent) or a disc image (.iso), which is read
+    // in place without mounting. Returns false if it holds no titles.
+    static bool AnalyzeDisc(const std::string& path, BDMVFile& file,
+                            const std::function<void(const std::string&)>& onLog,
+                            ScanDepth depth = ScanDepth::Full);
+
+    // The deep tier after a Structure scan: analyzes each title not analyzed
+    // yet on the scan pool and hands it to onTitle (on a pool thread) as soon
+    // as it is done. The scan is cached after the last one. Returns the
+    // number of titles queued.
+    static size_t AnalyzeTitlesAsync(const BDMVFile& file,
+                                     const std::function<void(size_t index, const BDMVTitle& title)>& onTitle);
+
+    // The longest title, or nullptr if the disc has none
+    static const BDMVTitle* SelectMainTitle(const BDMVFile& file);
+
+    // Partial extractions get the range in their name, e.g. "Movie (chapters 3-5).mkv"
+    static fs::path GetOutputPath(const BatchOptions& options, const BDMVFile& file);
+
+    // Maps the policy's languages to main-path PIDs; all audio if none match
+    static void SelectStreamsByPID(const BDMVTitle& title, const LanguagePolicy& languages,
+                                   FFmpegWrapper::StreamOptions& options);
+
+    // Runs every file's main title until done or until cancel fires.
+    // Returns the number of files whose title did not complete.
+    static size_t Run(const std::vector<BDMVFile>& files, const BatchOptions& options,
+                      const BatchEvents& events, const CancelToken& cancel);
+
+    // "42% | 3.1 GB | 1.8x | ETA 0:12:05"
+    static std::string FormatProgress(const RemuxProgress& progress);
+
+private:
+    static bool ProcessTitle(const std::string& bdmvPath, const BDMVTitle& title, const std::string& outputFile,
+                             const BatchOptions& options, int threads, const ProgressCallback& onProgress,
+                             const CancelToken& cancel, const BatchEvents& events);
+};
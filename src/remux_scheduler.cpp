@@ -0,0 +1,169 @@
+#include "remux_scheduler.h"
+#include "scan_pool.h"
+#include <algorithm>
+
+RemuxScheduler::RemuxScheduler(Limits limits) : limits(limits) {
+    if (this->limits.cpuThreads <= 0) {
+        this->limits.cpuThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    this->limits.maxConcurrentJobs = std::max(1, this->limits.maxConcurrentJobs);
+    this->limits.perSourceDevice = std::max(1, this->limits.perSourceDevice);
+    this->limits.perDestinationDevice = std::max(1, this->limits.perDestinationDevice);
+    this->limits.maxQueued = std::max<size_t>(1, this->limits.maxQueued);
+
+    for (int i = 0; i < this->limits.maxConcurrentJobs; i++) {
+        workers.emplace_back(&RemuxScheduler::WorkerLoop, this);
+    }
+}
+
+RemuxScheduler::~RemuxScheduler() {
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool RemuxScheduler::Submit(RemuxJob job) {
+    QueuedJob entry;
+    entry.sourceDevice = IOThrottle::GetDeviceKey(job.source);
+    entry.destinationDevice = IOThrottle::GetDeviceKey(job.destination);
+    entry.job = std::move(job);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return cancelled || queue.size() < limits.maxQueued; });
+        if (cancelled) {
+            return false;
+        }
+        entry.sequence = nextSequence++;
+        queue.push_back(std::move(entry));
+    }
+    changed.notify_all();
+    return true;
+}
+
+size_t RemuxScheduler::CancelPending() {
+    std::vector<QueuedJob> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        dropped.swap(queue);
+    }
+    changed.notify_all();
+
+    for (auto& entry : dropped) {
+        if (entry.job.done) {
+            entry.job.done(false);
+        }
+    }
+    return dropped.size();
+}
+
+void RemuxScheduler::Cancel() {
+    CancelPending();
+    cancelToken.Cancel();
+}
+
+void RemuxScheduler::Wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return queue.empty() && running == 0; });
+}
+
+bool RemuxScheduler::WaitFor(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return changed.wait_for(lock, timeout, [this]() { return queue.empty() && running == 0; });
+}
+
+size_t RemuxScheduler::QueuedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+size_t RemuxScheduler::RunningCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running;
+}
+
+bool RemuxScheduler::CanStart(const QueuedJob& entry) const {
+    auto busy = [](const std::map<std::string, int>& counts, const std::string& key) {
+        auto it = counts.find(key);
+        return it == counts.end() ? 0 : it->second;
+    };
+
+    if (threadsInUse >= limits.cpuThreads) {
+        return false;
+    }
+    // Reads and writes share a device, so running jobs count against both of
+    // its limits whichever way they use it; a job that reads and writes one
+    // device counts twice
+    auto load = [&](const std::string& device) { return busy(sourceBusy, device) + busy(destinationBusy, device); };
+    if (load(entry.sourceDevice) >= limits.perSourceDevice) {
+        return false;
+    }
+    return load(entry.destinationDevice) < limits.perDestinationDevice;
+}
+
+int RemuxScheduler::GrantThreads() const {
+    // An even share of the budget, never more than what is left
+    int share = std::max(1, limits.cpuThreads / limits.maxConcurrentJobs);
+    return std::min(share, limits.cpuThreads - threadsInUse);
+}
+
+void RemuxScheduler::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        // Highest priority first, then oldest, among jobs whose devices are free
+        auto best = queue.end();
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (!CanStart(*it)) {
+                continue;
+            }
+            if (best == queue.end() || it->job.priority > best->job.priority ||
+                (it->job.priority == best->job.priority && it->sequence < best->sequence)) {
+                best = it;
+            }
+        }
+
+        if (best == queue.end()) {
+            if (stopping) {
+                return;
+            }
+            changed.wait(lock);
+            continue;
+        }
+
+        QueuedJob entry = std::move(*best);
+        queue.erase(best);
+
+        int threads = GrantThreads();
+        threadsInUse += threads;
+        sourceBusy[entry.sourceDevice]++;
+        destinationBusy[entry.destinationDevice]++;
+        running++;
+        lock.unlock();
+        changed.notify_all(); // Queue has room again
+
+        bool success = false;
+        try {
+            success = entry.job.run && entry.job.run(threads, cancelToken);
+        } catch (...) {
+            success = false;
+        }
+        if (entry.job.done) {
+            entry.job.done(success);
+        }
+
+        lock.lock();
+        threadsInUse -= threads;
+        sourceBusy[entry.sourceDevice]--;
+        destinationBusy[entry.destinationDevice]--;
+        running--;
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "cancel_token.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct RemuxJob {
+    int priority = 0;       // Higher runs first; equal priorities run in submission order
+    fs::path source;        // Disc or folder being read, for the per-device limit
+    fs::path destination;   // Output file or folder, for the per-device limit
+
+    // Runs on a scheduler thread with the CPU threads granted to this job. The
+    // token fires when the scheduler is cancelled; long-running work should
+    // register with it and return promptly.
+    std::function<bool(int threads, const CancelToken& cancel)> run;
+
+    // Called after run (or with false if the job was cancelled while queued)
+    std::function<void(bool success)> done;
+};
+
+// Runs remux jobs concurrently. A job only starts when its source device and
+// destination device both have a free slot and some of the CPU thread budget
+// is left, so several discs on different drives can be copied at once
+// without two jobs fighting over the same spindle.
+class RemuxScheduler {
+public:
+    struct Limits {
+        int maxConcurrentJobs = 4;
+        int perSourceDevice = 1;        // Jobs using a device, either way, before no more may read from it
+        int perDestinationDevice = 2;   // Jobs using a device, either way, before no more may write to it
+        int cpuThreads = 0;     // Total threads handed out to running jobs; 0 = hardware threads
+        size_t maxQueued = 16;  // Submit() blocks once this many jobs are waiting
+    };
+
+    explicit RemuxScheduler(Limits limits);
+    RemuxScheduler() : RemuxScheduler(Limits()) {}
+    ~RemuxScheduler();
+
+    RemuxScheduler(const RemuxScheduler&) = delete;
+    RemuxScheduler& operator=(const RemuxScheduler&) = delete;
+
+    // Queues a job, blocking while the queue is full. Returns false once the
+    // scheduler has been cancelled.
+    bool Submit(RemuxJob job);
+
+    // Drops every queued job (their done callbacks get false); running jobs finish
+    size_t CancelPending();
+
+    // CancelPending() and also signals running jobs through their token
+    void Cancel();
+
+    // Waits for all submitted jobs; WaitFor returns false on timeout
+    void Wait();
+    bool WaitFor(std::chrono::milliseconds timeout);
+
+    size_t QueuedCount() const;
+    size_t RunningCount() const;
+
+private:
+    struct QueuedJob {
+        RemuxJob job;
+        uint64_t sequence;
+        std::string sourceDevice;
+        std::string destinationDevice;
+    };
+
+    void WorkerLoop();
+    bool CanStart(const QueuedJob& entry) const;
+    int GrantThreads() const;
+
+    Limits limits;
+    CancelToken cancelToken;
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<QueuedJob> queue;
+    std::map<std::string, int> sourceBusy;
+    std::map<std::string, int> destinationBusy;
+    uint64_t nextSequence = 0;
+    int threadsInUse = 0;
+    size_t running = 0;
+    bool cancelled = false;
+    bool stopping = false;
+};
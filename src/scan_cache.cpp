@@ -0,0 +1,420 @@
+#include "scan_cache.h"
+#include "bdmv_parser.h"
+#include "byte_reader.h"
+#include "disc_filesystem.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+const char CacheMagic[4] = {'M', 'R', 'S', 'C'};
+
+// 64-bit FNV-1a, cheap and stable across runs and platforms
+class Fingerprint {
+public:
+    void Add(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+        }
+    }
+
+    void Add(const std::string& value) {
+        Add(value.data(), value.size());
+        Add(static_cast<uint64_t>(value.size()));
+    }
+
+    void Add(uint64_t value) {
+        Add(&value, sizeof(value));
+    }
+
+    uint64_t Value() const { return hash; }
+
+private:
+    uint64_t hash = 0xcbf29ce484222325ULL;
+};
+
+// Big-endian counterpart of ByteReader for the cache format
+class ByteWriter {
+public:
+    void WriteU8(uint8_t value) { buffer.push_back(value); }
+
+    void WriteU16(uint16_t value) {
+        WriteU8(static_cast<uint8_t>(value >> 8));
+        WriteU8(static_cast<uint8_t>(value));
+    }
+
+    void WriteU32(uint32_t value) {
+        WriteU16(static_cast<uint16_t>(value >> 16));
+        WriteU16(static_cast<uint16_t>(value));
+    }
+
+    void WriteU64(uint64_t value) {
+        WriteU32(static_cast<uint32_t>(value >> 32));
+        WriteU32(static_cast<uint32_t>(value));
+    }
+
+    void WriteString(const std::string& value) {
+        size_t length = std::min<size_t>(value.size(), 0xFFFF);
+        WriteU16(static_cast<uint16_t>(length));
+        buffer.insert(buffer.end(), value.begin(), value.begin() + length);
+    }
+
+    const std::vector<uint8_t>& Data() const { return buffer; }
+
+private:
+    std::vector<uint8_t> buffer;
+};
+
+std::string ReadCacheString(ByteReader& reader) {
+    return reader.ReadString(reader.ReadU16());
+}
+
+void WriteStringList(ByteWriter& writer, const std::vector<std::string>& values) {
+    writer.WriteU16(static_cast<uint16_t>(values.size()));
+    for (const auto& value : values) {
+        writer.WriteString(value);
+    }
+}
+
+std::vector<std::string> ReadStringList(ByteReader& reader) {
+    std::vector<std::string> values(reader.ReadU16());
+    for (auto& value : values) {
+        value = ReadCacheString(reader);
+    }
+    return values;
+}
+
+// Languages as their packed ISO 639-2 codes
+void WriteLanguageList(ByteWriter& writer, const std::vector<LanguageId>& languages) {
+    writer.WriteU16(static_cast<uint16_t>(languages.size()));
+    for (LanguageId language : languages) {
+        writer.WriteU32(language.Value());
+    }
+}
+
+std::vector<LanguageId> ReadLanguageList(ByteReader& reader) {
+    std::vector<LanguageId> languages(reader.ReadU16());
+    for (auto& language : languages) {
+        language = LanguageId::FromValue(reader.ReadU32());
+    }
+    return languages;
+}
+
+uint64_t DoubleBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double BitsDouble(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void WriteStreams(ByteWriter& writer, const std::vector<StreamInfo>& streams) {
+    writer.WriteU16(static_cast<uint16_t>(streams.size()));
+    for (const auto& stream : streams) {
+        writer.WriteU16(stream.pid);
+        writer.WriteU8(static_cast<uint8_t>(stream.kind));
+        writer.WriteU8(stream.codingType);
+        writer.WriteString(stream.codec);
+        writer.WriteU32(stream.language.Value());
+        writer.WriteString(stream.channelLayout);
+        writer.WriteU32(static_cast<uint32_t>(stream.sampleRate));
+        writer.WriteU8(static_cast<uint8_t>(stream.role));
+        writer.WriteU16(static_cast<uint16_t>(stream.subPathId));
+    }
+}
+
+void WriteClipReferences(ByteWriter& writer, const std::vector<ClipReference>& clips) {
+    writer.WriteU8(static_cast<uint8_t>(clips.size()));
+    for (const auto& clip : clips) {
+        writer.WriteString(clip.clipName);
+        writer.WriteU8(clip.stcId);
+        writer.WriteU64(clip.byteOffset);
+        writer.WriteU64(clip.byteLength);
+    }
+}
+
+std::vector<ClipReference> ReadClipReferences(ByteReader& reader) {
+    std::vector<ClipReference> clips(reader.ReadU8());
+    for (auto& clip : clips) {
+        clip.clipName = ReadCacheString(reader);
+        clip.stcId = reader.ReadU8();
+        clip.byteOffset = reader.ReadU64();
+        clip.byteLength = reader.ReadU64();
+    }
+    return clips;
+}
+
+std::vector<StreamInfo> ReadStreams(ByteReader& reader) {
+    std::vector<StreamInfo> streams(reader.ReadU16());
+    for (auto& stream : streams) {
+        stream.pid = reader.ReadU16();
+        stream.kind = static_cast<StreamKind>(reader.ReadU8());
+        stream.codingType = reader.ReadU8();
+        stream.codec = ReadCacheString(reader);
+        stream.language = LanguageId::FromValue(reader.ReadU32());
+        stream.channelLayout = ReadCacheString(reader);
+        stream.sampleRate = static_cast<int>(reader.ReadU32());
+        stream.role = static_cast<StreamRole>(reader.ReadU8());
+        stream.subPathId = static_cast<int16_t>(reader.ReadU16());
+    }
+    return streams;
+}
+
+} // namespace
+
+uint64_t ScanCache::ComputeFingerprint(const fs::path& bdmvPath) {
+    Fingerprint fingerprint;
+
+    // Navigation files are a few kilobytes and identify the disc's authoring
+    for (const char* name : {"index.bdmv", "MovieObject.bdmv"}) {
+        std::vector<uint8_t> data;
+        if (!DiscFileSystem::ReadFile(bdmvPath / name, data)) {
+            return 0;
+        }
+        fingerprint.Add(std::string(name));
+        fingerprint.Add(data.data(), data.size());
+    }
+
+    // Playlists are covered by name, size and modification time only
+    struct Entry {
+        std::string name;
+        uint64_t size;
+        uint64_t mtime;
+    };
+    std::vector<Entry> entries;
+
+    std::vector<DiscFileSystem::Entry> listing;
+    if (!DiscFileSystem::ListDirectory(bdmvPath / "PLAYLIST", listing)) {
+        return 0;
+    }
+    for (const auto& entry : listing) {
+        entries.push_back({entry.name, entry.size, entry.modified});
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.name < b.name; });
+    for (const auto& entry : entries) {
+        fingerprint.Add(entry.name);
+        fingerprint.Add(entry.size);
+        fingerprint.Add(entry.mtime);
+    }
+
+    // 0 is reserved for "no fingerprint"
+    return fingerprint.Value() == 0 ? 1 : fingerprint.Value();
+}
+
+bool ScanCache::Load(uint64_t fingerprint, std::vector<BDMVTitle>& titles) {
+    std::vector<uint8_t> data;
+    if (fingerprint == 0 || !ReadFileBytes(GetEntryPath(fingerprint), data)) {
+        return false;
+    }
+
+    try {
+        ByteReader reader(data);
+        if (reader.ReadString(4) != std::string(CacheMagic, 4) ||
+            reader.ReadU16() != FormatVersion ||
+            reader.ReadU64() != fingerprint) {
+            return false;
+        }
+
+        // Every serialized title is larger than one byte, so this rejects absurd counts
+        uint32_t titleCount = reader.ReadU32();
+        if (titleCount > reader.Remaining()) {
+            return false;
+        }
+
+        std::vector<BDMVTitle> loaded(titleCount);
+        for (auto& title : loaded) {
+            title.id = static_cast<int>(reader.ReadU32());
+            title.filename = ReadCacheString(reader);
+            title.duration = BitsDouble(reader.ReadU64());
+            title.size = static_cast<size_t>(reader.ReadU64());
+            title.audioLanguages = ReadLanguageList(reader);
+            title.subtitleLanguages = ReadLanguageList(reader);
+            title.streams = ReadStreams(reader);
+
+            title.playItems.resize(reader.ReadU16());
+            for (auto& item : title.playItems) {
+                item.clipName = ReadCacheString(reader);
+                item.inTime = reader.ReadU32();
+                item.outTime = reader.ReadU32();
+                item.stcId = reader.ReadU8();
+                item.byteOffset = reader.ReadU64();
+                item.byteLength = reader.ReadU64();
+                item.connectionCondition = reader.ReadU8();
+                uint8_t flags = reader.ReadU8();
+                item.isMultiAngle = (flags & 0x01) != 0;
+                item.isSeamlessAngleChange = (flags & 0x02) != 0;
+                item.angles = ReadClipReferences(reader);
+                item.streams = ReadStreams(reader);
+            }
+
+            title.subPaths.resize(reader.ReadU16());
+            for (auto& subPath : title.subPaths) {
+                subPath.type = reader.ReadU8();
+                subPath.isRepeat = reader.ReadU8() != 0;
+                subPath.items.resize(reader.ReadU8());
+                for (auto& item : subPath.items) {
+                    item.clipName = ReadCacheString(reader);
+                    item.stcId = reader.ReadU8();
+                    item.connectionCondition = reader.ReadU8();
+                    item.inTime = reader.ReadU32();
+                    item.outTime = reader.ReadU32();
+                    item.syncPlayItemId = reader.ReadU16();
+                    item.syncStartPts = reader.ReadU32();
+                    item.clips = ReadClipReferences(reader);
+                }
+            }
+
+            title.marks.resize(reader.ReadU16());
+            for (auto& mark : title.marks) {
+                mark.type = reader.ReadU8();
+                mark.playItemId = reader.ReadU16();
+                mark.time = reader.ReadU32();
+            }
+
+            title.duplicates = ReadStringList(reader);
+            title.selectionNote = ReadCacheString(reader);
+            title.analyzed = true; // Only complete scans are stored
+        }
+
+        titles = std::move(loaded);
+        return true;
+
+    } catch (const std::exception&) {
+        // Truncated or foreign file: treat as a miss, the next Store replaces it
+        return false;
+    }
+}
+
+bool ScanCache::Store(uint64_t fingerprint, const std::vector<BDMVTitle>& titles) {
+    // A title whose languages could not be determined would stay undetermined
+    // for as long as the entry lives; leave the scan to the next load instead
+    bool complete = std::all_of(titles.begin(), titles.end(),
+                                [](const BDMVTitle& title) { return title.analyzed; });
+    if (fingerprint == 0 || titles.empty() || !complete) {
+        return false;
+    }
+
+    ByteWriter writer;
+    for (char c : CacheMagic) {
+        writer.WriteU8(static_cast<uint8_t>(c));
+    }
+    writer.WriteU16(FormatVersion);
+    writer.WriteU64(fingerprint);
+
+    writer.WriteU32(static_cast<uint32_t>(titles.size()));
+    for (const auto& title : titles) {
+        writer.WriteU32(static_cast<uint32_t>(title.id));
+        writer.WriteString(title.filename);
+        writer.WriteU64(DoubleBits(title.duration));
+        writer.WriteU64(title.size);
+        WriteLanguageList(writer, title.audioLanguages);
+        WriteLanguageList(writer, title.subtitleLanguages);
+
+        WriteStreams(writer, title.streams);
+
+        writer.WriteU16(static_cast<uint16_t>(title.playItems.size()));
+        for (const auto& item : title.playItems) {
+            writer.WriteString(item.clipName);
+            writer.WriteU32(item.inTime);
+            writer.WriteU32(item.outTime);
+            writer.WriteU8(item.stcId);
+            writer.WriteU64(item.byteOffset);
+            writer.WriteU64(item.byteLength);
+            writer.WriteU8(item.connectionCondition);
+            writer.WriteU8(static_cast<uint8_t>((item.isMultiAngle ? 0x01 : 0) |
+                                                (item.isSeamlessAngleChange ? 0x02 : 0)));
+            WriteClipReferences(writer, item.angles);
+            WriteStreams(writer, item.streams);
+        }
+
+        writer.WriteU16(static_cast<uint16_t>(title.subPaths.size()));
+        for (const auto& subPath : title.subPaths) {
+            writer.WriteU8(subPath.type);
+            writer.WriteU8(subPath.isRepeat ? 1 : 0);
+            writer.WriteU8(static_cast<uint8_t>(subPath.items.size()));
+            for (const auto& item : subPath.items) {
+                writer.WriteString(item.clipName);
+                writer.WriteU8(item.stcId);
+                writer.WriteU8(item.connectionCondition);
+                writer.WriteU32(item.inTime);
+                writer.WriteU32(item.outTime);
+                writer.WriteU16(item.syncPlayItemId);
+                writer.WriteU32(item.syncStartPts);
+                WriteClipReferences(writer, item.clips);
+            }
+        }
+
+        writer.WriteU16(static_cast<uint16_t>(title.marks.size()));
+        for (const auto& mark : title.marks) {
+            writer.WriteU8(mark.type);
+            writer.WriteU16(mark.playItemId);
+            writer.WriteU32(mark.time);
+        }
+
+        WriteStringList(writer, title.duplicates);
+        writer.WriteString(title.selectionNote);
+    }
+
+    // Write to a temporary file and rename it over the entry, so a concurrent
+    // scan or a crash never leaves a half-written entry behind
+    std::error_code ec;
+    fs::path entryPath = GetEntryPath(fingerprint);
+    fs::create_directories(entryPath.parent_path(), ec);
+
+    fs::path tempPath = entryPath;
+    tempPath += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(writer.Data().data()), writer.Data().size());
+        if (!file) {
+            file.close();
+            fs::remove(tempPath, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tempPath, entryPath, ec);
+    if (ec) {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+fs::path ScanCache::GetCacheDirectory() {
+#ifdef _WIN32
+    if (const char* localAppData = std::getenv("LOCALAPPDATA")) {
+        return fs::path(localAppData) / "MultiREMUXer" / "ScanCache";
+    }
+#else
+    if (const char* cacheHome = std::getenv("XDG_CACHE_HOME")) {
+        return fs::path(cacheHome) / "multiremuxer" / "scan";
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return fs::path(home) / ".cache" / "multiremuxer" / "scan";
+    }
+#endif
+    return fs::temp_directory_path() / "MultiREMUXer" / "ScanCache";
+}
+
+fs::path ScanCache::GetEntryPath(uint64_t fingerprint) {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << fingerprint << ".bin";
+    return GetCacheDirectory() / name.str();
+}
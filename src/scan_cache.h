@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+struct BDMVTitle;
+
+// On-disk cache of ParseBDMVFolder results. Entries are keyed by a disc
+// fingerprint built from index.bdmv, MovieObject.bdmv and the PLAYLIST
+// directory listing, so any change to the disc simply misses the cache.
+class ScanCache {
+public:
+    // Bump whenever BDMVTitle or the parser's output changes meaning
+    static constexpr uint16_t FormatVersion = 7;
+
+    // Returns 0 if the disc structure cannot be read
+    static uint64_t ComputeFingerprint(const fs::path& bdmvPath);
+
+    static bool Load(uint64_t fingerprint, std::vector<BDMVTitle>& titles);
+    // Only complete scans are stored: false if any title is not analyzed
+    static bool Store(uint64_t fingerprint, const std::vector<BDMVTitle>& titles);
+
+    static fs::path GetCacheDirectory();
+    static fs::path GetEntryPath(uint64_t fingerprint);
+};
@@ -0,0 +1,236 @@
+#include "scan_pool.h"
+#include <algorithm>
+#include <chrono>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// Identifies the pool and queue owned by the current worker thread
+thread_local const ScanPool* currentPool = nullptr;
+thread_local size_t currentQueue = 0;
+
+} // namespace
+
+ScanPool::ScanPool(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(2u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(&ScanPool::WorkerLoop, this, i);
+    }
+}
+
+ScanPool::~ScanPool() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+ScanPool& ScanPool::Instance() {
+    static ScanPool pool;
+    return pool;
+}
+
+size_t ScanPool::CurrentQueue() const {
+    return currentPool == this ? currentQueue : 0;
+}
+
+void ScanPool::Submit(Task task) {
+    // Workers push to their own queue; other threads spread work round-robin
+    size_t index = currentPool == this ? currentQueue : nextQueue++ % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        pending++;
+    }
+    wake.notify_one();
+}
+
+bool ScanPool::TakeTask(Task& task) {
+    size_t self = CurrentQueue();
+
+    // Own queue first, newest task first
+    {
+        WorkerQueue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+
+    // Otherwise steal the oldest task from another queue
+    for (size_t k = 1; !task && k < queues.size(); k++) {
+        WorkerQueue& victim = *queues[(self + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    pending--;
+    return true;
+}
+
+bool ScanPool::RunPendingTask() {
+    Task task;
+    if (!TakeTask(task)) {
+        return false;
+    }
+
+    // Tasks report their own errors; one failing must not take down a worker
+    try {
+        task();
+    } catch (...) {
+    }
+    return true;
+}
+
+void ScanPool::WorkerLoop(size_t index) {
+    currentPool = this;
+    currentQueue = index;
+
+    while (true) {
+        if (RunPendingTask()) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait(lock, [this]() { return stopping || pending > 0; });
+        if (stopping && pending == 0) {
+            return;
+        }
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    // Tasks reference the group, so never leave while any are still running
+    try {
+        Wait();
+    } catch (...) {
+    }
+}
+
+void TaskGroup::Run(ScanPool::Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        outstanding++;
+    }
+
+    pool.Submit([this, task = std::move(task)]() {
+        std::exception_ptr taskError;
+        try {
+            task();
+        } catch (...) {
+            taskError = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (taskError && !error) {
+            error = taskError;
+        }
+        if (--outstanding == 0) {
+            done.notify_all();
+        }
+    });
+}
+
+void TaskGroup::Wait() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (outstanding == 0) {
+                break;
+            }
+        }
+
+        // Help with queued work; if there is none, our tasks are running elsewhere
+        if (!pool.RunPendingTask()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait_for(lock, std::chrono::milliseconds(5), [this]() { return outstanding == 0; });
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error) {
+        std::exception_ptr firstError = error;
+        error = nullptr;
+        std::rethrow_exception(firstError);
+    }
+}
+
+void IOThrottle::Acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return available > 0; });
+    available--;
+}
+
+void IOThrottle::Release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        available++;
+    }
+    changed.notify_one();
+}
+
+std::string IOThrottle::GetDeviceKey(const fs::path& path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    if (ec) {
+        absolute = path;
+    }
+
+#ifdef _WIN32
+    // Drive letter or UNC server; all of a device's folders share one key
+    return absolute.root_name().string();
+#else
+    // No drive letters here; use the device of the nearest existing ancestor,
+    // so output paths that are not created yet still resolve
+    for (fs::path current = absolute; !current.empty(); current = current.parent_path()) {
+        struct stat info;
+        if (stat(current.c_str(), &info) == 0) {
+            return "dev:" + std::to_string(static_cast<unsigned long long>(info.st_dev));
+        }
+        if (current == current.parent_path()) {
+            break;
+        }
+    }
+    return absolute.root_path().string();
+#endif
+}
+
+std::shared_ptr<IOThrottle> IOThrottle::ForPath(const fs::path& path) {
+    static std::mutex registryMutex;
+    static std::map<std::string, std::shared_ptr<IOThrottle>> registry;
+
+    std::string key = GetDeviceKey(path);
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& throttle = registry[key];
+    if (!throttle) {
+        throttle = std::make_shared<IOThrottle>(DefaultLimit);
+    }
+    return throttle;
+}
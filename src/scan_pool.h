@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Work-stealing thread pool used for disc scanning. Each worker pops its own
+// queue LIFO and steals from the others FIFO, so a disc task that fans out
+// into playlist tasks keeps its children local while idle workers help out.
+class ScanPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ScanPool(size_t threadCount = 0);
+    ~ScanPool();
+
+    ScanPool(const ScanPool&) = delete;
+    ScanPool& operator=(const ScanPool&) = delete;
+
+    void Submit(Task task);
+
+    // Runs one queued task on the calling thread, if any. Used by TaskGroup::Wait
+    // so a worker waiting on its children keeps making progress.
+    bool RunPendingTask();
+
+    static ScanPool& Instance();
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerLoop(size_t index);
+    bool TakeTask(Task& task);
+    size_t CurrentQueue() const;
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> nextQueue{0};
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    size_t pending = 0;
+    bool stopping = false;
+};
+
+// Tracks a batch of tasks submitted to a ScanPool. Wait() helps run queued
+// work instead of blocking, so groups may be nested inside pool tasks.
+class TaskGroup {
+public:
+    explicit TaskGroup(ScanPool& pool) : pool(pool) {}
+    ~TaskGroup();
+
+    void Run(ScanPool::Task task);
+
+    // Blocks until every task has finished; rethrows the first task exception
+    void Wait();
+
+private:
+    ScanPool& pool;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t outstanding = 0;
+    std::exception_ptr error;
+};
+
+// Caps concurrent reads per underlying device so scanning many discs from one
+// spinning disk or network share does not thrash it.
+class IOThrottle {
+public:
+    static constexpr int DefaultLimit = 4;
+
+    explicit IOThrottle(int limit) : available(limit) {}
+
+    void Acquire();
+    void Release();
+
+    class Slot {
+    public:
+        explicit Slot(IOThrottle& throttle) : throttle(throttle) { throttle.Acquire(); }
+        ~Slot() { throttle.Release(); }
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+
+    private:
+        IOThrottle& throttle;
+    };
+
+    // Returns the shared throttle for the device holding `path`
+    static std::shared_ptr<IOThrottle> ForPath(const fs::path& path);
+    static std::string GetDeviceKey(const fs::path& path);
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    int available;
+};
@@ -0,0 +1,555 @@
+#include "ts_demuxer.h"
+#include "ts_packet_scan.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace {
+
+constexpr size_t ReadAlignment = 4096;
+constexpr size_t BufferUnit = 12288; // lcm(192, 4096): whole packets in whole alignment units
+constexpr uint16_t PATPid = 0x0000;
+constexpr uint16_t NullPid = 0x1FFF;
+constexpr size_t PidCount = 8192;
+
+uint64_t ReadTimestamp(const uint8_t* p) {
+    return (static_cast<uint64_t>((p[0] >> 1) & 0x07) << 30) |
+           (static_cast<uint64_t>(p[1]) << 22) |
+           (static_cast<uint64_t>(p[2] >> 1) << 15) |
+           (static_cast<uint64_t>(p[3]) << 7) |
+           (static_cast<uint64_t>(p[4]) >> 1);
+}
+
+} // namespace
+
+bool TSPacket::Parse(const uint8_t* sourcePacket, TSPacket& packet) {
+    const uint8_t* ts = sourcePacket + 4;
+    if (ts[0] != TSSyncByte) {
+        return false;
+    }
+
+    packet.data = sourcePacket;
+    packet.arrivalTime = ((sourcePacket[0] & 0x3F) << 24) | (sourcePacket[1] << 16) |
+                         (sourcePacket[2] << 8) | sourcePacket[3];
+    packet.hasError = (ts[1] & 0x80) != 0;
+    packet.payloadStart = (ts[1] & 0x40) != 0;
+    packet.pid = static_cast<uint16_t>(((ts[1] & 0x1F) << 8) | ts[2]);
+    packet.continuityCounter = ts[3] & 0x0F;
+
+    // adaptation_field_control: 1 = payload only, 2 = adaptation only, 3 = both
+    uint8_t adaptationControl = (ts[3] >> 4) & 0x03;
+    size_t payloadOffset = 4;
+    if (adaptationControl & 0x02) {
+        payloadOffset += 1 + ts[4];
+    }
+
+    if ((adaptationControl & 0x01) && payloadOffset < TSPacketSize) {
+        packet.payload = ts + payloadOffset;
+        packet.payloadSize = TSPacketSize - payloadOffset;
+    } else {
+        packet.payload = nullptr;
+        packet.payloadSize = 0;
+    }
+    return true;
+}
+
+M2TSReader::M2TSReader(size_t bufferSize) {
+    capacity = std::max(bufferSize, BufferUnit);
+    capacity -= capacity % BufferUnit;
+    buffer = static_cast<uint8_t*>(::operator new(capacity, std::align_val_t(ReadAlignment)));
+}
+
+M2TSReader::~M2TSReader() {
+    Close();
+    ::operator delete(buffer, std::align_val_t(ReadAlignment));
+}
+
+bool M2TSReader::Open(const fs::path& path, uint64_t offset, uint64_t length) {
+    Close();
+
+    if (!file.Open(path) || offset > file.Size()) {
+        Close();
+        return false;
+    }
+
+    bufferOffset = offset;
+    readOffset = offset;
+    remaining = length;
+    begin = 0;
+    end = 0;
+    bytesRead = 0;
+    resyncs = 0;
+    return true;
+}
+
+bool M2TSReader::Open(ClipPrefetcher& source, size_t index) {
+    Close();
+
+    if (!source.WaitOpened(index)) {
+        return false;
+    }
+
+    prefetcher = &source;
+    clipIndex = index;
+    bufferOffset = 0;
+    readOffset = 0;
+    remaining = UINT64_MAX;
+    begin = 0;
+    end = 0;
+    bytesRead = 0;
+    resyncs = 0;
+    return true;
+}
+
+void M2TSReader::Close() {
+    file.Close();
+    prefetcher = nullptr;
+    begin = 0;
+    end = 0;
+}
+
+bool M2TSReader::Refill() {
+    if ((!file.IsOpen() && !prefetcher) || remaining == 0) {
+        return false;
+    }
+
+    // Keep the partial packet at the tail, then fill the rest of the buffer
+    size_t leftover = end - begin;
+    if (leftover > 0) {
+        std::memmove(buffer, buffer + begin, leftover);
+    }
+    bufferOffset += begin;
+    begin = 0;
+    end = leftover;
+
+    size_t toRead = static_cast<size_t>(std::min<uint64_t>(capacity - leftover, remaining));
+    size_t got = 0;
+    if (prefetcher) {
+        // Prefetch chunks need not line up with the buffer; fill it as one read would
+        while (got < toRead) {
+            size_t count = prefetcher->Read(clipIndex, buffer + end + got, toRead - got);
+            if (count == 0) {
+                break;
+            }
+            got += count;
+        }
+    } else {
+        got = file.ReadAt(readOffset, buffer + end, toRead);
+    }
+    readOffset += got;
+    end += got;
+    remaining -= got;
+    bytesRead += got;
+
+    if (got < toRead) {
+        remaining = 0;
+    }
+    return got > 0;
+}
+
+bool M2TSReader::Resync() {
+    // Look for two consecutive sync bytes at the TS offset of a source packet
+    while (true) {
+        while (begin + 2 * M2TSPacketSize <= end) {
+            if (buffer[begin + 4] == TSSyncByte && buffer[begin + 4 + M2TSPacketSize] == TSSyncByte) {
+                return true;
+            }
+            begin++;
+        }
+
+        if (!Refill()) {
+            // Trust a single sync byte at the very end of the input
+            while (begin + M2TSPacketSize <= end) {
+                if (buffer[begin + 4] == TSSyncByte) {
+                    return true;
+                }
+                begin++;
+            }
+            return false;
+        }
+    }
+}
+
+bool M2TSReader::NextPacket(TSPacket& packet) {
+    if (end - begin < M2TSPacketSize) {
+        Refill();
+        if (end - begin < M2TSPacketSize) {
+            return false;
+        }
+    }
+
+    if (buffer[begin + 4] != TSSyncByte) {
+        resyncs++;
+        if (!Resync()) {
+            return false;
+        }
+    }
+
+    TSPacket::Parse(buffer + begin, packet);
+    packet.offset = bufferOffset + begin;
+    begin += M2TSPacketSize;
+    return true;
+}
+
+size_t M2TSReader::NextBlock(const uint8_t*& data, size_t maxPackets) {
+    if (end - begin < M2TSPacketSize) {
+        Refill();
+        if (end - begin < M2TSPacketSize) {
+            return 0;
+        }
+    }
+
+    size_t count = std::min((end - begin) / M2TSPacketSize, maxPackets);
+    data = buffer + begin;
+    begin += count * M2TSPacketSize;
+    return count;
+}
+
+void M2TSReader::PutBack(size_t packets) {
+    begin -= std::min(packets * M2TSPacketSize, begin);
+}
+
+bool PESHeader::Parse(const uint8_t* data, size_t size, PESHeader& header) {
+    if (size < 6 || data[0] != 0x00 || data[1] != 0x00 || data[2] != 0x01) {
+        return false;
+    }
+
+    header.streamId = data[3];
+    header.packetLength = static_cast<uint16_t>((data[4] << 8) | data[5]);
+    header.hasPts = false;
+    header.hasDts = false;
+    header.headerSize = 6;
+
+    // padding_stream, private_stream_2 and friends carry no optional header
+    switch (header.streamId) {
+        case 0xBC: case 0xBE: case 0xBF: case 0xF0: case 0xF1: case 0xF2: case 0xF8: case 0xFF:
+            return true;
+    }
+
+    if (size < 9) {
+        return false;
+    }
+
+    uint8_t ptsDtsFlags = data[7] >> 6;
+    header.headerSize = 9 + data[8];
+    if (header.headerSize > size) {
+        return false;
+    }
+
+    if ((ptsDtsFlags & 0x02) && header.headerSize >= 14) {
+        header.hasPts = true;
+        header.pts = ReadTimestamp(data + 9);
+    }
+    if (ptsDtsFlags == 0x03 && header.headerSize >= 19) {
+        header.hasDts = true;
+        header.dts = ReadTimestamp(data + 14);
+    }
+    return true;
+}
+
+TSDemuxer::TSDemuxer(PESCallback callback)
+    : onPES(std::move(callback)), pesBuffers(PidCount), pidFlags(PidCount, 0) {
+}
+
+void TSDemuxer::SelectPids(const std::vector<uint16_t>& pids) {
+    for (auto& flags : pidFlags) {
+        flags &= ~SelectedPid;
+    }
+    for (uint16_t pid : pids) {
+        pidFlags[pid & 0x1FFF] |= SelectedPid;
+    }
+    hasSelection = true;
+}
+
+bool TSDemuxer::IsSelected(uint16_t pid) const {
+    return hasSelection ? (pidFlags[pid] & SelectedPid) != 0 : (pidFlags[pid] & StreamPid) != 0;
+}
+
+bool TSDemuxer::WantsPid(uint16_t pid) const {
+    return pid == PATPid || (pid != NullPid && ((pidFlags[pid] & PmtPid) || IsSelected(pid)));
+}
+
+bool TSDemuxer::HasProgramMap() const {
+    return !programs.empty() &&
+           std::all_of(programs.begin(), programs.end(), [](const TSProgram& p) { return p.hasMap; });
+}
+
+void TSDemuxer::Push(const TSPacket& packet) {
+    if (packet.hasError || packet.pid == NullPid || !packet.payload) {
+        return;
+    }
+
+    if (packet.pid == PATPid || (pidFlags[packet.pid] & PmtPid)) {
+        PushSection(packet);
+        return;
+    }
+
+    if (!IsSelected(packet.pid)) {
+        return;
+    }
+
+    PESBuffer& pes = pesBuffers[packet.pid];
+
+    // Drop duplicates; a gap in the continuity counter invalidates the PES in progress
+    if (pes.lastContinuity >= 0) {
+        if (packet.continuityCounter == pes.lastContinuity) {
+            return;
+        }
+        if (packet.continuityCounter != ((pes.lastContinuity + 1) & 0x0F)) {
+            pes.active = false; // Even if this packet starts the next PES
+        }
+    }
+    pes.lastContinuity = packet.continuityCounter;
+
+    if (packet.payloadStart) {
+        if (pes.active) {
+            EmitPES(packet.pid, pes);
+        }
+        pes.data.assign(packet.payload, packet.payload + packet.payloadSize);
+        pes.sourceOffset = packet.offset;
+        pes.active = true;
+    } else if (pes.active) {
+        pes.data.insert(pes.data.end(), packet.payload, packet.payload + packet.payloadSize);
+    } else {
+        return;
+    }
+
+    // Bounded PES packets can be delivered as soon as they are complete
+    if (pes.data.size() >= 6) {
+        size_t packetLength = (pes.data[4] << 8) | pes.data[5];
+        if (packetLength != 0 && pes.data.size() >= 6 + packetLength) {
+            EmitPES(packet.pid, pes);
+        }
+    }
+}
+
+void TSDemuxer::Flush() {
+    for (size_t pid = 0; pid < pesBuffers.size(); pid++) {
+        PESBuffer& pes = pesBuffers[pid];
+        if (!pes.active) {
+            continue;
+        }
+        // A bounded PES still short of its length was cut off by the end of
+        // the read (a play item's byte range ends at the next entry point)
+        size_t packetLength = pes.data.size() >= 6 ? (pes.data[4] << 8) | pes.data[5] : 0;
+        if (packetLength != 0 && pes.data.size() < 6 + packetLength) {
+            pes.active = false;
+            continue;
+        }
+        EmitPES(static_cast<uint16_t>(pid), pes);
+    }
+}
+
+void TSDemuxer::EmitPES(uint16_t pid, PESBuffer& buffer) {
+    buffer.active = false;
+
+    PESPacket pes;
+    pes.pid = pid;
+    pes.sourceOffset = buffer.sourceOffset;
+    if (!PESHeader::Parse(buffer.data.data(), buffer.data.size(), pes.header)) {
+        return;
+    }
+
+    size_t end = buffer.data.size();
+    if (pes.header.packetLength != 0) {
+        end = std::min(end, static_cast<size_t>(6 + pes.header.packetLength));
+    }
+    if (end < pes.header.headerSize) {
+        return;
+    }
+
+    pes.data = buffer.data.data() + pes.header.headerSize;
+    pes.size = end - pes.header.headerSize;
+    if (onPES) {
+        onPES(pes);
+    }
+}
+
+void TSDemuxer::PushSection(const TSPacket& packet) {
+    SectionBuffer& section = sections[packet.pid];
+    const uint8_t* payload = packet.payload;
+    size_t size = packet.payloadSize;
+
+    if (!packet.payloadStart) {
+        if (section.active) {
+            section.data.insert(section.data.end(), payload, payload + size);
+            FinishSection(packet.pid, section);
+        }
+        return;
+    }
+
+    // pointer_field: bytes before it finish the previous section
+    size_t pointer = size > 0 ? payload[0] : 0;
+    if (size == 0 || 1 + pointer > size) {
+        section.active = false;
+        return;
+    }
+    if (section.active) {
+        section.data.insert(section.data.end(), payload + 1, payload + 1 + pointer);
+        FinishSection(packet.pid, section);
+        section.active = false;
+    }
+
+    // Then any number of sections, the last of which may run on into the
+    // next packets, up to 0xFF stuffing
+    size_t position = 1 + pointer;
+    while (position < size && payload[position] != 0xFF) {
+        size_t available = size - position;
+        if (available >= 3) {
+            size_t sectionSize = 3 + (((payload[position + 1] & 0x0F) << 8) | payload[position + 2]);
+            if (available >= sectionSize) {
+                ParseSection(packet.pid, payload + position, sectionSize);
+                position += sectionSize;
+                continue;
+            }
+        }
+        section.data.assign(payload + position, payload + size);
+        section.active = true;
+        break;
+    }
+}
+
+void TSDemuxer::FinishSection(uint16_t pid, SectionBuffer& section) {
+    if (section.data.size() < 3) {
+        return;
+    }
+    size_t sectionSize = 3 + (((section.data[1] & 0x0F) << 8) | section.data[2]);
+    if (section.data.size() >= sectionSize) {
+        section.active = false;
+        ParseSection(pid, section.data.data(), sectionSize);
+    }
+}
+
+void TSDemuxer::ParseSection(uint16_t pid, const uint8_t* section, size_t size) {
+    // The CRC over a whole section, CRC_32 field included, is zero
+    if (size < 12 || MpegCRC32(section, size) != 0) {
+        return;
+    }
+
+    if (pid == PATPid && section[0] == 0x00) {
+        ParsePAT(section, size);
+    } else if (section[0] == 0x02) {
+        ParsePMT(section, size);
+    }
+}
+
+void TSDemuxer::ParsePAT(const uint8_t* section, size_t size) {
+    if (!programs.empty()) {
+        return;
+    }
+
+    // 8-byte section header, 4-byte program entries, 4-byte CRC
+    for (size_t pos = 8; pos + 4 <= size - 4; pos += 4) {
+        uint16_t programNumber = static_cast<uint16_t>((section[pos] << 8) | section[pos + 1]);
+        uint16_t pid = static_cast<uint16_t>(((section[pos + 2] & 0x1F) << 8) | section[pos + 3]);
+        if (programNumber == 0) {
+            continue; // network PID
+        }
+
+        TSProgram program;
+        program.programNumber = programNumber;
+        program.pmtPid = pid;
+        programs.push_back(program);
+        pidFlags[pid] |= PmtPid;
+    }
+}
+
+void TSDemuxer::ParsePMT(const uint8_t* section, size_t size) {
+    uint16_t programNumber = static_cast<uint16_t>((section[3] << 8) | section[4]);
+    auto program = std::find_if(programs.begin(), programs.end(),
+        [&](const TSProgram& p) { return p.programNumber == programNumber; });
+    if (program == programs.end() || program->hasMap) {
+        return;
+    }
+
+    program->pcrPid = static_cast<uint16_t>(((section[8] & 0x1F) << 8) | section[9]);
+    size_t programInfoLength = ((section[10] & 0x0F) << 8) | section[11];
+    size_t pos = 12 + programInfoLength;
+    size_t end = size - 4;
+
+    while (pos + 5 <= end) {
+        TSStream stream;
+        stream.streamType = section[pos];
+        stream.pid = static_cast<uint16_t>(((section[pos + 1] & 0x1F) << 8) | section[pos + 2]);
+        size_t infoLength = ((section[pos + 3] & 0x0F) << 8) | section[pos + 4];
+        pos += 5;
+
+        size_t infoEnd = std::min(pos + infoLength, end);
+        for (size_t d = pos; d + 2 <= infoEnd; d += 2 + section[d + 1]) {
+            // ISO_639_language_descriptor
+            if (section[d] == 0x0A && section[d + 1] >= 3 && d + 5 <= infoEnd) {
+                stream.language.assign(reinterpret_cast<const char*>(section + d + 2), 3);
+            }
+        }
+        pos = infoEnd;
+
+        program->streams.push_back(stream);
+        pidFlags[stream.pid] |= StreamPid;
+    }
+
+    program->hasMap = true;
+}
+
+bool TSDemuxer::Demux(M2TSReader& reader, TSDemuxer& demuxer, bool inventoryOnly) {
+    TSPacket packet;
+    std::vector<uint16_t> pids;
+    const uint8_t* block = nullptr;
+
+    // Most packets belong to streams nobody asked for. Pull PIDs for a whole
+    // block at once and only decode the packets the demuxer will use.
+    while (size_t count = reader.NextBlock(block, 4096)) {
+        uint64_t blockOffset = reader.Tell() - count * M2TSPacketSize;
+        pids.resize(count);
+        size_t valid = ExtractPids(block, count, pids.data());
+
+        for (size_t i = 0; i < valid; i++) {
+            if (!demuxer.WantsPid(pids[i])) {
+                continue;
+            }
+            TSPacket::Parse(block + i * M2TSPacketSize, packet);
+            packet.offset = blockOffset + i * M2TSPacketSize;
+            demuxer.Push(packet);
+            if (demuxer.Stopped()) {
+                return false;
+            }
+            if (inventoryOnly && demuxer.HasProgramMap()) {
+                return true;
+            }
+        }
+
+        if (valid < count) {
+            // Lost sync; let NextPacket find the next packet boundary
+            reader.PutBack(count - valid);
+            if (!reader.NextPacket(packet)) {
+                break;
+            }
+            demuxer.Push(packet);
+            if (demuxer.Stopped()) {
+                return false;
+            }
+        }
+    }
+
+    demuxer.Flush();
+    return demuxer.HasProgramMap();
+}
+
+uint32_t MpegCRC32(const uint8_t* data, size_t size) {
+    static const auto table = []() {
+        std::vector<uint32_t> entries(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i << 24;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+            }
+            entries[i] = crc;
+        }
+        return entries;
+    }();
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc << 8) ^ table[((crc >> 24) ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include "clip_prefetcher.h"
+#include "disc_filesystem.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// BDAV source packets: a 4-byte TP_extra_header followed by a 188-byte TS packet
+constexpr size_t M2TSPacketSize = 192;
+constexpr size_t TSPacketSize = 188;
+constexpr uint8_t TSSyncByte = 0x47;
+
+// View of one source packet inside the reader's buffer. Pointers stay valid
+// until the next call that refills the buffer.
+struct TSPacket {
+    const uint8_t* data = nullptr;    // Start of the 192-byte source packet
+    uint64_t offset = 0;              // File offset of the source packet
+    uint32_t arrivalTime = 0;         // 30-bit arrival time stamp (27MHz)
+    uint16_t pid = 0;
+    bool payloadStart = false;
+    bool hasError = false;
+    uint8_t continuityCounter = 0;
+    const uint8_t* payload = nullptr;
+    size_t payloadSize = 0;
+
+    // Decodes the packet header; returns false if the sync byte is missing
+    static bool Parse(const uint8_t* sourcePacket, TSPacket& packet);
+};
+
+// Sequential M2TS reader using large aligned positioned reads straight into
+// its own buffer. The file may be on disk or inside a disc image (DiscFile),
+// or come from a ClipPrefetcher that reads the title's clips ahead.
+// Hands out whole packets as views.
+class M2TSReader {
+public:
+    static constexpr size_t DefaultBufferSize = M2TSPacketSize * 32768; // 6 MiB, 4K-aligned
+
+    explicit M2TSReader(size_t bufferSize = DefaultBufferSize);
+    ~M2TSReader();
+
+    M2TSReader(const M2TSReader&) = delete;
+    M2TSReader& operator=(const M2TSReader&) = delete;
+
+    // Reads [offset, offset + length) of the file; offset should be packet-aligned
+    bool Open(const fs::path& path, uint64_t offset = 0, uint64_t length = UINT64_MAX);
+    // Reads all of clip `index` from the prefetcher, which must outlive the reader
+    bool Open(ClipPrefetcher& source, size_t index);
+    void Close();
+
+    bool NextPacket(TSPacket& packet);
+
+    // Returns a run of whole source packets from the buffer (count * 192 bytes)
+    // and consumes them. Returns 0 at end of input.
+    size_t NextBlock(const uint8_t*& data, size_t maxPackets = SIZE_MAX);
+
+    // Returns the last `packets` packets of the previous NextBlock unconsumed
+    void PutBack(size_t packets);
+
+    // File offset of the next packet NextPacket or NextBlock will return
+    uint64_t Tell() const { return bufferOffset + begin; }
+    uint64_t BytesRead() const { return bytesRead; }
+    uint64_t ResyncCount() const { return resyncs; }
+
+private:
+    bool Refill();
+    bool Resync();
+
+    DiscFile file;
+    ClipPrefetcher* prefetcher = nullptr;
+    size_t clipIndex = 0;
+    uint64_t readOffset = 0;   // File offset of the next Refill
+    uint8_t* buffer = nullptr;
+    size_t capacity;
+    size_t begin = 0;
+    size_t end = 0;
+    uint64_t bufferOffset = 0; // File offset of buffer[0]
+    uint64_t remaining = 0;
+    uint64_t bytesRead = 0;
+    uint64_t resyncs = 0;
+};
+
+struct TSStream {
+    uint16_t pid = 0;
+    uint8_t streamType = 0; // PMT stream_type, same values as the CLPI coding type
+    std::string language;   // From an ISO 639 descriptor, if present
+};
+
+struct TSProgram {
+    uint16_t programNumber = 0;
+    uint16_t pmtPid = 0;
+    uint16_t pcrPid = 0;
+    bool hasMap = false;
+    std::vector<TSStream> streams;
+};
+
+struct PESHeader {
+    uint8_t streamId = 0;
+    uint16_t packetLength = 0;
+    bool hasPts = false;
+    bool hasDts = false;
+    uint64_t pts = 0; // 90kHz
+    uint64_t dts = 0; // 90kHz
+    size_t headerSize = 0;
+
+    // Parses a PES header; returns false if the start code is missing or truncated
+    static bool Parse(const uint8_t* data, size_t size, PESHeader& header);
+};
+
+// A reassembled PES packet. `data` points into the demuxer's per-PID buffer
+// and is only valid for the duration of the callback.
+struct PESPacket {
+    uint16_t pid = 0;
+    PESHeader header;
+    const uint8_t* data = nullptr; // Elementary stream payload after the PES header
+    size_t size = 0;
+    uint64_t sourceOffset = 0;     // Byte offset of the packet that started this PES
+};
+
+// Tracks PAT/PMT and reassembles PES packets for the PIDs it is asked to keep.
+class TSDemuxer {
+public:
+    using PESCallback = std::function<void(const PESPacket&)>;
+
+    explicit TSDemuxer(PESCallback callback);
+
+    // Restricts PES reassembly to these PIDs; by default every PMT stream is kept
+    void SelectPids(const std::vector<uint16_t>& pids);
+
+    void Push(const TSPacket& packet);
+    void Flush();
+
+    // Makes Demux() return early (false) after the current packet; for use
+    // from the PES callback when the consumer gives up
+    void Stop() { stopped = true; }
+    bool Stopped() const { return stopped; }
+
+    // True if Push would do anything with this PID, so callers scanning raw
+    // PIDs can skip parsing the rest of the packets
+    bool WantsPid(uint16_t pid) const;
+
+    const std::vector<TSProgram>& Programs() const { return programs; }
+    bool HasProgramMap() const;
+
+    // Runs a reader to completion (or until PAT/PMT are known if inventoryOnly)
+    static bool Demux(M2TSReader& reader, TSDemuxer& demuxer, bool inventoryOnly = false);
+
+private:
+    struct SectionBuffer {
+        std::vector<uint8_t> data;
+        bool active = false;
+    };
+
+    struct PESBuffer {
+        std::vector<uint8_t> data;
+        uint64_t sourceOffset = 0;
+        int lastContinuity = -1;
+        bool active = false;
+    };
+
+    // Per-PID flags, indexed by the 13-bit PID
+    enum PidFlag : uint8_t {
+        PmtPid = 1,
+        StreamPid = 2,
+        SelectedPid = 4
+    };
+
+    void PushSection(const TSPacket& packet);
+    // Parses a buffered section once all of it has arrived
+    void FinishSection(uint16_t pid, SectionBuffer& section);
+    void ParseSection(uint16_t pid, const uint8_t* section, size_t size);
+    void ParsePAT(const uint8_t* section, size_t size);
+    void ParsePMT(const uint8_t* section, size_t size);
+    void EmitPES(uint16_t pid, PESBuffer& buffer);
+    bool IsSelected(uint16_t pid) const;
+
+    PESCallback onPES;
+    std::vector<TSProgram> programs;
+    std::map<uint16_t, SectionBuffer> sections;
+    std::vector<PESBuffer> pesBuffers;
+    std::vector<uint8_t> pidFlags;
+    bool hasSelection = false;
+    bool stopped = false;
+};
+
+uint32_t MpegCRC32(const uint8_t* data, size_t size);
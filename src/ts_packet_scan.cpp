@@ -0,0 +1,178 @@
+#include "ts_packet_scan.h"
+#include "ts_demuxer.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TS_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(TS_SCAN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TS_SCAN_AVX2 1
+#define TS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+inline uint32_t LoadU32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+#ifdef TS_SCAN_X86
+
+// Four packets per step. Each 32-bit lane holds bytes 4..7 of a source packet
+// (sync, PID high, PID low, flags) in little-endian order.
+size_t ExtractPidsSSE2(const uint8_t* block, size_t count, uint16_t* pids) {
+    const __m128i syncMask = _mm_set1_epi32(0xFF);
+    const __m128i syncByte = _mm_set1_epi32(0x47);
+    const __m128i pidHighMask = _mm_set1_epi32(0x1F00);
+    const __m128i pidLowMask = _mm_set1_epi32(0xFF);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint8_t* p = block + i * 192 + 4;
+        __m128i header = _mm_set_epi32(static_cast<int>(LoadU32(p + 576)), static_cast<int>(LoadU32(p + 384)),
+                                       static_cast<int>(LoadU32(p + 192)), static_cast<int>(LoadU32(p)));
+
+        __m128i sync = _mm_cmpeq_epi32(_mm_and_si128(header, syncMask), syncByte);
+        if (_mm_movemask_epi8(sync) != 0xFFFF) {
+            break;
+        }
+
+        // PID = (byte1 & 0x1F) << 8 | byte2
+        __m128i high = _mm_and_si128(header, pidHighMask);
+        __m128i low = _mm_and_si128(_mm_srli_epi32(header, 16), pidLowMask);
+        __m128i pid = _mm_or_si128(high, low);
+
+        // PIDs fit in 13 bits, so signed saturation never kicks in
+        __m128i packed = _mm_packs_epi32(pid, pid);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(pids + i), packed);
+    }
+
+    return i + ExtractPidsScalar(block + i * 192, count - i, pids + i);
+}
+
+#endif
+
+#ifdef TS_SCAN_AVX2
+
+// Eight packets per step using a gather over the 192-byte stride
+TS_TARGET_AVX2
+size_t ExtractPidsAVX2(const uint8_t* block, size_t count, uint16_t* pids) {
+    const __m256i offsets = _mm256_setr_epi32(4, 196, 388, 580, 772, 964, 1156, 1348);
+    const __m256i syncMask = _mm256_set1_epi32(0xFF);
+    const __m256i syncByte = _mm256_set1_epi32(0x47);
+    const __m256i pidHighMask = _mm256_set1_epi32(0x1F00);
+    const __m256i pidLowMask = _mm256_set1_epi32(0xFF);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int* base = reinterpret_cast<const int*>(block + i * 192);
+        __m256i header = _mm256_i32gather_epi32(base, offsets, 1);
+
+        __m256i sync = _mm256_cmpeq_epi32(_mm256_and_si256(header, syncMask), syncByte);
+        if (_mm256_movemask_epi8(sync) != -1) {
+            break;
+        }
+
+        __m256i high = _mm256_and_si256(header, pidHighMask);
+        __m256i low = _mm256_and_si256(_mm256_srli_epi32(header, 16), pidLowMask);
+        __m256i pid = _mm256_or_si256(high, low);
+
+        // packus works per 128-bit lane; gather the two low quadwords back together
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(pid, pid), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pids + i), _mm256_castsi256_si128(packed));
+    }
+
+    return i + ExtractPidsSSE2(block + i * 192, count - i, pids + i);
+}
+
+#endif
+
+const PidKernel& GetKernel() {
+    static const PidKernel kernel = GetPidKernels().back();
+    return kernel;
+}
+
+} // namespace
+
+std::vector<PidKernel> GetPidKernels() {
+    std::vector<PidKernel> kernels = {{ExtractPidsScalar, "scalar"}};
+#ifdef TS_SCAN_X86
+    kernels.push_back({ExtractPidsSSE2, "sse2"});
+#endif
+#ifdef TS_SCAN_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({ExtractPidsAVX2, "avx2"});
+    }
+#endif
+    return kernels;
+}
+
+size_t ExtractPidsScalar(const uint8_t* block, size_t count, uint16_t* pids) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* ts = block + i * 192 + 4;
+        if (ts[0] != TSSyncByte) {
+            return i;
+        }
+        pids[i] = static_cast<uint16_t>(((ts[1] & 0x1F) << 8) | ts[2]);
+    }
+    return count;
+}
+
+size_t ExtractPids(const uint8_t* block, size_t count, uint16_t* pids) {
+    return GetKernel().extract(block, count, pids);
+}
+
+const char* GetPidKernelName() {
+    return GetKernel().name;
+}
+
+PidPacketIndex::PidPacketIndex(const std::vector<uint16_t>& pids)
+    : packets(8192), wanted(8192, pids.empty()) {
+    for (uint16_t pid : pids) {
+        wanted[pid & 0x1FFF] = true;
+    }
+}
+
+size_t PidPacketIndex::AddBlock(const uint8_t* block, size_t count, uint64_t firstPacket) {
+    if (scratch.size() < count) {
+        scratch.resize(count);
+    }
+
+    size_t valid = ExtractPids(block, count, scratch.data());
+    for (size_t i = 0; i < valid; i++) {
+        uint16_t pid = scratch[i];
+        if (wanted[pid]) {
+            packets[pid].push_back(firstPacket + i);
+        }
+    }
+    totalPackets += valid;
+    return valid;
+}
+
+void PidPacketIndex::AddReader(M2TSReader& reader) {
+    uint64_t start = reader.Tell();
+    const uint8_t* block = nullptr;
+
+    while (size_t count = reader.NextBlock(block)) {
+        uint64_t firstPacket = (reader.Tell() - start) / M2TSPacketSize - count;
+        size_t valid = AddBlock(block, count, firstPacket);
+        if (valid == count) {
+            continue;
+        }
+
+        // Hand the rest back and let the reader resync on the bad packet
+        reader.PutBack(count - valid);
+        TSPacket packet;
+        if (!reader.NextPacket(packet)) {
+            break;
+        }
+        if (wanted[packet.pid]) {
+            packets[packet.pid].push_back((packet.offset - start) / M2TSPacketSize);
+        }
+        totalPackets++;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class M2TSReader;
+
+// Block kernels over runs of 192-byte source packets. Each validates the sync
+// byte at the TP_extra_header offset and extracts the 13-bit PID of every
+// packet. They return the index of the first packet that is out of sync, or
+// `count` when the whole block is aligned; `pids` is filled up to that index.
+size_t ExtractPids(const uint8_t* block, size_t count, uint16_t* pids);
+size_t ExtractPidsScalar(const uint8_t* block, size_t count, uint16_t* pids);
+
+// Name of the kernel ExtractPids dispatches to on this CPU ("avx2", "sse2", "scalar")
+const char* GetPidKernelName();
+
+struct PidKernel {
+    size_t (*extract)(const uint8_t* block, size_t count, uint16_t* pids);
+    const char* name;
+};
+
+// Every kernel this CPU can run, scalar first and the one ExtractPids uses
+// last; for benchmarking and checking the vector kernels against the scalar loop
+std::vector<PidKernel> GetPidKernels();
+
+// Builds per-PID lists of packet numbers for a set of PIDs, e.g. the PIDs a
+// title's STN_table lists for a clip.
+class PidPacketIndex {
+public:
+    // An empty list indexes every PID
+    explicit PidPacketIndex(const std::vector<uint16_t>& pids = {});
+
+    // Indexes a block whose first packet is `firstPacket`; returns the number
+    // of packets consumed before an out-of-sync packet, like ExtractPids
+    size_t AddBlock(const uint8_t* block, size_t count, uint64_t firstPacket);
+
+    // Indexes a whole reader; packets after a sync loss are recovered by the reader
+    void AddReader(M2TSReader& reader);
+
+    const std::vector<uint64_t>& Packets(uint16_t pid) const { return packets[pid & 0x1FFF]; }
+    uint64_t PacketCount() const { return totalPackets; }
+
+private:
+    std::vector<std::vector<uint64_t>> packets;
+    std::vector<bool> wanted;
+    std::vector<uint16_t> scratch;
+    uint64_t totalPackets = 0;
+};
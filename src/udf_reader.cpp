@@ -0,0 +1,531 @@
+#include "udf_reader.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+// ECMA-167 descriptor tag identifiers
+constexpr uint16_t TagAnchorVolumeDescriptorPointer = 2;
+constexpr uint16_t TagPartitionDescriptor = 5;
+constexpr uint16_t TagLogicalVolumeDescriptor = 6;
+constexpr uint16_t TagTerminatingDescriptor = 8;
+constexpr uint16_t TagFileSetDescriptor = 256;
+constexpr uint16_t TagFileIdentifierDescriptor = 257;
+constexpr uint16_t TagAllocationExtentDescriptor = 258;
+constexpr uint16_t TagFileEntry = 261;
+constexpr uint16_t TagExtendedFileEntry = 266;
+
+constexpr uint32_t AnchorSector = 256;
+constexpr uint8_t FileTypeDirectory = 4;
+constexpr uint8_t FileTypeMetadata = 250;
+constexpr uint64_t MaxDirectorySize = 64 * 1024 * 1024;
+
+// UDF is little-endian throughout, unlike the BDMV files it carries
+uint16_t U16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t U32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t U64(const uint8_t* p) {
+    return static_cast<uint64_t>(U32(p)) | (static_cast<uint64_t>(U32(p + 4)) << 32);
+}
+
+bool TagChecksumValid(const uint8_t* tag) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 16; i++) {
+        if (i != 4) {
+            sum = static_cast<uint8_t>(sum + tag[i]);
+        }
+    }
+    return sum == tag[4];
+}
+
+void AppendUtf8(std::string& out, uint32_t c) {
+    if (c < 0x80) {
+        out += static_cast<char>(c);
+    } else if (c < 0x800) {
+        out += static_cast<char>(0xC0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+        out += static_cast<char>(0xE0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+// OSTA compressed unicode: a compression ID byte, then 8- or 16-bit characters
+std::string DecodeName(const uint8_t* data, size_t length) {
+    std::string name;
+    if (length == 0) {
+        return name;
+    }
+    if (data[0] == 8) {
+        for (size_t i = 1; i < length; i++) {
+            AppendUtf8(name, data[i]);
+        }
+    } else if (data[0] == 16) {
+        for (size_t i = 1; i + 1 < length; i += 2) {
+            AppendUtf8(name, static_cast<uint32_t>((data[i] << 8) | data[i + 1]));
+        }
+    }
+    return name;
+}
+
+std::string UpperCase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return text;
+}
+
+std::vector<std::string> SplitPath(const std::string& path) {
+    std::vector<std::string> parts;
+    std::string part;
+    for (char c : path) {
+        if (c == '/' || c == '\\') {
+            if (!part.empty()) {
+                parts.push_back(part);
+            }
+            part.clear();
+        } else {
+            part += c;
+        }
+    }
+    if (!part.empty()) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+} // namespace
+
+bool UdfImage::Open(const fs::path& path, std::string& error) {
+    imagePath = path;
+    file = std::make_shared<RandomAccessFile>();
+    if (!file->Open(path)) {
+        error = "cannot open " + path.string();
+        return false;
+    }
+
+    // The anchor sits at sector 256, with copies at the end of the volume
+    std::vector<uint8_t> anchor;
+    uint64_t sectors = file->Size() / SectorSize;
+    bool anchorFound = false;
+    for (uint64_t sector : {uint64_t(AnchorSector), sectors - 1, sectors - 1 - AnchorSector}) {
+        if (sector < sectors && ReadDescriptor(sector * SectorSize, TagAnchorVolumeDescriptorPointer, anchor)) {
+            anchorFound = true;
+            break;
+        }
+    }
+    if (!anchorFound) {
+        error = "no UDF anchor (not a Blu-ray image?)";
+        return false;
+    }
+
+    // Main volume descriptor sequence, falling back to the reserve copy
+    std::vector<uint8_t> logicalVolume;
+    for (size_t sequence = 0; sequence < 2 && logicalVolume.empty(); sequence++) {
+        uint32_t length = U32(anchor.data() + 16 + sequence * 8);
+        uint32_t location = U32(anchor.data() + 20 + sequence * 8);
+        partitions.clear();
+
+        for (uint32_t i = 0; i < length / SectorSize; i++) {
+            std::vector<uint8_t> descriptor;
+            if (!ReadDescriptor(static_cast<uint64_t>(location + i) * SectorSize, 0, descriptor)) {
+                break;
+            }
+            uint16_t tag = U16(descriptor.data());
+            if (tag == TagTerminatingDescriptor) {
+                break;
+            }
+            if (tag == TagPartitionDescriptor) {
+                Partition partition;
+                partition.number = U16(descriptor.data() + 22);
+                partition.start = U32(descriptor.data() + 188);
+                partition.length = U32(descriptor.data() + 192);
+                partitions.push_back(partition);
+            } else if (tag == TagLogicalVolumeDescriptor) {
+                logicalVolume = descriptor;
+            }
+        }
+    }
+    if (logicalVolume.empty() || partitions.empty()) {
+        error = "incomplete UDF volume descriptor sequence";
+        return false;
+    }
+
+    blockSize = U32(logicalVolume.data() + 212);
+    if (blockSize != SectorSize) {
+        error = "unsupported UDF block size " + std::to_string(blockSize);
+        return false;
+    }
+
+    // Partition maps: type 1 names a physical partition, type 2 a virtual,
+    // sparable or metadata one. BD-ROM uses type 1 plus metadata.
+    uint32_t mapCount = U32(logicalVolume.data() + 268);
+    size_t position = 440;
+    for (uint32_t i = 0; i < mapCount; i++) {
+        if (position + 2 > logicalVolume.size()) {
+            error = "truncated partition maps";
+            return false;
+        }
+        const uint8_t* map = logicalVolume.data() + position;
+        uint8_t type = map[0];
+        uint8_t length = map[1];
+        if (length < 6 || position + length > logicalVolume.size()) {
+            error = "bad partition map";
+            return false;
+        }
+
+        PartitionMap entry;
+        if (type == 1) {
+            entry.partitionNumber = U16(map + 4);
+        } else if (type == 2 && length >= 64) {
+            std::string identifier(reinterpret_cast<const char*>(map + 5), 23);
+            identifier = identifier.c_str();
+            if (identifier != "*UDF Metadata Partition") {
+                error = "unsupported UDF partition type " + identifier;
+                return false;
+            }
+            entry.partitionNumber = U16(map + 38);
+            entry.isMetadata = true;
+        } else {
+            error = "unsupported UDF partition map type " + std::to_string(type);
+            return false;
+        }
+        partitionMaps.push_back(entry);
+        position += length;
+    }
+
+    // The metadata partition is the data of the metadata file, which lives in
+    // the physical partition; the mirror copy is the fallback
+    for (size_t i = 0; i < partitionMaps.size(); i++) {
+        if (!partitionMaps[i].isMetadata) {
+            continue;
+        }
+        const uint8_t* map = logicalVolume.data() + 440;
+        for (size_t j = 0; j < i; j++) {
+            map += map[1];
+        }
+
+        // Short ads in the metadata file are relative to the physical partition
+        uint16_t physicalRef = UINT16_MAX;
+        for (size_t j = 0; j < partitionMaps.size(); j++) {
+            if (!partitionMaps[j].isMetadata && partitionMaps[j].partitionNumber == partitionMaps[i].partitionNumber) {
+                physicalRef = static_cast<uint16_t>(j);
+            }
+        }
+        if (physicalRef == UINT16_MAX) {
+            error = "metadata partition without a physical partition";
+            return false;
+        }
+
+        bool loaded = false;
+        for (uint32_t location : {U32(map + 40), U32(map + 44)}) {
+            UdfEntry metadataFile;
+            if (location != UINT32_MAX && ReadFileEntry({location, physicalRef}, false, metadataFile) &&
+                !metadataFile.extents.empty()) {
+                partitionMaps[i].metadataExtents = metadataFile.extents;
+                loaded = true;
+                break;
+            }
+        }
+        if (!loaded) {
+            error = "cannot read the UDF metadata file";
+            return false;
+        }
+    }
+
+    // File set descriptor, then the root directory
+    BlockAddress fileSet{U32(logicalVolume.data() + 252), U16(logicalVolume.data() + 256)};
+    std::vector<uint8_t> fileSetDescriptor;
+    uint64_t fileSetOffset = 0;
+    if (!ResolveBlock(fileSet, false, fileSetOffset) ||
+        !ReadDescriptor(fileSetOffset, TagFileSetDescriptor, fileSetDescriptor)) {
+        error = "cannot read the UDF file set descriptor";
+        return false;
+    }
+
+    BlockAddress rootIcb{U32(fileSetDescriptor.data() + 404), U16(fileSetDescriptor.data() + 408)};
+    if (!ReadFileEntry(rootIcb, true, root) || !root.isDirectory) {
+        error = "cannot read the UDF root directory";
+        return false;
+    }
+    return true;
+}
+
+bool UdfImage::Find(const std::string& path, UdfEntry& entry) const {
+    std::vector<std::string> parts = SplitPath(path);
+    if (parts.empty()) {
+        entry = root;
+        return true;
+    }
+
+    std::string parent;
+    for (size_t i = 0; i + 1 < parts.size(); i++) {
+        parent += (parent.empty() ? "" : "/") + parts[i];
+    }
+
+    std::vector<UdfEntry> siblings;
+    if (!List(parent, siblings)) {
+        return false;
+    }
+    std::string wanted = UpperCase(parts.back());
+    for (const auto& sibling : siblings) {
+        if (UpperCase(sibling.name) == wanted) {
+            entry = sibling;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UdfImage::List(const std::string& path, std::vector<UdfEntry>& entries) const {
+    std::vector<std::string> parts = SplitPath(path);
+    std::string key;
+    for (const auto& part : parts) {
+        key += "/" + UpperCase(part);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = directoryCache.find(key);
+        if (it != directoryCache.end()) {
+            entries = it->second;
+            return true;
+        }
+    }
+
+    UdfEntry directory = root;
+    if (!parts.empty() && (!Find(path, directory) || !directory.isDirectory)) {
+        return false;
+    }
+    if (!ReadDirectory(directory, entries)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    directoryCache[key] = entries;
+    return true;
+}
+
+bool UdfImage::ReadSectors(uint64_t offset, size_t size, std::vector<uint8_t>& data) const {
+    data.resize(size);
+    return file->ReadAt(offset, data.data(), size) == size;
+}
+
+bool UdfImage::ReadDescriptor(uint64_t offset, uint16_t expectedTag, std::vector<uint8_t>& data) const {
+    if (!ReadSectors(offset, SectorSize, data) || !TagChecksumValid(data.data())) {
+        return false;
+    }
+    return expectedTag == 0 || U16(data.data()) == expectedTag;
+}
+
+const UdfImage::Partition* UdfImage::FindPartition(uint16_t number) const {
+    for (const auto& partition : partitions) {
+        if (partition.number == number) {
+            return &partition;
+        }
+    }
+    return nullptr;
+}
+
+bool UdfImage::ResolveBlock(const BlockAddress& address, bool fileData, uint64_t& offset) const {
+    if (address.partitionRef >= partitionMaps.size()) {
+        return false;
+    }
+    const PartitionMap& map = partitionMaps[address.partitionRef];
+
+    // File data of a file whose ICB is in the metadata partition is recorded
+    // in the physical partition underneath (UDF 2.50 2.2.13)
+    if (map.isMetadata && !fileData) {
+        uint64_t position = static_cast<uint64_t>(address.block) * blockSize;
+        for (const auto& extent : map.metadataExtents) {
+            if (position < extent.length) {
+                offset = extent.offset + position;
+                return true;
+            }
+            position -= extent.length;
+        }
+        return false;
+    }
+
+    const Partition* partition = FindPartition(map.partitionNumber);
+    if (!partition || address.block >= partition->length) {
+        return false;
+    }
+    offset = (static_cast<uint64_t>(partition->start) + address.block) * SectorSize;
+    return true;
+}
+
+bool UdfImage::ReadBlock(const BlockAddress& address, std::vector<uint8_t>& data) const {
+    uint64_t offset = 0;
+    return ResolveBlock(address, false, offset) && ReadSectors(offset, blockSize, data);
+}
+
+bool UdfImage::ReadFileEntry(const BlockAddress& icb, bool isDirectory, UdfEntry& entry) const {
+    std::vector<uint8_t> data;
+    if (!ReadBlock(icb, data) || !TagChecksumValid(data.data())) {
+        return false;
+    }
+
+    uint16_t tag = U16(data.data());
+    size_t adStart;
+    uint32_t adLength;
+    if (tag == TagFileEntry) {
+        adStart = 176 + U32(data.data() + 168);
+        adLength = U32(data.data() + 172);
+    } else if (tag == TagExtendedFileEntry) {
+        adStart = 216 + U32(data.data() + 208);
+        adLength = U32(data.data() + 212);
+    } else {
+        return false;
+    }
+    if (adStart > data.size() || adLength > data.size() - adStart) {
+        return false;
+    }
+
+    uint8_t fileType = data[16 + 11];
+    int adType = U16(data.data() + 16 + 18) & 0x07;
+    entry.isDirectory = fileType == FileTypeDirectory;
+    entry.size = U64(data.data() + 56);
+    entry.extents.clear();
+    entry.embedded.clear();
+
+    if (adType == 3) {
+        // Data recorded in the ICB itself; a size past what is recorded there
+        // means a corrupt entry, and readers rely on size being all there is
+        if (entry.size > adLength) {
+            return false;
+        }
+        entry.embedded.assign(data.begin() + adStart, data.begin() + adStart + static_cast<size_t>(entry.size));
+        return true;
+    }
+
+    // The metadata file maps metadata blocks; everything else outside a
+    // directory is file data
+    bool fileData = !isDirectory && !entry.isDirectory && fileType != FileTypeMetadata;
+    return ReadAllocationDescriptors(data.data() + adStart, adLength, adType, icb.partitionRef,
+                                     fileData, entry.size, entry, 0);
+}
+
+bool UdfImage::ReadAllocationDescriptors(const uint8_t* ads, size_t length, int adType, uint16_t icbPartitionRef,
+                                         bool fileData, uint64_t informationLength, UdfEntry& entry,
+                                         int depth) const {
+    size_t adSize = adType == 0 ? 8 : adType == 1 ? 16 : 0;
+    if (adSize == 0 || depth > 64) {
+        return false; // ext_ad is not used on BD, and deep chains mean a corrupt image
+    }
+
+    for (size_t position = 0; position + adSize <= length; position += adSize) {
+        const uint8_t* ad = ads + position;
+        uint32_t extentLength = U32(ad) & 0x3FFFFFFF;
+        uint32_t extentType = U32(ad) >> 30;
+        if (extentLength == 0) {
+            break;
+        }
+        BlockAddress address{U32(ad + 4), adType == 1 ? U16(ad + 8) : icbPartitionRef};
+
+        if (extentType == 3) {
+            // The rest of the list continues in an allocation extent descriptor
+            std::vector<uint8_t> next;
+            if (!ReadBlock(address, next) || U16(next.data()) != TagAllocationExtentDescriptor) {
+                return false;
+            }
+            uint32_t nextLength = std::min<uint32_t>(U32(next.data() + 20), blockSize - 24);
+            return ReadAllocationDescriptors(next.data() + 24, nextLength, adType, icbPartitionRef,
+                                             fileData, informationLength, entry, depth + 1);
+        }
+        if (extentType != 0) {
+            return false; // Unrecorded extents do not occur on pressed discs
+        }
+
+        // A metadata-partition extent may be split across metadata file extents
+        uint64_t remaining = extentLength;
+        uint32_t block = address.block;
+        while (remaining > 0) {
+            uint64_t offset = 0;
+            if (!ResolveBlock({block, address.partitionRef}, fileData, offset)) {
+                return false;
+            }
+            uint64_t run = std::min<uint64_t>(remaining, blockSize);
+            if (!entry.extents.empty() &&
+                entry.extents.back().offset + entry.extents.back().length == offset) {
+                entry.extents.back().length += run;
+            } else {
+                entry.extents.push_back({offset, run});
+            }
+            remaining -= run;
+            block++;
+        }
+    }
+
+    // Allocated space may extend past the end of the file
+    uint64_t total = 0;
+    for (auto& extent : entry.extents) {
+        extent.length = std::min(extent.length, informationLength - std::min(total, informationLength));
+        total += extent.length;
+    }
+    entry.extents.erase(std::remove_if(entry.extents.begin(), entry.extents.end(),
+                                       [](const UdfExtent& extent) { return extent.length == 0; }),
+                        entry.extents.end());
+    return true;
+}
+
+bool UdfImage::ReadEntryData(const UdfEntry& entry, std::vector<uint8_t>& data) const {
+    if (!entry.extents.empty()) {
+        if (entry.size > MaxDirectorySize) {
+            return false;
+        }
+        data.resize(static_cast<size_t>(entry.size));
+        size_t position = 0;
+        for (const auto& extent : entry.extents) {
+            size_t count = static_cast<size_t>(extent.length);
+            if (file->ReadAt(extent.offset, data.data() + position, count) != count) {
+                return false;
+            }
+            position += count;
+        }
+        return true;
+    }
+    data = entry.embedded;
+    return true;
+}
+
+bool UdfImage::ReadDirectory(const UdfEntry& directory, std::vector<UdfEntry>& entries) const {
+    std::vector<uint8_t> data;
+    if (!ReadEntryData(directory, data)) {
+        return false;
+    }
+
+    entries.clear();
+    size_t position = 0;
+    while (position + 38 <= data.size()) {
+        const uint8_t* fid = data.data() + position;
+        if (U16(fid) != TagFileIdentifierDescriptor) {
+            break;
+        }
+        uint8_t characteristics = fid[18];
+        uint8_t nameLength = fid[19];
+        uint16_t implementationLength = U16(fid + 36);
+        size_t recordLength = (38 + implementationLength + nameLength + 3) & ~size_t(3);
+        if (position + 38 + implementationLength + nameLength > data.size()) {
+            return false;
+        }
+
+        // Skip deleted entries and the parent link
+        if (!(characteristics & 0x04) && !(characteristics & 0x08)) {
+            UdfEntry child;
+            child.name = DecodeName(fid + 38 + implementationLength, nameLength);
+            BlockAddress icb{U32(fid + 24), U16(fid + 28)};
+            if (ReadFileEntry(icb, (characteristics & 0x02) != 0, child)) {
+                entries.push_back(std::move(child));
+            }
+        }
+        position += recordLength;
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "platform.h"
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// A run of file data inside the image, in bytes
+struct UdfExtent {
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct UdfEntry {
+    std::string name;
+    bool isDirectory = false;
+    uint64_t size = 0;
+    std::vector<UdfExtent> extents; // Empty for files whose data is embedded in the ICB
+    std::vector<uint8_t> embedded;  // Data of embedded files (small, rare on BD)
+};
+
+// Read-only UDF filesystem reader for Blu-ray images (UDF 2.50, including
+// the metadata partition; earlier revisions without one work too). It only
+// resolves names to byte ranges in the image; reading file data is left to
+// the caller, so large streams never pass through this class.
+class UdfImage {
+public:
+    static constexpr uint32_t SectorSize = 2048;
+
+    bool Open(const fs::path& imagePath, std::string& error);
+
+    // Path relative to the image root with '/' or '\' separators, e.g. "BDMV/PLAYLIST".
+    // Names compare case-insensitively.
+    bool Find(const std::string& path, UdfEntry& entry) const;
+    bool List(const std::string& path, std::vector<UdfEntry>& entries) const;
+
+    const fs::path& Path() const { return imagePath; }
+    const std::shared_ptr<RandomAccessFile>& File() const { return file; }
+
+private:
+    struct Partition {
+        uint16_t number = 0;
+        uint32_t start = 0;  // Sector of the partition's first block
+        uint32_t length = 0; // In blocks
+    };
+
+    struct PartitionMap {
+        uint16_t partitionNumber = 0;
+        bool isMetadata = false;
+        std::vector<UdfExtent> metadataExtents; // Metadata file data, image byte ranges
+    };
+
+    // Logical block address: block within the partition named by partitionRef
+    struct BlockAddress {
+        uint32_t block = 0;
+        uint16_t partitionRef = 0;
+    };
+
+    bool ReadSectors(uint64_t offset, size_t size, std::vector<uint8_t>& data) const;
+    bool ReadDescriptor(uint64_t offset, uint16_t expectedTag, std::vector<uint8_t>& data) const;
+    bool ResolveBlock(const BlockAddress& address, bool fileData, uint64_t& offset) const;
+    bool ReadBlock(const BlockAddress& address, std::vector<uint8_t>& data) const;
+    bool ReadFileEntry(const BlockAddress& icb, bool isDirectory, UdfEntry& entry) const;
+    bool ReadAllocationDescriptors(const uint8_t* ads, size_t length, int adType, uint16_t icbPartitionRef,
+                                   bool fileData, uint64_t informationLength, UdfEntry& entry, int depth) const;
+    bool ReadEntryData(const UdfEntry& entry, std::vector<uint8_t>& data) const;
+    bool ReadDirectory(const UdfEntry& directory, std::vector<UdfEntry>& entries) const;
+    const Partition* FindPartition(uint16_t number) const;
+
+    fs::path imagePath;
+    std::shared_ptr<RandomAccessFile> file;
+    std::vector<Partition> partitions;
+    std::vector<PartitionMap> partitionMaps;
+    uint32_t blockSize = SectorSize;
+    UdfEntry root;
+
+    // Directory listings by upper-cased path; directories are small and looked up repeatedly
+    mutable std::mutex cacheMutex;
+    mutable std::map<std::string, std::vector<UdfEntry>> directoryCache;
+};
@@ -0,0 +1,99 @@
+// ChildProcess on POSIX: exit codes, and Terminate() against a tree that
+// ignores SIGTERM and leaves a grandchild behind.
+
+#include "child_process.h"
+#include "test_util.h"
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A stale ECHILD from an earlier call must not end Wait() while the child runs
+void TestExitCodeWithStaleErrno() {
+    ChildProcess child;
+    CHECK(child.Start({"sh", "-c", "sleep 0.3; exit 3"}, nullptr));
+    errno = ECHILD;
+    CHECK(child.Wait() == 3);
+    CHECK(!child.WasTerminated());
+}
+
+void TestRunCollectsOutput() {
+    std::string output;
+    CHECK(ChildProcess::Run({"sh", "-c", "echo out; echo err >&2"}, output) == 0);
+    CHECK(output.find("out\n") != std::string::npos);
+    CHECK(output.find("err\n") != std::string::npos);
+}
+
+// The child ignores SIGTERM and spawns a grandchild (which ignores it too)
+// that keeps appending to a file and holds the output pipe open. Past the
+// grace period the whole group is killed: Wait() returns, the file stops
+// growing and no output arrives once Wait() is done.
+void TestTerminateStubbornTree() {
+    fs::path dir = fs::temp_directory_path() / ("child_process_test." + std::to_string(getpid()));
+    fs::create_directories(dir);
+    fs::path ticks = dir / "ticks";
+    fs::path script = dir / "stubborn.sh";
+    {
+        std::ofstream out(script);
+        out << "trap '' TERM\n"
+               "(trap '' TERM; while :; do echo tick; echo tick >> \"$1\"; sleep 0.05; done) &\n"
+               "echo ready\n"
+               "while :; do sleep 0.05; done\n";
+    }
+
+    std::mutex outputMutex;
+    std::string output;
+    bool waited = false;
+    bool lateOutput = false;
+    auto onOutput = [&](const char* data, size_t size) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        output.append(data, size);
+        lateOutput = lateOutput || waited;
+    };
+
+    ChildProcess child;
+    CHECK(child.Start({"sh", script.string(), ticks.string()}, onOutput));
+    auto ready = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < ready && !fs::exists(ticks)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(fs::exists(ticks));
+
+    auto start = std::chrono::steady_clock::now();
+    child.Terminate();
+    int exitCode = child.Wait();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        waited = true;
+    }
+    CHECK(exitCode == -1);
+    CHECK(child.WasTerminated());
+    CHECK(elapsed >= ChildProcess::TerminateGrace);
+    CHECK(elapsed < ChildProcess::TerminateGrace + std::chrono::seconds(1));
+
+    std::error_code ec;
+    uintmax_t size = fs::file_size(ticks, ec);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    CHECK(fs::file_size(ticks, ec) == size);
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        CHECK(output.find("ready\n") != std::string::npos);
+        CHECK(!lateOutput);
+    }
+
+    fs::remove_all(dir, ec);
+}
+
+} // namespace
+
+int main() {
+    TestExitCodeWithStaleErrno();
+    TestRunCollectsOutput();
+    TestTerminateStubbornTree();
+    return TestResult("child_process_test");
+}
@@ -0,0 +1,177 @@
+// CLPIParser against a hand-built clip: ProgramInfo stream attributes,
+// SequenceInfo and an EP_map whose entry points span three coarse entries.
+
+#include "clpi_parser.h"
+#include "test_util.h"
+
+namespace {
+
+// Entry points of the fixture's video stream (90kHz PTS, source packet)
+//   E0     1024        0    coarse 0 (PTS bits 32..19 = 0, SPN high 0)
+//   E1   200704     1000    coarse 0
+//   E2   528384   140000    coarse 1 (PTS bit 19 set, SPN past 0x1FFFF)
+//   E3  1056768   140500    coarse 2 (PTS bit 20 set, out of a fine entry's reach)
+// Two STC sequences: packets [0, 140000) and [140000, 150000).
+std::vector<uint8_t> BuildClip() {
+    ByteBuilder clip;
+    clip.Text("HDMV0200");
+    clip.U32(0).U32(0).U32(0); // SequenceInfo, ProgramInfo and CPI start addresses, patched below
+    clip.U32(0).U32(0);        // ClipMark, ExtensionData
+    clip.Fill(40 - clip.Size());
+
+    // ClipInfo: length, reserved, stream and application type, ATC delta
+    // flag, TS_recording_rate, number_of_source_packets
+    clip.U32(16).U16(0).U8(1).U8(1).U32(0).U32(48000000).U32(150000);
+
+    size_t sequenceInfo = clip.Size();
+    clip.PatchU32(8, static_cast<uint32_t>(sequenceInfo));
+    clip.U32(0).U8(0).U8(1);              // length (patched), reserved, one ATC sequence
+    clip.U32(0).U8(2).U8(0);              // SPN_ATC_start, two STC sequences, offset_STC_id
+    clip.U16(0x1001).U32(0).U32(0).U32(300000);
+    clip.U16(0x1001).U32(140000).U32(264192).U32(600000);
+    clip.PatchU32(sequenceInfo, static_cast<uint32_t>(clip.Size() - sequenceInfo - 4));
+
+    size_t programInfo = clip.Size();
+    clip.PatchU32(12, static_cast<uint32_t>(programInfo));
+    clip.U32(0).U8(0).U8(1);              // length (patched), reserved, one program
+    clip.U32(0).U16(0x0100).U8(5).U8(0);  // SPN_program_sequence_start, PMT PID, 5 streams, no groups
+    clip.U16(0x1011).U8(5).U8(0x1b).U8(0x61).Fill(3);             // H.264, 1080i 29.97
+    clip.U16(0x1100).U8(6).U8(0x81).U8(0x61).Text("eng").Fill(1); // AC-3 multi 48kHz
+    clip.U16(0x1101).U8(6).U8(0x86).U8(0x34).Text("jpn").Fill(1); // DTS-HD MA stereo 96kHz
+    clip.U16(0x1200).U8(4).U8(0x90).Text("fre");                  // PG
+    clip.U16(0x1800).U8(5).U8(0x92).U8(0x01).Text("ger");         // Text subtitle
+    clip.PatchU32(programInfo, static_cast<uint32_t>(clip.Size() - programInfo - 4));
+
+    size_t cpi = clip.Size();
+    clip.PatchU32(16, static_cast<uint32_t>(cpi));
+    clip.U32(0).U16(1);                   // length (patched), CPI_type EP_map
+    clip.U8(0).U8(2);                     // EP_map: reserved, two streams
+
+    // The audio stream's map comes first and must be passed over. Counts are
+    // 10 reserved bits, EP_stream_type, coarse and fine entry counts.
+    auto streamHeader = [&](uint16_t pid, uint64_t type, uint64_t coarse, uint64_t fine, uint32_t start) {
+        uint64_t counts = (type << 34) | (coarse << 18) | fine;
+        clip.U16(pid).U16(static_cast<uint16_t>(counts >> 32)).U32(static_cast<uint32_t>(counts)).U32(start);
+    };
+    const uint32_t headers = 2 + 2 * 12;  // EP_map offsets count from its reserved byte
+    const uint32_t audioMap = headers;
+    const uint32_t videoMap = audioMap + 4 + 8 + 4;
+    streamHeader(0x1100, 3, 1, 1, audioMap);
+    streamHeader(0x1011, 1, 3, 4, videoMap);
+
+    // Audio: one coarse and one fine entry that would decode to SPN 7
+    clip.U32(12).U32(0).U32(0).U32(7);
+
+    // Video: fine table start, then {ref_to_EP_fine_id << 14 | PTS_EP_coarse, SPN_EP_coarse}
+    clip.U32(4 + 3 * 8);
+    clip.U32((0u << 14) | 0).U32(0);
+    clip.U32((2u << 14) | 1).U32(140000);
+    clip.U32((3u << 14) | 2).U32(140500);
+    // Fine entries: is_angle_change, I_end_position_offset, PTS bits 19..9, SPN bits 16..0
+    clip.U32((1u << 28) | (2u << 17) | 0);
+    clip.U32((3u << 28) | (392u << 17) | 1000);
+    clip.U32((1u << 31) | (1032u << 17) | (140000 - 131072));
+    clip.U32((16u << 17) | (140500 - 131072));
+    clip.PatchU32(cpi, static_cast<uint32_t>(clip.Size() - cpi - 4));
+
+    return clip.Bytes();
+}
+
+void TestStreams(const ClipInfo& clip) {
+    CHECK(clip.streams.size() == 5);
+    if (clip.streams.size() != 5) {
+        return;
+    }
+
+    const StreamInfo& video = clip.streams[0];
+    CHECK(video.pid == 0x1011);
+    CHECK(video.kind == StreamKind::Video);
+    CHECK(video.codec == "h264");
+
+    const StreamInfo& ac3 = clip.streams[1];
+    CHECK(ac3.pid == 0x1100);
+    CHECK(ac3.kind == StreamKind::Audio);
+    CHECK(ac3.codec == "ac3");
+    CHECK(ac3.channelLayout == "multi");
+    CHECK(ac3.sampleRate == 48000);
+    CHECK(ac3.language.Code() == "eng");
+
+    const StreamInfo& dts = clip.streams[2];
+    CHECK(dts.codec == "dts_hd_ma");
+    CHECK(dts.channelLayout == "stereo");
+    CHECK(dts.sampleRate == 96000);
+    CHECK(dts.language.Code() == "jpn");
+
+    const StreamInfo& pg = clip.streams[3];
+    CHECK(pg.kind == StreamKind::PresentationGraphics);
+    CHECK(pg.IsSubtitle());
+    CHECK(pg.language.Code() == "fre");
+
+    const StreamInfo& text = clip.streams[4];
+    CHECK(text.kind == StreamKind::TextSubtitle);
+    CHECK(text.codec == "hdmv_text_subtitle");
+    CHECK(text.language.Code() == "ger");
+}
+
+void TestEntryPoints(const ClipInfo& clip) {
+    CHECK(clip.sourcePacketCount == 150000);
+    CHECK(clip.stcSequences.size() == 2);
+    CHECK(clip.entryPoints.size() == 4);
+    if (clip.stcSequences.size() != 2 || clip.entryPoints.size() != 4) {
+        return;
+    }
+    CHECK(clip.stcSequences[1].spnStart == 140000);
+    CHECK(clip.stcSequences[1].presentationStart == 264192);
+
+    // Coarse and fine halves recombined; flag bits above the fine PTS ignored
+    const uint64_t pts[] = {1024, 200704, 528384, 1056768};
+    const uint32_t spn[] = {0, 1000, 140000, 140500};
+    for (size_t i = 0; i < 4; i++) {
+        CHECK(clip.entryPoints[i].pts == pts[i]);
+        CHECK(clip.entryPoints[i].spn == spn[i]);
+    }
+
+    EntryPoint point;
+    CHECK(clip.FindEntryPoint(0, 150000, point) && point.spn == 1000);
+    CHECK(clip.FindEntryPoint(0, 100352, point) && point.spn == 1000);
+    CHECK(!clip.FindEntryPoint(0, 100, point));
+    CHECK(clip.FindEntryPoint(1, 300000, point) && point.spn == 140000);
+    CHECK(!clip.FindEntryPoint(2, 0, point));
+
+    // From the entry point at or before IN to the first at or after OUT
+    uint32_t first = 0;
+    uint32_t end = 0;
+    CHECK(clip.GetPacketRange(0, 100352, 250000, first, end));
+    CHECK(first == 1000 && end == 140000);
+    CHECK(clip.GetPacketRange(0, 0, 100352, first, end));
+    CHECK(first == 0 && end == 1000);
+    // The last sequence runs to the clip's packet count
+    CHECK(clip.GetPacketRange(1, 264192, 600000, first, end));
+    CHECK(first == 140000 && end == 150000);
+    CHECK(!clip.GetPacketRange(2, 0, 1, first, end));
+}
+
+void TestTruncatedCPI(std::vector<uint8_t> data) {
+    // A damaged byte mapping leaves the stream attributes usable
+    data.resize(data.size() - 10);
+    ClipInfo clip;
+    CHECK(CLPIParser::ParseCLPIData(data, clip));
+    CHECK(clip.streams.size() == 5);
+    CHECK(clip.entryPoints.empty());
+    CHECK(clip.stcSequences.empty());
+}
+
+} // namespace
+
+int main() {
+    std::vector<uint8_t> data = BuildClip();
+    ClipInfo clip;
+    CHECK(CLPIParser::ParseCLPIData(data, clip));
+    TestStreams(clip);
+    TestEntryPoints(clip);
+    TestTruncatedCPI(data);
+
+    ClipInfo bad;
+    CHECK(!CLPIParser::ParseCLPIData(std::vector<uint8_t>{'H', 'D', 'M', 'X'}, bad));
+    return TestResult("clpi_parser_test");
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Shared bits of the programs under tests/. Each test is a plain executable
+// over the portable core (see `make test`): it prints every failed check and
+// exits non-zero if there was one.
+
+inline int& TestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            TestFailures()++;                                                             \
+        }                                                                                 \
+    } while (0)
+
+inline int TestResult(const char* name) {
+    if (TestFailures() != 0) {
+        std::fprintf(stderr, "%s: %d check(s) failed\n", name, TestFailures());
+        return 1;
+    }
+    std::printf("%s: ok\n", name);
+    return 0;
+}
+
+// Big-endian byte builder for hand-made fixtures, the writing side of ByteReader
+class ByteBuilder {
+public:
+    ByteBuilder& U8(uint8_t value) {
+        bytes.push_back(value);
+        return *this;
+    }
+    ByteBuilder& U16(uint16_t value) {
+        return U8(static_cast<uint8_t>(value >> 8)).U8(static_cast<uint8_t>(value));
+    }
+    ByteBuilder& U32(uint32_t value) {
+        return U16(static_cast<uint16_t>(value >> 16)).U16(static_cast<uint16_t>(value));
+    }
+    ByteBuilder& Text(const std::string& text) {
+        bytes.insert(bytes.end(), text.begin(), text.end());
+        return *this;
+    }
+    ByteBuilder& Fill(size_t count, uint8_t value = 0) {
+        bytes.insert(bytes.end(), count, value);
+        return *this;
+    }
+
+    // Overwrites a U32 written earlier, e.g. a length or start address
+    void PatchU32(size_t position, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            bytes[position + i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+        }
+    }
+
+    size_t Size() const { return bytes.size(); }
+    const std::vector<uint8_t>& Bytes() const { return bytes; }
+
+private:
+    std::vector<uint8_t> bytes;
+};
@@ -0,0 +1,210 @@
+// PAT/PMT section reassembly in TSDemuxer: sections split across packets,
+// finished by a pointer_field and followed by more sections in one payload;
+// and PES packets broken by a continuity gap.
+
+#include "ts_demuxer.h"
+#include "test_util.h"
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+constexpr uint16_t PmtPid = 0x0100;
+
+// A PSI section with its header and CRC_32 around `body`
+std::vector<uint8_t> MakeSection(uint8_t tableId, uint16_t idExtension, const std::vector<uint8_t>& body) {
+    size_t length = 5 + body.size() + 4; // After section_length: 5 header bytes, body, CRC
+    ByteBuilder section;
+    section.U8(tableId).U16(static_cast<uint16_t>(0xB000 | length)).U16(idExtension);
+    section.U8(0xC1).U8(0).U8(0); // version 0, current; section 0 of 0
+    std::vector<uint8_t> bytes = section.Bytes();
+    bytes.insert(bytes.end(), body.begin(), body.end());
+    uint32_t crc = MpegCRC32(bytes.data(), bytes.size());
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        bytes.push_back(static_cast<uint8_t>(crc >> shift));
+    }
+    return bytes;
+}
+
+std::vector<uint8_t> MakePAT() {
+    ByteBuilder body;
+    body.U16(1).U16(0xE000 | PmtPid);
+    body.U16(2).U16(0xE000 | PmtPid); // Both programs' maps on one PID
+    return MakeSection(0x00, 1, body.Bytes());
+}
+
+// PMT whose elementary streams are {stream_type, PID, ISO 639 language}
+std::vector<uint8_t> MakePMT(uint16_t programNumber,
+                             const std::vector<std::tuple<uint8_t, uint16_t, std::string>>& streams) {
+    ByteBuilder body;
+    body.U16(0xE000 | 0x1001).U16(0xF000); // PCR_PID, no program descriptors
+    for (const auto& [type, pid, language] : streams) {
+        body.U8(type).U16(static_cast<uint16_t>(0xE000 | pid)).U16(0xF000 | 6);
+        body.U8(0x0A).U8(4).Text(language).U8(0);
+    }
+    return MakeSection(0x02, programNumber, body.Bytes());
+}
+
+// A 192-byte source packet carrying exactly `payload`: an adaptation field
+// pads short payloads, so the packet ends where the payload does
+std::vector<uint8_t> MakePacket(uint16_t pid, bool payloadStart, uint8_t continuity,
+                                const std::vector<uint8_t>& payload) {
+    ByteBuilder packet;
+    packet.U32(0); // TP_extra_header
+    packet.U8(TSSyncByte).U16(static_cast<uint16_t>((payloadStart ? 0x4000 : 0) | pid));
+    size_t room = TSPacketSize - 4;
+    if (payload.size() < room) {
+        size_t adaptationLength = room - payload.size() - 1;
+        packet.U8(static_cast<uint8_t>(0x30 | continuity)).U8(static_cast<uint8_t>(adaptationLength));
+        if (adaptationLength > 0) {
+            packet.U8(0).Fill(adaptationLength - 1, 0xFF);
+        }
+    } else {
+        packet.U8(static_cast<uint8_t>(0x10 | continuity));
+    }
+    std::vector<uint8_t> bytes = packet.Bytes();
+    bytes.insert(bytes.end(), payload.begin(), payload.begin() + std::min(payload.size(), room));
+    return bytes;
+}
+
+// A payload_unit_start payload: pointer_field, the bytes it skips, sections, stuffing
+std::vector<uint8_t> MakeStartPayload(const std::vector<uint8_t>& tail,
+                                      const std::vector<std::vector<uint8_t>>& sections) {
+    std::vector<uint8_t> payload{static_cast<uint8_t>(tail.size())};
+    payload.insert(payload.end(), tail.begin(), tail.end());
+    for (const auto& section : sections) {
+        payload.insert(payload.end(), section.begin(), section.end());
+    }
+    payload.resize(TSPacketSize - 4, 0xFF);
+    return payload;
+}
+
+void Push(TSDemuxer& demuxer, const std::vector<uint8_t>& sourcePacket) {
+    TSPacket packet;
+    CHECK(TSPacket::Parse(sourcePacket.data(), packet));
+    demuxer.Push(packet);
+}
+
+const TSProgram* FindProgram(const TSDemuxer& demuxer, uint16_t programNumber) {
+    for (const auto& program : demuxer.Programs()) {
+        if (program.programNumber == programNumber) {
+            return &program;
+        }
+    }
+    return nullptr;
+}
+
+bool HasMap(const TSDemuxer& demuxer, uint16_t programNumber) {
+    const TSProgram* program = FindProgram(demuxer, programNumber);
+    return program && program->hasMap;
+}
+
+const std::vector<std::tuple<uint8_t, uint16_t, std::string>> FirstStreams = {
+    {0x1b, 0x1011, "und"}, {0x81, 0x1100, "eng"}, {0x81, 0x1101, "jpn"}, {0x90, 0x1200, "eng"}};
+const std::vector<std::tuple<uint8_t, uint16_t, std::string>> SecondStreams = {
+    {0x1b, 0x1012, "und"}, {0x83, 0x1102, "fra"}};
+
+void CheckFirstProgram(const TSDemuxer& demuxer) {
+    const TSProgram* program = FindProgram(demuxer, 1);
+    CHECK(program && program->hasMap && program->streams.size() == 4);
+    if (!program || program->streams.size() != 4) {
+        return;
+    }
+    CHECK(program->pcrPid == 0x1001);
+    CHECK(program->streams[1].pid == 0x1100 && program->streams[1].language == "eng");
+    CHECK(program->streams[2].streamType == 0x81 && program->streams[2].language == "jpn");
+    CHECK(program->streams[3].pid == 0x1200);
+}
+
+void TestPMTFinishedByPointerField() {
+    TSDemuxer demuxer([](const PESPacket&) {});
+    Push(demuxer, MakePacket(0, true, 0, MakeStartPayload({}, {MakePAT()})));
+
+    // Program 1's PMT starts at the end of one packet and is finished by the
+    // pointer_field bytes of the next, which then carries program 2's PMT
+    std::vector<uint8_t> first = MakePMT(1, FirstStreams);
+    const size_t split = 30;
+    std::vector<uint8_t> head{0};
+    head.insert(head.end(), first.begin(), first.begin() + split);
+    Push(demuxer, MakePacket(PmtPid, true, 0, head));
+    CHECK(FindProgram(demuxer, 1) && !HasMap(demuxer, 1));
+
+    std::vector<uint8_t> tail(first.begin() + split, first.end());
+    Push(demuxer, MakePacket(PmtPid, true, 1, MakeStartPayload(tail, {MakePMT(2, SecondStreams)})));
+
+    CheckFirstProgram(demuxer);
+    CHECK(HasMap(demuxer, 2) && FindProgram(demuxer, 2)->streams.size() == 2);
+    CHECK(demuxer.HasProgramMap());
+}
+
+void TestPMTContinuedWithoutPayloadStart() {
+    TSDemuxer demuxer([](const PESPacket&) {});
+    Push(demuxer, MakePacket(0, true, 0, MakeStartPayload({}, {MakePAT()})));
+
+    std::vector<uint8_t> first = MakePMT(1, FirstStreams);
+    std::vector<uint8_t> head{0};
+    head.insert(head.end(), first.begin(), first.begin() + 20);
+    std::vector<uint8_t> rest(first.begin() + 20, first.end());
+    rest.resize(TSPacketSize - 4, 0xFF);
+    Push(demuxer, MakePacket(PmtPid, true, 0, head));
+    Push(demuxer, MakePacket(PmtPid, false, 1, rest));
+
+    CheckFirstProgram(demuxer);
+    CHECK(FindProgram(demuxer, 2) && !HasMap(demuxer, 2));
+}
+
+void TestCorruptSectionIgnored() {
+    TSDemuxer demuxer([](const PESPacket&) {});
+    Push(demuxer, MakePacket(0, true, 0, MakeStartPayload({}, {MakePAT()})));
+
+    // A bad CRC drops that section only; the one after it still counts
+    std::vector<uint8_t> broken = MakePMT(1, FirstStreams);
+    broken[14] ^= 0x01;
+    Push(demuxer, MakePacket(PmtPid, true, 0, MakeStartPayload({}, {broken, MakePMT(2, SecondStreams)})));
+
+    CHECK(FindProgram(demuxer, 1) && !HasMap(demuxer, 1));
+    CHECK(HasMap(demuxer, 2));
+}
+
+// An unbounded (video) PES is only complete when the next one starts
+std::vector<uint8_t> MakePESStart(uint8_t marker) {
+    ByteBuilder payload;
+    payload.U32(0x000001E0).U16(0);                           // start code, stream_id, PES_packet_length 0
+    payload.U8(0x80).U8(0x80).U8(5).U8(0x21).U16(1).U16(1);   // PTS 0
+    payload.Fill(TSPacketSize - 4 - payload.Size(), marker);
+    return payload.Bytes();
+}
+
+std::vector<uint8_t> MakePESContinuation(uint8_t marker) {
+    return std::vector<uint8_t>(TSPacketSize - 4, marker);
+}
+
+void TestContinuityGapDropsPES() {
+    std::vector<std::pair<uint8_t, size_t>> emitted; // First payload byte, size
+    TSDemuxer demuxer([&](const PESPacket& pes) { emitted.push_back({pes.data[0], pes.size}); });
+    Push(demuxer, MakePacket(0, true, 0, MakeStartPayload({}, {MakePAT()})));
+    Push(demuxer, MakePacket(PmtPid, true, 0, MakeStartPayload({}, {MakePMT(1, FirstStreams)})));
+
+    // PES 'a' loses its third packet; the gap is noticed on the packet that starts 'b'
+    Push(demuxer, MakePacket(0x1011, true, 0, MakePESStart('a')));
+    Push(demuxer, MakePacket(0x1011, false, 1, MakePESContinuation('a')));
+    Push(demuxer, MakePacket(0x1011, true, 3, MakePESStart('b')));
+    Push(demuxer, MakePacket(0x1011, false, 4, MakePESContinuation('b')));
+    Push(demuxer, MakePacket(0x1011, true, 5, MakePESStart('c')));
+
+    CHECK(emitted.size() == 1);
+    if (!emitted.empty()) {
+        CHECK(emitted[0].first == 'b');
+        CHECK(emitted[0].second == 2 * (TSPacketSize - 4) - 14);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestPMTFinishedByPointerField();
+    TestPMTContinuedWithoutPayloadStart();
+    TestCorruptSectionIgnored();
+    TestContinuityGapDropsPES();
+    return TestResult("ts_demuxer_test");
+}